@@ -1,3 +1,13 @@
+#ifndef CG_ROOSTATSTOOLS_H
+#define CG_ROOSTATSTOOLS_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TObject.h"
+#include "TNtupleD.h"
+
 #include "RooAbsData.h"
 using namespace RooFit;
 
@@ -10,9 +20,19 @@ using namespace RooStats;
 
 namespace CG_Statistics
 {
-  // verbosity level (higher value means more verbose)
+  // verbosity level (higher value means more verbose, set to the verbosity of the active session during
+  // calls in its scope, see Session)
   enum VERBOSITY {eSILENT = 0, eERROR = 1, eWARNING = 2, eINFO = 3, eDEBUG = 4};
   extern VERBOSITY iVERBOSITY;
+
+  // calculation of CL(s+b) for Feldman-Cousins intervals
+  // (automatic: asymptotic formulae if the observed number of events and the numbers of events expected at
+  // both ends of the scanned interval are >= 100, toys otherwise)
+  //
+  // For a POI with lower boundary, the asymptotic formulae need sigma(mu') of the Asimov dataset at the
+  // boundary. If it cannot be evaluated (e.g. POI without uncertainty), the automatic mode uses toys and the
+  // asymptotic mode returns no interval (0).
+  enum FCMODE {eTOYS = 0, eASYMPTOTIC = 1, eAUTOMATIC = 2};
   
   // calculate Feldman-Cousins interval
 #ifndef CG_EXPERIMENTAL
@@ -22,17 +42,23 @@ namespace CG_Statistics
 					double dLow = -1e6,             // minimum of interval to scan (will be set to max(dLow,poi->getMin())
 					double dHigh = 1e6,             // maximum of interval to scan (will be set to min(dHigh,poi->getMax())
 					double dStep = 0.05,            // step size to scan interval (determines number of points to test = (dHigh - dLow)/dStep + 1)
-					unsigned int iToys = 10000      // number of toys to calculate CL(s+b) at each point
+					unsigned int iToys = 10000,     // number of toys to calculate CL(s+b) at each point
+					unsigned int iWorkers = 1,      // number of parallel workers generating the toys (0 = one per CPU core)
+					unsigned int iBlockToys = 0,    // generate toys in blocks of this size and stop at a point once CL(s+b) is significantly above/below 1 - dConf (0 = always iToys toys)
+					FCMODE eMode = eTOYS            // use toys or asymptotic distribution of the two-sided test statistic (see FCMODE)
 					);
 #else
   HypoTestInverterResult* GetFCInterval(RooAbsData& data,                 // dataset
 					ModelConfig& mc,                  // model definition
 					double dConf = 0.683,             // confidence level
-					unsigned int iMaxIterations = 3,  // maximum number of iterations
+					unsigned int iMaxIterations = 8,  // maximum number of iterations (each tests one point per interval boundary, 8 iterations test fewer points than the former 3 re-scans with iPoints - 2 points)
 					double dLow = -1e6,               // minimum of interval to scan (will be set to max(dLow,poi->getMin())
 					double dHigh = 1e6,               // maximum of interval to scan (will be set to min(dHigh,poi->getMax())
-					unsigned int iPoints = 11,        // number of points used to sample intervals
-					unsigned int iToys = 10000        // number of toys to calculate CL(s+b) at each point
+					unsigned int iPoints = 11,        // number of points of initial scan (each iteration adds one point per interval boundary)
+					unsigned int iToys = 10000,       // number of toys to calculate CL(s+b) at each point
+					unsigned int iWorkers = 1,        // number of parallel workers generating the toys (0 = one per CPU core)
+					unsigned int iBlockToys = 0,      // generate toys in blocks of this size and stop at a point once CL(s+b) is significantly above/below 1 - dConf (0 = always iToys toys)
+					FCMODE eMode = eTOYS              // use toys or asymptotic distribution of the two-sided test statistic (see FCMODE)
 					);
 #endif // CG_EXPERIMENTAL  
 
@@ -42,13 +68,35 @@ namespace CG_Statistics
 					    double dConf = 0.683        // confidence level
 					    );
 
+  // profile likelihood scan of all POIs (e.g. for 2D contours)
+  //
+  // The profiled NLL is evaluated on a grid spanning the ranges of the POIs (iPoints per POI). The grid is
+  // traversed in serpentine order split into one contiguous part per worker, so each conditional fit starts
+  // from an already fitted neighbour. Each refinement halves the grid spacing inside the cells whose corners
+  // lie on both sides of the contour q = chi2 quantile(dConf, number of POIs). Returns one entry per
+  // evaluated point with the POI values and q = 2 * (NLL - NLL_min) (caller takes ownership).
+  TNtupleD* GetProfileLikelihoodScan(RooAbsData& data,                  // dataset
+				     ModelConfig& mc,                   // model definition
+				     unsigned int iPoints = 11,         // number of points per POI of the initial grid
+				     double dConf = 0.683,              // confidence level of the refined contour
+				     unsigned int iRefinements = 3,     // number of refinements near the contour
+				     unsigned int iWorkers = 1          // number of parallel workers doing the fits (0 = one per CPU core)
+				     );
+
   // calculate significance
   HypoTestResult* GetSignificance(RooAbsData& data,                     // dataset
 				  ModelConfig& mc,                      // model definition
-				  int iToys = -1                        // number of toys for calculating significance (-1 = asymptotic formulae)
+				  int iToys = -1,                       // number of toys for calculating significance (-1 = asymptotic formulae)
+				  bool bImportanceSampling = false,     // generate toys also for signal hypotheses and reweight them to the null hypothesis (for small p-values)
+				  unsigned int iWorkers = 1             // number of parallel workers generating the toys (0 = one per CPU core)
 				  );
 
   // calculate upper limit
+  //
+  // With toys, the number of toys generated for the limit (summed over all tested points and workers, toys
+  // reused from the sampling distribution store are not included) is returned by
+  // GetLastCallPerfCounters().iToys after the call. Returns 0 if no toys could be generated for a tested
+  // point (e.g. all workers failed).
   HypoTestInverterResult* GetUpperLimit(RooAbsData& data,                 // dataset
 					ModelConfig& mc,                  // model definition
 					bool bUseCLs = true,              // do CL(s) instead of CL(s+b) upper limits
@@ -57,11 +105,391 @@ namespace CG_Statistics
 					double dHigh = 1e6,               // maximum of interval to scan (will be set to min(dHigh,poi->getMax())
 					double dPrecision = 0.01,         // desired relative precision on calculated limit
 					unsigned int iMaxIterations = 20, // maximum number of iterations to find the limit
-					int iToys = -1                    // number of toys for calculating significance (-1 = asymptotic formulae)
+					int iToys = -1,                   // number of toys for s+b and b-only hypotheses at each tested point (-1 = asymptotic formulae)
+					unsigned int iWorkers = 1         // number of parallel workers generating the toys (0 = one per CPU core)
 					);
 
-  // get sampling distributions
+  // observed and expected upper limits (expected for the b-only hypothesis)
+  struct ExpectedLimits
+  {
+    double dObserved;                 // observed upper limit
+    double dMinus2;                   // expected upper limit - 2 sigma
+    double dMinus1;                   // expected upper limit - 1 sigma
+    double dMedian;                   // median expected upper limit
+    double dPlus1;                    // expected upper limit + 1 sigma
+    double dPlus2;                    // expected upper limit + 2 sigma
+  };
+
+  // calculate observed upper limit (asymptotic formulae) and the expected limit bands
+  //
+  // The expected limits follow from sigma(mu') of the b-only Asimov dataset (arxiv:1007.1727v3 section 4.3)
+  // which is taken from the Asimov cache and therefore shared with the observed CL(s) limit. All limits are
+  // NaN if the observed limit or sigma(mu') cannot be calculated.
+  ExpectedLimits GetExpectedLimits(RooAbsData& data,                    // dataset
+				   ModelConfig& mc,                     // model definition
+				   bool bUseCLs = true,                 // do CL(s) instead of CL(s+b) upper limits
+				   double dConf = 0.95,                 // confidence level
+				   double dLow = -1e6,                  // minimum of interval to scan for the observed limit
+				   double dHigh = 1e6,                  // maximum of interval to scan for the observed limit
+				   double dPrecision = 0.01,            // desired relative precision on observed limit
+				   unsigned int iMaxIterations = 20     // maximum number of iterations to find the observed limit
+				   );
+
+  // delete cached Asimov datasets and sigma(mu') values used for CL(s) limits
+  // (done automatically at the end of each call, the cache only lives within one calculation)
+  void ClearAsimovCache();
+
+  // store sampling distributions of toy based calculations in the given ROOT file (empty name = no store)
+  //
+  // Toys generated for the same model, test statistic, POI value and nuisance parameter values are reused by
+  // later calls (also in later programme runs and by parallel workers) and are only topped up if more toys
+  // are requested than stored. By default the toys are generated with the nuisance parameters profiled on the
+  // observed data as without store, so toys are only reused for datasets with the same conditional MLEs
+  // (e.g. models without nuisance parameters). With pNuisanceValues, the toys are generated with the given
+  // nuisance parameters fixed to these values (the others are still profiled) and are hence shared by all
+  // datasets if all nuisance parameters are given. Every top-up uses a new seed (independent of RooRandom,
+  // so a new programme run does not repeat the stored toys) which is saved with the distribution. Returns
+  // false if the file cannot be opened.
+  bool SetSamplingDistStore(const char* sFileName,const RooArgSet* pNuisanceValues = 0);
+
+  // save the state of FC scans in the given ROOT file and resume interrupted scans from it (empty name = none)
+  //
+  // A checkpoint (tested points with their toys, scan iteration, points of the next iteration and the state
+  // of the random generator) is written after every iteration of the scan (after every group of points with
+  // one point per worker for the fixed scan). A later call with the same model, dataset and arguments
+  // continues from the last checkpoint and yields the same result as an uninterrupted scan. Returns false if
+  // the file cannot be opened.
+  bool SetCheckpointFile(const char* sFileName);
+
+  // function whose toys are produced in shards (see GenerateToyShard)
+  enum TOYTARGET {eFCINTERVAL = 0, eSIGNIFICANCE = 1};
+
+  // generate the toys with indices [iFirstToy ... iFirstToy + iToys) for every given POI value and save them
+  // in a shard file
+  //
+  // The toys are those of the sampling distributions used by the target function for the tested POI values
+  // (the points of a fixed FC scan or the null hypothesis of the significance). Every toy is generated with
+  // its own seed derived from iSeed, the distribution and the toy index. Hence, shards covering the toys
+  // 0 ... N - 1 can be produced by any number of processes or nodes and always merge into the same
+  // distributions. The nuisance parameters are treated as by the sampling distribution store opened with the
+  // same pNuisanceValues (see SetSamplingDistStore). Returns false if the file cannot be written or some toys
+  // failed.
+  bool GenerateToyShard(const char* sFileName,                         // output file (overwritten)
+			RooAbsData& data,                              // dataset
+			ModelConfig& mc,                               // model definition
+			TOYTARGET eTarget,                             // function using the toys
+			const std::vector<double>& vPOIs,              // tested POI values
+			ULong64_t iFirstToy,                           // index of first toy
+			unsigned int iToys,                            // number of toys per POI value
+			unsigned int iSeed = 1,                        // base seed (must be the same for all shards)
+			unsigned int iWorkers = 1,                     // number of parallel workers generating the toys (0 = one per CPU core)
+			const RooArgSet* pNuisanceValues = 0           // fixed nuisance parameter values for generating toys (0 = profile on observed data)
+			);
+
+  // merge shard files into a sampling distribution store (see SetSamplingDistStore)
+  //
+  // The shards of each distribution must cover the toys 0 ... N - 1 without gaps or overlaps and share the
+  // same seed. With the resulting store opened, the target function reuses the merged toys. Returns false
+  // if a file cannot be read or written or if the shards of a distribution do not fit together.
+  bool MergeToyShards(const std::vector<std::string>& vShardFiles,     // shard files
+		      const char* sStoreFile                           // sampling distribution store (existing entries are replaced)
+		      );
+
+  // fit binned copies of large unbinned datasets and generate their toys binned
+  //
+  // Unbinned datasets with at least iMinEvents entries are converted into a RooDataHist with iBins bins per
+  // observable (< 0 = automatic: 2 * N^(1/(2 + D)) bins for N entries and D observables) before building the
+  // NLL, so each NLL evaluation scales with the number of bins instead of the number of events. Toys for such
+  // datasets are generated binned with the same binning. iBins = 0 restores unbinned fits (default).
+  void SetBinnedFits(int iBins = -1,unsigned int iMinEvents = 10000);
+
+  // evaluate the NLL of supported models by C++ code generated for the model and compiled at runtime
+  //
+  // Supported are models with one observable built from Gaussian and exponential pdfs and their sums. The
+  // generated code is compiled once per model structure and checked against the RooFit NLL before it is
+  // used. Unsupported models and models failing the check use the RooFit NLL. Like the other NLL options
+  // below, it also applies to the test statistic on toys (its first value per toy loop is cross-checked
+  // against RooStats::ProfileLikelihoodTestStat, which is used instead if they differ). Disabled by default.
+  void SetCompiledNLL(bool bCompiled = true);
+
+  // evaluate the NLL of supported models in blocks of events with vectorised kernels
+  //
+  // Supported are models with one observable built from Gaussian, exponential and polynomial pdfs and their
+  // sums, optionally multiplied with Gaussian constraint terms of their parameters. The kernels use AVX-512
+  // or AVX2 if the CPU supports them. Each model structure is checked against the RooFit NLL before it is
+  // used. All other models use the RooFit NLL. Disabled by default.
+  void SetBatchNLL(bool bBatch = true);
+
+  // provide analytic gradients of the NLL to the minimizer for all fits
+  //
+  // Available for the models supported by SetBatchNLL (whose NLL is then used even if batch NLLs are
+  // disabled) if all their parameters are variables or constants (including the Gaussian constraint terms).
+  // The parameter errors are defined by a change of the NLL by 0.5 as for RooFit NLLs. All other fits keep
+  // the finite difference gradients of MINUIT. Disabled by default.
+  void SetAnalyticGradients(bool bGradients = true);
+
+  // shift of the best fit POI value caused by binning the dataset (see SetBinnedFits) in units of the
+  // uncertainty of the unbinned fit (0 if the dataset is not binned)
+  double GetBinningBias(RooAbsData& data,ModelConfig& mc);
+
+  // batch versions of the functions above for many datasets sharing the same model
+  //
+  // The results are returned in the order of the given datasets and are the same objects as returned by
+  // the single-dataset functions (a null pointer marks a dataset for which no result could be obtained).
+  // The datasets are distributed over parallel worker processes each using its own copy of the model
+  // (except for the likelihood intervals which refer to the given model and are calculated in-process).
+  // The caller takes ownership of the results. The overloads taking vectors vLow/vHigh scan the range
+  // [vLow[i] ... vHigh[i]] for dataset vData[i] (e.g. around the observed value).
+  std::vector<LikelihoodInterval*> GetLikelihoodIntervals(const std::vector<RooAbsData*>& vData,  // datasets
+							  ModelConfig& mc,                        // model definition
+							  double dConf = 0.683                    // confidence level
+							  );
+
+#ifndef CG_EXPERIMENTAL
+  std::vector<HypoTestInverterResult*> GetFCIntervals(const std::vector<RooAbsData*>& vData,  // datasets
+						      ModelConfig& mc,                        // model definition
+						      double dConf = 0.683,                   // confidence level
+						      double dLow = -1e6,                     // minimum of interval to scan
+						      double dHigh = 1e6,                     // maximum of interval to scan
+						      double dStep = 0.05,                    // step size to scan interval
+						      unsigned int iToys = 10000,             // number of toys to calculate CL(s+b) at each point
+						      unsigned int iWorkers = 1,              // number of parallel workers processing the datasets (0 = one per CPU core)
+						      unsigned int iBlockToys = 0,            // toys per block for sequential toy generation (0 = always iToys toys)
+						      FCMODE eMode = eTOYS                    // use toys or asymptotic formulae (see FCMODE)
+						      );
+  std::vector<HypoTestInverterResult*> GetFCIntervals(const std::vector<RooAbsData*>& vData,  // datasets
+						      ModelConfig& mc,                        // model definition
+						      double dConf,                           // confidence level
+						      const std::vector<double>& vLow,        // minimum of interval to scan for each dataset
+						      const std::vector<double>& vHigh,       // maximum of interval to scan for each dataset
+						      double dStep = 0.05,                    // step size to scan interval
+						      unsigned int iToys = 10000,             // number of toys to calculate CL(s+b) at each point
+						      unsigned int iWorkers = 1,              // number of parallel workers processing the datasets (0 = one per CPU core)
+						      unsigned int iBlockToys = 0,            // toys per block for sequential toy generation (0 = always iToys toys)
+						      FCMODE eMode = eTOYS                    // use toys or asymptotic formulae (see FCMODE)
+						      );
+#else
+  std::vector<HypoTestInverterResult*> GetFCIntervals(const std::vector<RooAbsData*>& vData,  // datasets
+						      ModelConfig& mc,                        // model definition
+						      double dConf = 0.683,                   // confidence level
+						      unsigned int iMaxIterations = 8,        // maximum number of iterations
+						      double dLow = -1e6,                     // minimum of interval to scan
+						      double dHigh = 1e6,                     // maximum of interval to scan
+						      unsigned int iPoints = 11,              // number of points of initial scan
+						      unsigned int iToys = 10000,             // number of toys to calculate CL(s+b) at each point
+						      unsigned int iWorkers = 1,              // number of parallel workers processing the datasets (0 = one per CPU core)
+						      unsigned int iBlockToys = 0,            // toys per block for sequential toy generation (0 = always iToys toys)
+						      FCMODE eMode = eTOYS                    // use toys or asymptotic formulae (see FCMODE)
+						      );
+  std::vector<HypoTestInverterResult*> GetFCIntervals(const std::vector<RooAbsData*>& vData,  // datasets
+						      ModelConfig& mc,                        // model definition
+						      double dConf,                           // confidence level
+						      unsigned int iMaxIterations,            // maximum number of iterations
+						      const std::vector<double>& vLow,        // minimum of interval to scan for each dataset
+						      const std::vector<double>& vHigh,       // maximum of interval to scan for each dataset
+						      unsigned int iPoints = 11,              // number of points of initial scan
+						      unsigned int iToys = 10000,             // number of toys to calculate CL(s+b) at each point
+						      unsigned int iWorkers = 1,              // number of parallel workers processing the datasets (0 = one per CPU core)
+						      unsigned int iBlockToys = 0,            // toys per block for sequential toy generation (0 = always iToys toys)
+						      FCMODE eMode = eTOYS                    // use toys or asymptotic formulae (see FCMODE)
+						      );
+#endif // CG_EXPERIMENTAL
+
+  std::vector<HypoTestInverterResult*> GetUpperLimits(const std::vector<RooAbsData*>& vData,  // datasets
+						      ModelConfig& mc,                        // model definition
+						      bool bUseCLs = true,                    // do CL(s) instead of CL(s+b) upper limits
+						      double dConf = 0.95,                    // confidence level
+						      double dLow = -1e6,                     // minimum of interval to scan
+						      double dHigh = 1e6,                     // maximum of interval to scan
+						      double dPrecision = 0.01,               // desired relative precision on calculated limit
+						      unsigned int iMaxIterations = 20,       // maximum number of iterations to find the limit
+						      int iToys = -1,                         // number of toys at each tested point (-1 = asymptotic formulae)
+						      unsigned int iWorkers = 1               // number of parallel workers processing the datasets (0 = one per CPU core)
+						      );
+  std::vector<HypoTestInverterResult*> GetUpperLimits(const std::vector<RooAbsData*>& vData,  // datasets
+						      ModelConfig& mc,                        // model definition
+						      bool bUseCLs,                           // do CL(s) instead of CL(s+b) upper limits
+						      double dConf,                           // confidence level
+						      const std::vector<double>& vLow,        // minimum of interval to scan for each dataset
+						      const std::vector<double>& vHigh,       // maximum of interval to scan for each dataset
+						      double dPrecision = 0.01,               // desired relative precision on calculated limit
+						      unsigned int iMaxIterations = 20,       // maximum number of iterations to find the limit
+						      int iToys = -1,                         // number of toys at each tested point (-1 = asymptotic formulae)
+						      unsigned int iWorkers = 1               // number of parallel workers processing the datasets (0 = one per CPU core)
+						      );
+
+  // get sampling distribution of the test statistic for the b-only hypothesis (caller takes ownership)
   SamplingDistribution* GetSamplingDist(RooAbsData& data,
 					ModelConfig& mc,
-					int iToys = 1000);
+					int iToys = 1000,
+					unsigned int iWorkers = 1);   // number of parallel workers generating the toys (0 = one per CPU core)
+
+  // bounded-memory summary of the distribution of a non-negative test statistic
+  //
+  // Values are counted (with weights) in logarithmic bins (gamma^(i-1), gamma^i] with
+  // gamma = (1 + dRelAccuracy)/(1 - dRelAccuracy) and values <= 1e-8 in one zero bin. Quantiles are hence
+  // returned with a relative error of at most dRelAccuracy and p-values P(x' >= x) include all values down to
+  // x/gamma (i.e. they are conservative). If more than iMaxBins bins are filled, the lowest bins are merged,
+  // so the upper tail keeps its accuracy. Sketches with the same accuracy can be added (e.g. of workers or
+  // blocks of toys).
+  class TestStatSketch : public TObject
+  {
+  public:
+    TestStatSketch(double dRelAccuracy = 0.01,unsigned int iMaxBins = 2048);
+
+    void Fill(double x,double w = 1);
+    void Fill(const SamplingDistribution& dist);
+    void Add(const TestStatSketch& other);
+
+    // weighted fraction of values >= x and its uncertainty (effective number of entries)
+    double GetPValue(double x) const;
+    double GetPValueError(double x) const;
+    // weighted sampling distribution with one value per bin (upper bin edge) and the bin weight
+    //
+    // Its tail integrals reproduce GetPValue and merging two of them (SamplingDistribution::Add) merges the
+    // sketches, but the errors computed from the bin weights are overestimated. The caller takes ownership.
+    SamplingDistribution* GetSamplingDistribution(const char* sName = "TestStatSketch") const;
+    // value below which the weighted fraction q of the values lie
+    double GetQuantile(double q) const;
+
+    ULong64_t GetEntries() const {return m_iEntries;}
+    double GetSumOfWeights() const {return m_dSumW;}
+    double GetRelAccuracy() const {return m_dRelAccuracy;}
+    unsigned int GetNBins() const {return m_mBins.size();}
+
+  private:
+    // index of the logarithmic bin containing x > 1e-8
+    int GetIndex(double x) const;
+    // merge lowest bins until at most m_iMaxBins bins are left
+    void Collapse();
+
+    double m_dRelAccuracy;            // relative accuracy of quantiles
+    double m_dGamma;                  // ratio of upper and lower bin edges
+    unsigned int m_iMaxBins;          // maximum number of logarithmic bins
+    std::map<int,double> m_mBins;     // sum of weights per logarithmic bin
+    double m_dZeroWeight;             // sum of weights of values <= 1e-8
+    double m_dSumW;                   // sum of weights
+    double m_dSumW2;                  // sum of squared weights
+    ULong64_t m_iEntries;             // number of filled values
+
+    ClassDef(TestStatSketch,1)
+  };
+
+  // sketch of the sampling distribution of the test statistic for the b-only hypothesis
+  //
+  // The toys are generated in blocks of iBlockToys and each block is discarded after filling the sketch, so
+  // the memory does not grow with the number of toys (the sampling distribution store is not used).
+  // The caller takes ownership of the returned sketch.
+  TestStatSketch* GetSamplingDistSketch(RooAbsData& data,             // dataset
+					ModelConfig& mc,              // model definition
+					unsigned int iToys = 1000,    // number of toys
+					double dRelAccuracy = 0.01,   // relative accuracy of the sketch (see TestStatSketch)
+					unsigned int iWorkers = 1,    // number of parallel workers generating the toys (0 = one per CPU core)
+					unsigned int iBlockToys = 100000 // number of toys per block
+					);
+
+  // accumulate toys of hypothesis tests in sketches (see TestStatSketch) with the given relative accuracy
+  //
+  // Toy-based FC intervals and upper limits then generate their toys in blocks (at most 100000 toys) and keep
+  // only the sketches as binned sampling distributions (see TestStatSketch::GetSamplingDistribution), so
+  // scans over many points run in constant memory. Repeated tests of the same point are merged by
+  // HypoTestInverterResult like complete sampling distributions. The sampling distribution store is not used
+  // in this mode. 0 = keep the complete sampling distributions (default).
+  void SetToySketches(double dRelAccuracy = 0.01);
+
+  // performance counters (summed over all worker processes)
+  //
+  // Fits and NLL evaluations are counted for all likelihood fits done by this package. Without the NLL
+  // options (SetCompiledNLL, SetBatchNLL, SetAnalyticGradients), the profile likelihood ratio on toys is
+  // evaluated by RooStats::ProfileLikelihoodTestStat: each evaluation counts as one unconditional and one
+  // conditional fit (the one-sided flavours skip the conditional fit if the value is 0), non-finite values
+  // count as failed fits and the time is booked as test statistic time (their NLL evaluations are not known). Other fits done internally by RooStats (likelihood intervals, profiling of
+  // nuisance parameters for toy generation) are not included. The inversion time covers the complete
+  // calculation of FC intervals and upper limits and therefore includes the other phases.
+  struct PerfCounters
+  {
+    ULong64_t iFits;                  // number of minimisations
+    ULong64_t iNLLEvaluations;        // number of NLL evaluations during minimisations
+    ULong64_t iToys;                  // number of generated toy datasets
+    ULong64_t iFailedFits;            // number of minimisations with Minuit status != 0
+    double dGenerationTime;           // wall time for generating toys in seconds
+    double dUncondFitTime;            // wall time of unconditional fits in seconds
+    double dCondFitTime;              // wall time of conditional fits in seconds
+    double dTestStatTime;             // wall time of test statistic evaluations by RooStats in seconds
+    double dInversionTime;            // wall time of hypothesis test inversions in seconds
+  };
+
+  // counters accumulated since the start of the programme or the last reset
+  PerfCounters GetPerfCounters();
+
+  // counters of the last completed call to one of the functions above
+  PerfCounters GetLastCallPerfCounters();
+
+  // reset accumulated counters
+  void ResetPerfCounters();
+
+  // print counters
+  void PrintPerfCounters(const PerfCounters& counters);
+
+  class ModelClone;
+  struct SessionState;
+
+  // independent state for several calculations in one programme
+  //
+  // A session owns a copy of the model (workspace with all datasets, current parameter values and ranges)
+  // and its own options (SetBinnedFits, SetToySketches, SetCompiledNLL, SetBatchNLL, SetAnalyticGradients),
+  // Asimov cache, sampling distribution store, checkpoint file, performance counters and verbosity. The
+  // options are initialised with the current settings. While a Scope of the session exists, all functions
+  // above called in the same thread use the state of the session. Changes of the model done by the
+  // calculations (e.g. of the POI range or of the global observables) therefore only affect the copy.
+  // Example:
+  //
+  //   Session session(mc);
+  //   {
+  //     Session::Scope scope(session);
+  //     HypoTestInverterResult* pResult = GetUpperLimit(*session.GetData("obsData"),session.GetModel());
+  //     ...
+  //   }
+  //
+  // Sessions isolate state, they do not run calculations concurrently: RooFit, its random number generator
+  // and ROOT I/O are not thread-safe, so the calls of the functions above (and the construction and
+  // destruction of sessions) are serialised by a process-wide lock. Worker processes are forked as without
+  // sessions, so no other thread may use ROOT while a call with several workers runs.
+  class Session
+  {
+  public:
+    explicit Session(const ModelConfig& mc);
+    ~Session();
+
+    // copy of the model and of its datasets
+    ModelConfig& GetModel();
+    RooAbsData* GetData(const char* sName);
+
+    // verbosity of calls in the scopes of this session (initialised with iVERBOSITY)
+    VERBOSITY GetVerbosity() const;
+    void SetVerbosity(VERBOSITY eVerbosity);
+
+    // activates the session in the current thread until destruction (restores the previous state)
+    class Scope
+    {
+    public:
+      explicit Scope(Session& session);
+      ~Scope();
+
+    private:
+      Scope(const Scope&);
+      Scope& operator=(const Scope&);
+
+      SessionState* m_pPrevious;
+    };
+
+  private:
+    Session(const Session&);
+    Session& operator=(const Session&);
+
+    ModelClone* m_pClone;
+    SessionState* m_pState;
+  };
 }
+
+#endif // CG_ROOSTATSTOOLS_H
@@ -3,7 +3,33 @@
 #pragma link C++ namespace CG_Statistics;
 #pragma link C++ function CG_Statistics::GetFCInterval;
 #pragma link C++ function CG_Statistics::GetLikelihoodInterval;
+#pragma link C++ function CG_Statistics::GetProfileLikelihoodScan;
 #pragma link C++ function CG_Statistics::GetSignificance;
 #pragma link C++ function CG_Statistics::GetUpperLimit;
+#pragma link C++ struct CG_Statistics::ExpectedLimits+;
+#pragma link C++ function CG_Statistics::GetExpectedLimits;
+#pragma link C++ function CG_Statistics::ClearAsimovCache;
+#pragma link C++ function CG_Statistics::SetSamplingDistStore;
+#pragma link C++ function CG_Statistics::SetCheckpointFile;
+#pragma link C++ function CG_Statistics::GenerateToyShard;
+#pragma link C++ function CG_Statistics::MergeToyShards;
+#pragma link C++ function CG_Statistics::SetBinnedFits;
+#pragma link C++ function CG_Statistics::GetBinningBias;
+#pragma link C++ function CG_Statistics::SetCompiledNLL;
+#pragma link C++ function CG_Statistics::SetBatchNLL;
+#pragma link C++ function CG_Statistics::SetAnalyticGradients;
+#pragma link C++ class CG_Statistics::TestStatSketch+;
+#pragma link C++ function CG_Statistics::GetSamplingDistSketch;
+#pragma link C++ function CG_Statistics::SetToySketches;
+#pragma link C++ function CG_Statistics::GetLikelihoodIntervals;
+#pragma link C++ function CG_Statistics::GetFCIntervals;
+#pragma link C++ function CG_Statistics::GetUpperLimits;
+#pragma link C++ struct CG_Statistics::PerfCounters+;
+#pragma link C++ function CG_Statistics::GetPerfCounters;
+#pragma link C++ function CG_Statistics::GetLastCallPerfCounters;
+#pragma link C++ function CG_Statistics::ResetPerfCounters;
+#pragma link C++ function CG_Statistics::PrintPerfCounters;
+#pragma link C++ class CG_Statistics::Session;
+#pragma link C++ class CG_Statistics::Session::Scope;
 
 #endif // __CINT__
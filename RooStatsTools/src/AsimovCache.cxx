@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+#include "RooAbsData.h"
+#include "RooAbsPdf.h"
+#include "RooRealVar.h"
+#include "RooArgSet.h"
+using namespace RooFit;
+
+#include "RooStats/ModelConfig.h"
+#include "RooStats/AsymptoticCalculator.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "AsimovCache.h"
+#include "SessionState.h"
+#include "AsymptoticTools.h"
+#include "Fingerprint.h"
+
+namespace CG_Statistics
+{
+  AsimovCache::~AsimovCache()
+  {
+    Clear();
+  }
+
+  AsimovCache& AsimovCache::Instance()
+  {
+    return GetSessionState().asimovCache;
+  }
+
+  void AsimovCache::Clear()
+  {
+    for(auto& entry : m_mEntries)
+    {
+      delete entry.second->pAsimovData;
+      delete entry.second;
+    }
+    m_mEntries.clear();
+    m_pData = 0;
+  }
+
+  AsimovCache::Entry& AsimovCache::GetEntry(RooAbsData& data,ModelConfig& mc,double dMuPrime)
+  {
+    RooAbsPdf* pPDF = mc.GetPdf();
+    assert(pPDF);
+
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+    assert(pPOI);
+
+    // entries of another dataset are not needed any more
+    if(m_pData != &data)
+    {
+      Clear();
+      m_pData = &data;
+    }
+
+    // identify model by its structure and constant parameters (including the range of the POI)
+    ULong64_t iHash = GetPdfHash(*pPDF);
+
+    // global observables
+    const RooArgSet* pGlobalObservables = mc.GetGlobalObservables();
+    if(pGlobalObservables)
+      iHash = HashCombine(iHash,GetValuesHash(*pGlobalObservables));
+
+    std::pair<ULong64_t,double> key(iHash,dMuPrime);
+    auto it = m_mEntries.find(key);
+    if(it != m_mEntries.end())
+      return *it->second;
+
+    if(iVERBOSITY >= eDEBUG)
+      std::cout << "build Asimov dataset for " << pPOI->GetName() << " = " << dMuPrime << std::endl;
+
+    // store global observables
+    RooArgSet* allVars = pPDF->getVariables();
+    RooArgSet globObs;
+    if(pGlobalObservables)
+      pGlobalObservables->snapshot(globObs);
+
+    // build Asimov dataset
+    Entry* pEntry = new Entry;
+    RooArgSet globs;
+    pPOI->setVal(dMuPrime);
+    pEntry->pAsimovData = AsymptoticCalculator::MakeAsimovData(data,mc,*pPOI,globs);
+    globs.snapshot(pEntry->globs);
+    pEntry->dSigma = 0;
+    assert(pEntry->pAsimovData);
+
+    // reset global observables
+    *allVars = globObs;
+    delete allVars;
+
+    m_mEntries[key] = pEntry;
+
+    return *pEntry;
+  }
+
+  RooAbsData* AsimovCache::GetAsimovData(RooAbsData& data,ModelConfig& mc,double dMuPrime,const RooArgSet** pGlobs)
+  {
+    Entry& entry = GetEntry(data,mc,dMuPrime);
+    if(pGlobs)
+      *pGlobs = &entry.globs;
+
+    return entry.pAsimovData;
+  }
+
+  double AsimovCache::GetSigma(RooAbsData& data,ModelConfig& mc,double dMuPrime)
+  {
+    Entry& entry = GetEntry(data,mc,dMuPrime);
+    if(entry.dSigma > 0)
+      return entry.dSigma;
+
+    RooAbsPdf* pPDF = mc.GetPdf();
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+
+    // store global observables
+    const RooArgSet* pGlobalObservables = mc.GetGlobalObservables();
+    RooArgSet* allVars = pPDF->getVariables();
+    RooArgSet globObs;
+    if(pGlobalObservables)
+      pGlobalObservables->snapshot(globObs);
+
+    // set global observables of Asimov dataset
+    *allVars = entry.globs;
+
+    // evaluate q_mu_A for a test value of mu
+    double dMuEval = std::min(pPOI->getMax(),dMuPrime + pPOI->getError());
+    pPOI->setVal(dMuEval);
+
+    // arxiv:1007.1727v3 equation 54
+    entry.dSigma = (dMuEval - dMuPrime) / sqrt(EvaluateQMu(*entry.pAsimovData,*pPDF,*pPOI,dMuEval));
+    if(!IsValidSigma(entry.dSigma) && (iVERBOSITY >= eWARNING))
+      std::cout << "sigma(" << pPOI->GetName() << " = " << dMuPrime << ") of Asimov dataset is " << entry.dSigma << std::endl;
+
+    // reset global observables
+    *allVars = globObs;
+    delete allVars;
+
+    return entry.dSigma;
+  }
+
+  void ClearAsimovCache()
+  {
+    AsimovCache::Instance().Clear();
+  }
+}
@@ -0,0 +1,75 @@
+#ifndef CG_ASIMOVCACHE_H
+#define CG_ASIMOVCACHE_H
+
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include "RtypesCore.h"
+#include "RooArgSet.h"
+
+class RooAbsData;
+namespace RooStats
+{
+  class ModelConfig;
+}
+
+namespace CG_Statistics
+{
+  // cache of Asimov datasets and sigma(mu') values
+  //
+  // Entries are keyed on the model (structure of the pdf, ranges and constant flags of its variables and
+  // values of the constant ones, see GetPdfHash), the values of the global observables and the POI value mu'
+  // used to generate the Asimov dataset. The cache only holds entries for one observed dataset (the nuisance
+  // parameters of the Asimov datasets are profiled on it) and is cleared when another dataset is requested
+  // and at the end of each call to a public function (see CallScope). Each Asimov dataset is hence built and
+  // fitted only once per call, e.g. for all iterations of an upper limit and the expected limits.
+  class AsimovCache
+  {
+  public:
+    AsimovCache(): m_pData(0) {}
+    ~AsimovCache();
+
+    // Asimov dataset generated with poi = dMuPrime (owned by the cache)
+    // the matching values of the global observables are returned in pGlobs (if given)
+    RooAbsData* GetAsimovData(RooAbsData& data,
+			      RooStats::ModelConfig& mc,
+			      double dMuPrime,
+			      const RooArgSet** pGlobs = 0);
+
+    // sigma(mu') evaluated on the Asimov dataset generated with poi = dMuPrime (arxiv:1007.1727v3 equation 54)
+    // (not valid if it cannot be evaluated, e.g. for a POI without uncertainty or at its upper bound)
+    double GetSigma(RooAbsData& data,RooStats::ModelConfig& mc,double dMuPrime);
+
+    // delete all entries
+    void Clear();
+
+    // number of cached Asimov datasets
+    unsigned int GetSize() const {return m_mEntries.size();}
+
+    // cache of the active session (see Session)
+    static AsimovCache& Instance();
+
+  private:
+    AsimovCache(const AsimovCache&);
+    AsimovCache& operator=(const AsimovCache&);
+
+    struct Entry
+    {
+      RooAbsData* pAsimovData;     // Asimov dataset
+      RooArgSet globs;             // values of global observables belonging to the Asimov dataset
+      double dSigma;               // sigma(mu') (<= 0 if not yet evaluated)
+    };
+
+    Entry& GetEntry(RooAbsData& data,RooStats::ModelConfig& mc,double dMuPrime);
+
+    // dataset of the cached entries (only compared, never dereferenced)
+    const RooAbsData* m_pData;
+    std::map<std::pair<ULong64_t,double>,Entry*> m_mEntries;
+  };
+
+  // true if sigma(mu') could be evaluated (see AsimovCache::GetSigma)
+  inline bool IsValidSigma(double dSigma) {return (dSigma > 0) && std::isfinite(dSigma);}
+}
+
+#endif // CG_ASIMOVCACHE_H
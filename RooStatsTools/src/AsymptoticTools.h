@@ -0,0 +1,33 @@
+#ifndef CG_ASYMPTOTICTOOLS_H
+#define CG_ASYMPTOTICTOOLS_H
+
+class RooAbsData;
+class RooAbsPdf;
+class RooRealVar;
+
+namespace CG_Statistics
+{
+  // q_mu for the tested value dMuTest of the POI (arxiv:1007.1727v3 equation 14)
+  double EvaluateQMu(RooAbsData& data,RooAbsPdf& pdf,RooRealVar& poi,double dMuTest);
+
+  // lets a non-negative POI go negative (min = -max) for the lifetime of the object
+  //
+  // Upper limits are calculated with this range such that mu^hat may become negative (arxiv:1007.1727v3
+  // section 3.6). The range is also part of the key of the Asimov cache. The old minimum is restored at
+  // destruction.
+  class NegativePOIRange
+  {
+  public:
+    explicit NegativePOIRange(RooRealVar& poi);
+    ~NegativePOIRange();
+
+  private:
+    NegativePOIRange(const NegativePOIRange&);
+    NegativePOIRange& operator=(const NegativePOIRange&);
+
+    RooRealVar& m_poi;
+    double m_dOldMin;
+  };
+}
+
+#endif // CG_ASYMPTOTICTOOLS_H
@@ -0,0 +1,779 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "TString.h"
+
+#include "RooAbsData.h"
+#include "RooAbsPdf.h"
+#include "RooProdPdf.h"
+#include "RooRealVar.h"
+#include "RooConstVar.h"
+#include "RooArgSet.h"
+#include "RooArgList.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "BatchNLL.h"
+#include "NLLTranslator.h"
+#include "SessionState.h"
+
+// kernels with AVX2/AVX-512 variants (selected at runtime)
+#if defined(__GNUC__) && defined(__x86_64__)
+#define CG_BATCH_X86
+#endif
+
+namespace CG_Statistics
+{
+  // kernels compiled for one instruction set
+  struct BatchKernels
+  {
+    const char* sName;
+    void (*pGaussian)(const double*,unsigned int,double,double,double,double*);
+    void (*pExponential)(const double*,unsigned int,double,double,double*);
+    void (*pPolynomial)(const double*,unsigned int,const double*,unsigned int,double,double*);
+    void (*pAdd)(const double*,unsigned int,double,double*);
+    double (*pWeightedLogSum)(const double*,const double*,unsigned int);
+    void (*pQuadraticTimes)(const double*,const double*,unsigned int,double,double,double,double*);
+    void (*pPowerMinus)(const double*,const double*,unsigned int,unsigned int,double,double,double*);
+    double (*pWeightedRatioSum)(const double*,const double*,const double*,unsigned int);
+  };
+
+  namespace
+  {
+    // pdf structures checked against the RooFit NLL (true = passed)
+    std::map<std::string,bool> gChecked;
+    // shared by all sessions
+    std::mutex gCheckedMutex;
+
+    // number of events evaluated at once (buffers of all nodes stay in the cache)
+    const unsigned int iBlockSize = 1024;
+
+    // helpers are inlined into the kernels of each instruction set and must not use library calls
+    // (which would prevent vectorisation)
+    inline __attribute__((always_inline)) double FromBits(ULong64_t iBits)
+    {
+      double dValue;
+      std::memcpy(&dValue,&iBits,sizeof(dValue));
+      return dValue;
+    }
+
+    inline __attribute__((always_inline)) ULong64_t ToBits(double dValue)
+    {
+      ULong64_t iBits;
+      std::memcpy(&iBits,&dValue,sizeof(dValue));
+      return iBits;
+    }
+
+    // exp(x) with a relative accuracy of ~1e-16 (results below 1e-307 are not flushed to zero)
+    inline __attribute__((always_inline)) double BatchExp(double x)
+    {
+      x = (x < -708.) ? -708. : ((x > 709.) ? 709. : x);
+
+      // x = n ln(2) + r with |r| <= ln(2)/2 (adding 1.5 * 2^52 rounds to the closest integer n which ends
+      // up in the lowest bits of the mantissa)
+      const double dShifted = x * 1.4426950408889634 + 6755399441055744.;
+      const double dN = dShifted - 6755399441055744.;
+      const double r = (x - dN * 6.93147180369123816490e-01) - dN * 1.90821492927058770002e-10;
+
+      // Taylor series up to r^13
+      double p = 1. / 6227020800.;
+      p = p * r + 1. / 479001600.;
+      p = p * r + 1. / 39916800.;
+      p = p * r + 1. / 3628800.;
+      p = p * r + 1. / 362880.;
+      p = p * r + 1. / 40320.;
+      p = p * r + 1. / 5040.;
+      p = p * r + 1. / 720.;
+      p = p * r + 1. / 120.;
+      p = p * r + 1. / 24.;
+      p = p * r + 1. / 6.;
+      p = p * r + 0.5;
+      p = p * r + 1.;
+      p = p * r + 1.;
+
+      // 2^n from the exponent bits
+      return p * FromBits((ToBits(dShifted) + 1023) << 52);
+    }
+
+    // log(x) with a relative accuracy of ~1e-16 (for normalised positive x)
+    inline __attribute__((always_inline)) double BatchLog(double x)
+    {
+      // x = 2^e m with m in [sqrt(1/2),sqrt(2))
+      const ULong64_t iBits = ToBits(x);
+      double dE = FromBits((iBits >> 52) | 0x4330000000000000ULL) - (4503599627370496. + 1023.);
+      double m = FromBits((iBits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL);
+      const bool bHigh = (m > 1.4142135623730951);
+      m = bHigh ? 0.5 * m : m;
+      dE = bHigh ? dE + 1. : dE;
+
+      // log(m) = 2 atanh(s) with s = (m - 1)/(m + 1) and |s| < 0.172 as series up to s^19
+      const double s = (m - 1.) / (m + 1.);
+      const double s2 = s * s;
+      double p = 1. / 19.;
+      p = p * s2 + 1. / 17.;
+      p = p * s2 + 1. / 15.;
+      p = p * s2 + 1. / 13.;
+      p = p * s2 + 1. / 11.;
+      p = p * s2 + 1. / 9.;
+      p = p * s2 + 1. / 7.;
+      p = p * s2 + 1. / 5.;
+      p = p * s2 + 1. / 3.;
+      p = p * s2 + 1.;
+      const double dLog = dE * 6.93147180369123816490e-01 + (dE * 1.90821492927058770002e-10 + 2. * s * p);
+
+      if(x > 0)
+	return (x < std::numeric_limits<double>::infinity()) ? dLog : x;
+      return (x == 0) ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    // out = scale * exp(-0.5 ((x - mean) / sigma)^2)
+    inline __attribute__((always_inline)) void GaussianLoop(const double* x,unsigned int n,double dMean,double dInvSigma,double dScale,double* out)
+    {
+      for(unsigned int i = 0; i < n; ++i)
+      {
+	const double t = (x[i] - dMean) * dInvSigma;
+	out[i] = dScale * BatchExp(-0.5 * t * t);
+      }
+    }
+
+    // out = scale * exp(c x)
+    inline __attribute__((always_inline)) void ExponentialLoop(const double* x,unsigned int n,double dSlope,double dScale,double* out)
+    {
+      for(unsigned int i = 0; i < n; ++i)
+	out[i] = dScale * BatchExp(dSlope * x[i]);
+    }
+
+    // out = scale * (1 + c_0 x + c_1 x^2 + ...)
+    inline __attribute__((always_inline)) void PolynomialLoop(const double* x,unsigned int n,const double* pCoefs,unsigned int iCoefs,double dScale,double* out)
+    {
+      for(unsigned int i = 0; i < n; ++i)
+	out[i] = (iCoefs > 0) ? pCoefs[iCoefs - 1] : 0;
+      for(unsigned int k = iCoefs; k-- > 1;)
+      {
+	const double c = pCoefs[k - 1];
+	for(unsigned int i = 0; i < n; ++i)
+	  out[i] = out[i] * x[i] + c;
+      }
+      for(unsigned int i = 0; i < n; ++i)
+	out[i] = dScale * (1. + x[i] * out[i]);
+    }
+
+    // out += coef * in
+    inline __attribute__((always_inline)) void AddLoop(const double* in,unsigned int n,double dCoef,double* out)
+    {
+      for(unsigned int i = 0; i < n; ++i)
+	out[i] += dCoef * in[i];
+    }
+
+    // out = f * (q_0 + q_1 x + q_2 x^2)
+    inline __attribute__((always_inline)) void QuadraticTimesLoop(const double* x,const double* f,unsigned int n,double q0,double q1,double q2,double* out)
+    {
+      for(unsigned int i = 0; i < n; ++i)
+	out[i] = f[i] * (q0 + x[i] * (q1 + x[i] * q2));
+    }
+
+    // out = s x^k - c f
+    inline __attribute__((always_inline)) void PowerMinusLoop(const double* x,const double* f,unsigned int n,unsigned int iPower,double s,double c,double* out)
+    {
+      for(unsigned int i = 0; i < n; ++i)
+	out[i] = s;
+      for(unsigned int k = 0; k < iPower; ++k)
+      {
+	for(unsigned int i = 0; i < n; ++i)
+	  out[i] *= x[i];
+      }
+      for(unsigned int i = 0; i < n; ++i)
+	out[i] -= c * f[i];
+    }
+
+    // sum_i w_i d_i / f_i (same summation order as WeightedLogSumLoop)
+    inline __attribute__((always_inline)) double WeightedRatioSumLoop(const double* d,const double* f,const double* w,unsigned int n)
+    {
+      double vSums[8] = {0,0,0,0,0,0,0,0};
+      unsigned int i = 0;
+      for(; i + 8 <= n; i += 8)
+      {
+	for(unsigned int j = 0; j < 8; ++j)
+	  vSums[j] += w[i + j] * d[i + j] / f[i + j];
+      }
+      for(unsigned int j = 0; i < n; ++i, ++j)
+	vSums[j] += w[i] * d[i] / f[i];
+
+      return ((vSums[0] + vSums[4]) + (vSums[2] + vSums[6])) + ((vSums[1] + vSums[5]) + (vSums[3] + vSums[7]));
+    }
+
+    // sum_i w_i log(v_i) (in eight partial sums, so all instruction sets add in the same order and give
+    // identical results)
+    inline __attribute__((always_inline)) double WeightedLogSumLoop(const double* v,const double* w,unsigned int n)
+    {
+      double vSums[8] = {0,0,0,0,0,0,0,0};
+      unsigned int i = 0;
+      for(; i + 8 <= n; i += 8)
+      {
+	for(unsigned int j = 0; j < 8; ++j)
+	  vSums[j] += w[i + j] * BatchLog(v[i + j]);
+      }
+      for(unsigned int j = 0; i < n; ++i, ++j)
+	vSums[j] += w[i] * BatchLog(v[i]);
+
+      return ((vSums[0] + vSums[4]) + (vSums[2] + vSums[6])) + ((vSums[1] + vSums[5]) + (vSums[3] + vSums[7]));
+    }
+
+
+#define CG_BATCH_KERNELS(NAME,TARGET)					\
+    namespace NAME							\
+    {									\
+      TARGET void Gaussian(const double* x,unsigned int n,double dMean,double dInvSigma,double dScale,double* out) \
+      {GaussianLoop(x,n,dMean,dInvSigma,dScale,out);}			\
+      TARGET void Exponential(const double* x,unsigned int n,double dSlope,double dScale,double* out) \
+      {ExponentialLoop(x,n,dSlope,dScale,out);}				\
+      TARGET void Polynomial(const double* x,unsigned int n,const double* pCoefs,unsigned int iCoefs,double dScale,double* out) \
+      {PolynomialLoop(x,n,pCoefs,iCoefs,dScale,out);}			\
+      TARGET void Add(const double* in,unsigned int n,double dCoef,double* out) \
+      {AddLoop(in,n,dCoef,out);}					\
+      TARGET double WeightedLogSum(const double* v,const double* w,unsigned int n) \
+      {return WeightedLogSumLoop(v,w,n);}				\
+      TARGET void QuadraticTimes(const double* x,const double* f,unsigned int n,double q0,double q1,double q2,double* out) \
+      {QuadraticTimesLoop(x,f,n,q0,q1,q2,out);}				\
+      TARGET void PowerMinus(const double* x,const double* f,unsigned int n,unsigned int iPower,double s,double c,double* out) \
+      {PowerMinusLoop(x,f,n,iPower,s,c,out);}				\
+      TARGET double WeightedRatioSum(const double* d,const double* f,const double* w,unsigned int n) \
+      {return WeightedRatioSumLoop(d,f,w,n);}				\
+      const BatchKernels kernels = {#NAME,&Gaussian,&Exponential,&Polynomial,&Add,&WeightedLogSum, \
+				    &QuadraticTimes,&PowerMinus,&WeightedRatioSum}; \
+    }
+
+    CG_BATCH_KERNELS(generic,)
+#ifdef CG_BATCH_X86
+    CG_BATCH_KERNELS(AVX2,__attribute__((target("avx2"))))
+    CG_BATCH_KERNELS(AVX512,__attribute__((target("avx512f"))))
+#endif // CG_BATCH_X86
+
+#undef CG_BATCH_KERNELS
+
+    // best kernels supported by this CPU
+    const BatchKernels& GetKernels()
+    {
+#ifdef CG_BATCH_X86
+      static const BatchKernels& kernels = __builtin_cpu_supports("avx512f") ? AVX512::kernels :
+	(__builtin_cpu_supports("avx2") ? AVX2::kernels : generic::kernels);
+#else
+      static const BatchKernels& kernels = generic::kernels;
+#endif // CG_BATCH_X86
+
+      return kernels;
+    }
+  }
+
+  bool UseBatchNLL()
+  {
+    return GetSessionState().options.bBatchNLL;
+  }
+
+  void SetBatchNLL(bool bBatch)
+  {
+    GetSessionState().options.bBatchNLL = bBatch;
+  }
+
+  const char* BatchNLL::GetInstructionSet()
+  {
+    return GetKernels().sName;
+  }
+
+  BatchNLL::BatchNLL(const char* name,const RooArgList& params,const std::vector<Node>& vNodes,
+		     const std::vector<Constraint>& vConstraints,bool bExtended,
+		     double dMin,double dMax,const std::vector<double>& vX,const std::vector<double>& vW):
+    RooAbsReal(name,"batch NLL"),
+    m_params("params","parameters",this),
+    m_vNodes(vNodes),
+    m_vConstraints(vConstraints),
+    m_bExtended(bExtended),
+    m_dMin(dMin),
+    m_dMax(dMax),
+    m_vX(vX),
+    m_vW(vW),
+    m_dSumW(0),
+    m_vBuffers(vNodes.size() * iBlockSize),
+    m_vDerivBuffers(vNodes.size() * iBlockSize)
+  {
+    m_params.add(params);
+    for(double w : m_vW)
+      m_dSumW += w;
+  }
+
+  BatchNLL::BatchNLL(const BatchNLL& other,const char* name):
+    RooAbsReal(other,name),
+    m_params("params",this,other.m_params),
+    m_vNodes(other.m_vNodes),
+    m_vConstraints(other.m_vConstraints),
+    m_bExtended(other.m_bExtended),
+    m_dMin(other.m_dMin),
+    m_dMax(other.m_dMax),
+    m_vX(other.m_vX),
+    m_vW(other.m_vW),
+    m_dSumW(other.m_dSumW),
+    m_vBuffers(other.m_vBuffers.size()),
+    m_vDerivBuffers(other.m_vDerivBuffers.size())
+  {}
+
+  bool BatchNLL::HasGradient() const
+  {
+    for(int i = 0; i < m_params.getSize(); ++i)
+    {
+      if(!dynamic_cast<const RooRealVar*>(m_params.at(i)) && !dynamic_cast<const RooConstVar*>(m_params.at(i)))
+	return false;
+    }
+
+    return true;
+  }
+
+  double BatchNLL::PrepareNodes() const
+  {
+    const double a = m_dMin;
+    const double b = m_dMax;
+    double dExpected = 0;
+    for(auto& node : m_vNodes)
+    {
+      std::vector<double> vValues;
+      for(unsigned int iParam : node.vParams)
+	vValues.push_back(((RooAbsReal&)m_params[iParam]).getVal());
+
+      node.vConstants.clear();
+      switch(node.eType)
+      {
+      case Node::eGAUSSIAN:
+	{
+	  // {mean, 1/sigma, 1/norm}
+	  const double dMean = vValues.at(0);
+	  const double dSigma = vValues.at(1);
+	  const double A = (a - dMean) / (sqrt(2.) * dSigma);
+	  const double B = (b - dMean) / (sqrt(2.) * dSigma);
+	  const double dNorm = GaussianIntegral(dMean,dSigma,a,b);
+	  node.vConstants = {dMean,1. / dSigma,1. / dNorm};
+
+	  // d log(f)/d mean = (x - mean)/sigma^2 - dN/d mean / N
+	  // d log(f)/d sigma = (x - mean)^2/sigma^3 - dN/d sigma / N
+	  const double dNormMean = exp(-A * A) - exp(-B * B);
+	  const double dNormSigma = dNorm / dSigma + sqrt(2.) * (A * exp(-A * A) - B * exp(-B * B));
+	  const double s2 = 1. / (dSigma * dSigma);
+	  const double s3 = s2 / dSigma;
+	  node.vDerivatives = {-dMean * s2 - dNormMean / dNorm,s2,0,
+			       dMean * dMean * s3 - dNormSigma / dNorm,-2 * dMean * s3,s3};
+	  break;
+	}
+      case Node::eEXPONENTIAL:
+	{
+	  // {c, 1/norm}
+	  const double c = vValues.at(0);
+	  const double dNorm = ExponentialIntegral(c,a,b);
+	  node.vConstants = {c,1. / dNorm};
+
+	  // d log(f)/dc = x - dN/dc / N (expanded for small c to avoid cancellations)
+	  const double dLogNormSlope = (fabs(c * (b - a)) < 1e-3) ? 0.5 * (a + b) + c * (b - a) * (b - a) / 12 :
+	    ((b * exp(c * b) - a * exp(c * a)) / c - dNorm / c) / dNorm;
+	  node.vDerivatives = {-dLogNormSlope,1,0};
+	  break;
+	}
+      case Node::ePOLYNOMIAL:
+	{
+	  // {1/norm, c_0, c_1, ...}
+	  double dNorm = b - a;
+	  for(unsigned int k = 0; k < vValues.size(); ++k)
+	    dNorm += vValues[k] * (pow(b,k + 2.) - pow(a,k + 2.)) / (k + 2.);
+	  node.vConstants.push_back(1. / dNorm);
+	  node.vConstants.insert(node.vConstants.end(),vValues.begin(),vValues.end());
+
+	  // df/dc_k = x^(k+1)/N - f I_k/N with I_k = integral of x^(k+1)
+	  node.vDerivatives.clear();
+	  for(unsigned int k = 0; k < vValues.size(); ++k)
+	  {
+	    node.vDerivatives.push_back(1. / dNorm);
+	    node.vDerivatives.push_back((pow(b,k + 2.) - pow(a,k + 2.)) / (k + 2.) / dNorm);
+	    node.vDerivatives.push_back(0);
+	  }
+	  break;
+	}
+      case Node::eSUM:
+	{
+	  // normalised coefficients of all components
+	  double dSum = 0;
+	  for(double dCoef : vValues)
+	    dSum += dCoef;
+	  if(node.bYields)
+	  {
+	    for(double dCoef : vValues)
+	      node.vConstants.push_back(dCoef / dSum);
+	    node.vDerivatives = {1. / dSum};
+	    dExpected = dSum;
+	  }
+	  else
+	  {
+	    node.vConstants = vValues;
+	    node.vConstants.push_back(1. - dSum);
+	  }
+	  break;
+	}
+      }
+    }
+
+    return dExpected;
+  }
+
+  void BatchNLL::EvaluateBlock(const BatchKernels& kernels,unsigned int iFirst,unsigned int n) const
+  {
+    const double* x = &m_vX[iFirst];
+    for(unsigned int iNode = 0; iNode < m_vNodes.size(); ++iNode)
+    {
+      const Node& node = m_vNodes[iNode];
+      const std::vector<double>& c = node.vConstants;
+      double* out = &m_vBuffers[iNode * iBlockSize];
+      switch(node.eType)
+      {
+      case Node::eGAUSSIAN:
+	kernels.pGaussian(x,n,c[0],c[1],c[2],out);
+	break;
+      case Node::eEXPONENTIAL:
+	kernels.pExponential(x,n,c[0],c[1],out);
+	break;
+      case Node::ePOLYNOMIAL:
+	kernels.pPolynomial(x,n,c.data() + 1,c.size() - 1,c[0],out);
+	break;
+      case Node::eSUM:
+	std::fill(out,out + n,0.);
+	for(unsigned int k = 0; k < node.vChildren.size(); ++k)
+	  kernels.pAdd(&m_vBuffers[node.vChildren[k] * iBlockSize],n,c[k],out);
+	break;
+      }
+    }
+  }
+
+  bool BatchNLL::EvaluateDerivativeBlock(const BatchKernels& kernels,unsigned int iFirst,unsigned int n,unsigned int iParam) const
+  {
+    // forward propagation of df/dp from the components to the sums (false = derivative vanishes)
+    const double* x = &m_vX[iFirst];
+    std::vector<bool> vNonZero(m_vNodes.size(),false);
+    for(unsigned int iNode = 0; iNode < m_vNodes.size(); ++iNode)
+    {
+      const Node& node = m_vNodes[iNode];
+      const double* f = &m_vBuffers[iNode * iBlockSize];
+      double* out = &m_vDerivBuffers[iNode * iBlockSize];
+      for(unsigned int j = 0; j < node.vParams.size(); ++j)
+      {
+	if(node.vParams[j] != iParam)
+	  continue;
+
+	const double* q = (node.eType != Node::eSUM) ? &node.vDerivatives[3 * j] : 0;
+	switch(node.eType)
+	{
+	case Node::eGAUSSIAN:
+	case Node::eEXPONENTIAL:
+	  kernels.pQuadraticTimes(x,f,n,q[0],q[1],q[2],out);
+	  vNonZero[iNode] = true;
+	  break;
+	case Node::ePOLYNOMIAL:
+	  kernels.pPowerMinus(x,f,n,j + 1,q[0],q[1],out);
+	  vNonZero[iNode] = true;
+	  break;
+	case Node::eSUM:
+	  if(!vNonZero[iNode])
+	    std::fill(out,out + n,0.);
+	  vNonZero[iNode] = true;
+	  // df/dN_j = (f_j - f)/N for yields and df/dc_j = f_j - f_last for fractions
+	  if(node.bYields)
+	  {
+	    kernels.pAdd(&m_vBuffers[node.vChildren[j] * iBlockSize],n,node.vDerivatives[0],out);
+	    kernels.pAdd(f,n,-node.vDerivatives[0],out);
+	  }
+	  else
+	  {
+	    kernels.pAdd(&m_vBuffers[node.vChildren[j] * iBlockSize],n,1,out);
+	    kernels.pAdd(&m_vBuffers[node.vChildren.back() * iBlockSize],n,-1,out);
+	  }
+	  break;
+	}
+      }
+
+      if(node.eType == Node::eSUM)
+      {
+	for(unsigned int k = 0; k < node.vChildren.size(); ++k)
+	{
+	  if(!vNonZero[node.vChildren[k]])
+	    continue;
+	  if(!vNonZero[iNode])
+	    std::fill(out,out + n,0.);
+	  vNonZero[iNode] = true;
+	  kernels.pAdd(&m_vDerivBuffers[node.vChildren[k] * iBlockSize],n,node.vConstants[k],out);
+	}
+      }
+    }
+
+    return vNonZero.back();
+  }
+
+  double BatchNLL::EvaluateConstraints(std::vector<double>* pGradient) const
+  {
+    double dNLL = 0;
+    for(auto& constraint : m_vConstraints)
+    {
+      // 0.5 ((p - g)/sigma)^2 + log(N) with N = integral of the Gaussian over the range [a,b] of p
+      const RooRealVar& param = (const RooRealVar&)m_params[constraint.iParam];
+      const double p = param.getVal();
+      const double g = ((RooAbsReal&)m_params[constraint.iValue]).getVal();
+      const double dSigma = ((RooAbsReal&)m_params[constraint.iSigma]).getVal();
+      const double a = param.getMin();
+      const double b = param.getMax();
+      const double dNorm = GaussianIntegral(g,dSigma,a,b);
+      const double t = (p - g) / dSigma;
+      dNLL += 0.5 * t * t + log(dNorm);
+
+      if(pGradient)
+      {
+	// same derivatives of the normalisation as for Gaussian nodes (with g as mean)
+	const double A = (a - g) / (sqrt(2.) * dSigma);
+	const double B = (b - g) / (sqrt(2.) * dSigma);
+	const double dNormMean = exp(-A * A) - exp(-B * B);
+	const double dNormSigma = dNorm / dSigma + sqrt(2.) * (A * exp(-A * A) - B * exp(-B * B));
+	(*pGradient)[constraint.iParam] += t / dSigma;
+	(*pGradient)[constraint.iValue] += -t / dSigma + dNormMean / dNorm;
+	(*pGradient)[constraint.iSigma] += -t * t / dSigma + dNormSigma / dNorm;
+      }
+    }
+
+    return dNLL;
+  }
+
+  Double_t BatchNLL::evaluate() const
+  {
+    const BatchKernels& kernels = GetKernels();
+    const double dExpected = PrepareNodes();
+
+    double dLogL = 0;
+    for(unsigned int iFirst = 0; iFirst < m_vX.size(); iFirst += iBlockSize)
+    {
+      const unsigned int n = std::min<unsigned int>(iBlockSize,m_vX.size() - iFirst);
+      EvaluateBlock(kernels,iFirst,n);
+      dLogL += kernels.pWeightedLogSum(&m_vBuffers[(m_vNodes.size() - 1) * iBlockSize],&m_vW[iFirst],n);
+    }
+
+    double dNLL = -dLogL + EvaluateConstraints(0);
+    if(m_bExtended)
+      dNLL += dExpected - m_dSumW * log(dExpected);
+
+    return dNLL;
+  }
+
+  double BatchNLL::EvaluateWithGradient(std::vector<double>& vGradient) const
+  {
+    const BatchKernels& kernels = GetKernels();
+    const double dExpected = PrepareNodes();
+    const unsigned int iRoot = m_vNodes.size() - 1;
+    vGradient.assign(m_params.getSize(),0);
+
+    // dNLL/dp = -sum_i w_i (df/dp)(x_i) / f(x_i)
+    double dLogL = 0;
+    for(unsigned int iFirst = 0; iFirst < m_vX.size(); iFirst += iBlockSize)
+    {
+      const unsigned int n = std::min<unsigned int>(iBlockSize,m_vX.size() - iFirst);
+      EvaluateBlock(kernels,iFirst,n);
+      dLogL += kernels.pWeightedLogSum(&m_vBuffers[iRoot * iBlockSize],&m_vW[iFirst],n);
+      for(unsigned int iParam = 0; iParam < vGradient.size(); ++iParam)
+      {
+	if(EvaluateDerivativeBlock(kernels,iFirst,n,iParam))
+	  vGradient[iParam] -= kernels.pWeightedRatioSum(&m_vDerivBuffers[iRoot * iBlockSize],&m_vBuffers[iRoot * iBlockSize],&m_vW[iFirst],n);
+      }
+    }
+
+    double dNLL = -dLogL + EvaluateConstraints(&vGradient);
+    if(m_bExtended)
+    {
+      // d/dN_j (N - n log(N)) = 1 - n/N
+      dNLL += dExpected - m_dSumW * log(dExpected);
+      for(unsigned int iParam : m_vNodes.back().vParams)
+	vGradient[iParam] += 1. - m_dSumW / dExpected;
+    }
+
+    return dNLL;
+  }
+
+  namespace
+  {
+    // translation of a pdf into nodes of a batch NLL
+    class NodeBuilder : public PdfTranslator
+    {
+    public:
+      NodeBuilder(const RooRealVar& obs):
+	PdfTranslator(obs),
+	m_params(),
+	m_vNodes(),
+	m_vConstraints(),
+	m_vStack()
+      {}
+
+      const RooArgList& GetParameters() const {return m_params;}
+      const std::vector<BatchNLL::Node>& GetNodes() const {return m_vNodes;}
+      const std::vector<BatchNLL::Constraint>& GetConstraints() const {return m_vConstraints;}
+
+    protected:
+      virtual bool AddGaussian(const RooAbsReal& mean,const RooAbsReal& sigma)
+      {
+	BatchNLL::Node node = NewNode(BatchNLL::Node::eGAUSSIAN);
+	AddParameter(mean,node);
+	AddParameter(sigma,node);
+	return Push(node);
+      }
+
+      virtual bool AddExponential(const RooAbsReal& c)
+      {
+	BatchNLL::Node node = NewNode(BatchNLL::Node::eEXPONENTIAL);
+	AddParameter(c,node);
+	return Push(node);
+      }
+
+      virtual bool AddPolynomial(const RooArgList& coefs)
+      {
+	BatchNLL::Node node = NewNode(BatchNLL::Node::ePOLYNOMIAL);
+	for(int i = 0; i < coefs.getSize(); ++i)
+	  AddParameter(*coefs.at(i),node);
+	return Push(node);
+      }
+
+      virtual bool AddSum(const RooArgList& coefs,bool bYields,unsigned int iComponents)
+      {
+	BatchNLL::Node node = NewNode(BatchNLL::Node::eSUM);
+	node.bYields = bYields;
+	for(int i = 0; i < coefs.getSize(); ++i)
+	  AddParameter(*coefs.at(i),node);
+
+	// components are the last translated nodes not yet part of a sum
+	node.vChildren.assign(m_vStack.end() - iComponents,m_vStack.end());
+	m_vStack.resize(m_vStack.size() - iComponents);
+	return Push(node);
+      }
+
+      virtual bool AddConstraint(const RooRealVar& param,const RooAbsReal& value,const RooAbsReal& sigma)
+      {
+	m_vConstraints.push_back({GetIndex(param),GetIndex(value),GetIndex(sigma)});
+	return true;
+      }
+
+    private:
+      static BatchNLL::Node NewNode(BatchNLL::Node::TYPE eType)
+      {
+	BatchNLL::Node node;
+	node.eType = eType;
+	node.bYields = false;
+	return node;
+      }
+
+      // index of the parameter in the parameters of the NLL
+      unsigned int GetIndex(const RooAbsReal& arg)
+      {
+	int iIndex = m_params.index(&arg);
+	if(iIndex < 0)
+	{
+	  iIndex = m_params.getSize();
+	  m_params.add(arg);
+	}
+	return iIndex;
+      }
+
+      void AddParameter(const RooAbsReal& arg,BatchNLL::Node& node)
+      {
+	node.vParams.push_back(GetIndex(arg));
+      }
+
+      bool Push(const BatchNLL::Node& node)
+      {
+	m_vStack.push_back(m_vNodes.size());
+	m_vNodes.push_back(node);
+	return true;
+      }
+
+      RooArgList m_params;
+      std::vector<BatchNLL::Node> m_vNodes;
+      std::vector<BatchNLL::Constraint> m_vConstraints;
+      std::vector<unsigned int> m_vStack;
+    };
+  }
+
+  BatchNLL* BatchNLL::Create(RooAbsPdf& pdf,RooAbsData& data,bool bExtended)
+  {
+    // one real valued observable with a finite range
+    RooRealVar* pX = GetSingleObservable(pdf,data);
+    if(!pX)
+      return 0;
+
+    // model and constraint terms of a product
+    const RooAbsPdf* pModel = &pdf;
+    std::vector<const RooAbsPdf*> vConstraints;
+    if(dynamic_cast<RooProdPdf*>(&pdf))
+    {
+      pModel = 0;
+      const RooArgList& pdfs = ((RooProdPdf&)pdf).pdfList();
+      for(int i = 0; i < pdfs.getSize(); ++i)
+      {
+	const RooAbsPdf* pComponent = (const RooAbsPdf*)pdfs.at(i);
+	if(!pComponent->dependsOn(*pX))
+	  vConstraints.push_back(pComponent);
+	else if(pModel)
+	  return 0;
+	else
+	  pModel = pComponent;
+      }
+      if(!pModel)
+	return 0;
+    }
+
+    NodeBuilder builder(*pX);
+    if(!builder.Translate(*pModel) || (bExtended && !(builder.GetNodes().back().eType == Node::eSUM && builder.GetNodes().back().bYields)))
+      return 0;
+    for(auto pConstraint : vConstraints)
+    {
+      if(!builder.TranslateConstraint(*pConstraint,*pModel))
+	return 0;
+    }
+
+    // structure already rejected
+    const std::string sKey = TString::Format("%s[%.17g,%.17g]%s:",pX->GetName(),pX->getMin(),pX->getMax(),bExtended ? "ext" : "").Data()
+      + builder.GetStructure();
+    bool bChecked = false;
+    {
+      std::lock_guard<std::mutex> lock(gCheckedMutex);
+      auto it = gChecked.find(sKey);
+      if((it != gChecked.end()) && !it->second)
+	return 0;
+      bChecked = (it != gChecked.end());
+    }
+
+    // contiguous observable values and weights
+    std::vector<double> vX;
+    std::vector<double> vW;
+    GetObservableValues(data,*pX,vX,vW);
+
+    BatchNLL* pNLL = new BatchNLL(("nll_" + std::string(pdf.GetName())).c_str(),builder.GetParameters(),builder.GetNodes(),
+				  builder.GetConstraints(),bExtended,pX->getMin(),pX->getMax(),vX,vW);
+
+    // cross-check with RooFit NLL on first use
+    if(!bChecked)
+    {
+      const bool bPassed = CheckNLL(*pNLL,pdf,data,bExtended,"batch");
+      if(!bPassed)
+      {
+	delete pNLL;
+	pNLL = 0;
+      }
+      else if(iVERBOSITY >= eDEBUG)
+	std::cout << "batch NLL of " << pdf.GetName() << " with " << GetInstructionSet() << " kernels: " << sKey << std::endl;
+      std::lock_guard<std::mutex> lock(gCheckedMutex);
+      gChecked[sKey] = bPassed;
+    }
+
+    return pNLL;
+  }
+}
@@ -0,0 +1,101 @@
+#ifndef CG_BATCHNLL_H
+#define CG_BATCHNLL_H
+
+#include <vector>
+
+#include "RooAbsReal.h"
+#include "RooListProxy.h"
+
+class RooAbsData;
+class RooAbsPdf;
+
+namespace CG_Statistics
+{
+  struct BatchKernels;
+
+  // NLL of a pdf evaluated in blocks of events by vectorised kernels
+  //
+  // Supported are the pdfs translated by PdfTranslator (RooGaussian, RooExponential, RooPolynomial with lowest
+  // order 1 and RooAddPdf sums of them) with any real valued functions as parameters, optionally multiplied
+  // with RooGaussian constraint terms in a RooProdPdf (see PdfTranslator::TranslateConstraint). Observable values
+  // and weights are copied once into contiguous arrays. The kernels are compiled for AVX-512, AVX2 and the
+  // generic instruction set and the best one supported by the CPU is chosen at runtime. Each pdf structure
+  // is checked against the RooFit NLL on first use.
+  class BatchNLL : public RooAbsReal
+  {
+  public:
+    // one pdf of the model (nodes are ordered such that components come before their sums)
+    struct Node
+    {
+      enum TYPE {eGAUSSIAN, eEXPONENTIAL, ePOLYNOMIAL, eSUM};
+
+      TYPE eType;
+      std::vector<unsigned int> vParams;     // indices of parameters (coefficients for sums)
+      std::vector<unsigned int> vChildren;   // indices of components (sums only)
+      bool bYields;                          // coefficients are yields (sums only)
+      mutable std::vector<double> vConstants; // values needed by the kernel for the current parameters
+      mutable std::vector<double> vDerivatives; // values needed by the derivative kernels (three per parameter)
+    };
+
+    // Gaussian constraint term of a parameter
+    struct Constraint
+    {
+      unsigned int iParam;                   // index of the constrained variable
+      unsigned int iValue;                   // index of the global observable
+      unsigned int iSigma;                   // index of the width
+    };
+
+    // batch NLL of the pdf for the dataset (0 if the pdf is not supported or the check failed)
+    static BatchNLL* Create(RooAbsPdf& pdf,RooAbsData& data,bool bExtended);
+
+    // name of the instruction set used by the kernels
+    static const char* GetInstructionSet();
+
+    // parameters of the NLL
+    const RooArgList& GetParameters() const {return m_params;}
+    // true if all parameters are variables or constants (and the gradient is given by EvaluateWithGradient)
+    bool HasGradient() const;
+    // NLL and its analytic derivatives with respect to all parameters (in the order of GetParameters)
+    double EvaluateWithGradient(std::vector<double>& vGradient) const;
+
+    BatchNLL(const BatchNLL& other,const char* name = 0);
+    virtual TObject* clone(const char* newname) const {return new BatchNLL(*this,newname);}
+    // change of the NLL defining the parameter errors
+    virtual Double_t defaultErrorLevel() const {return 0.5;}
+
+  protected:
+    virtual Double_t evaluate() const;
+
+  private:
+    BatchNLL(const char* name,const RooArgList& params,const std::vector<Node>& vNodes,
+	     const std::vector<Constraint>& vConstraints,bool bExtended,
+	     double dMin,double dMax,const std::vector<double>& vX,const std::vector<double>& vW);
+
+    // update the kernel constants of all nodes (returns the expected number of events of the root node)
+    double PrepareNodes() const;
+    // values of all nodes for the given block of events
+    void EvaluateBlock(const BatchKernels& kernels,unsigned int iFirst,unsigned int n) const;
+    // derivatives of all nodes with respect to the given parameter for the block of events evaluated last
+    // (returns false if the derivative of the root node vanishes)
+    bool EvaluateDerivativeBlock(const BatchKernels& kernels,unsigned int iFirst,unsigned int n,unsigned int iParam) const;
+    // sum of the constraint terms (and their derivatives added to the gradient if given)
+    double EvaluateConstraints(std::vector<double>* pGradient) const;
+
+    RooListProxy m_params;
+    std::vector<Node> m_vNodes;
+    std::vector<Constraint> m_vConstraints;
+    bool m_bExtended;
+    double m_dMin;
+    double m_dMax;
+    std::vector<double> m_vX;
+    std::vector<double> m_vW;
+    double m_dSumW;
+    mutable std::vector<double> m_vBuffers;
+    mutable std::vector<double> m_vDerivBuffers;
+  };
+
+  // true if fits should use batch NLLs (see SetBatchNLL)
+  bool UseBatchNLL();
+}
+
+#endif // CG_BATCHNLL_H
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <vector>
+
+#include "TObjArray.h"
+
+#include "RooAbsData.h"
+#include "RooRealVar.h"
+using namespace RooFit;
+
+#include "RooStats/ModelConfig.h"
+#include "RooStats/ProfileLikelihoodCalculator.h"
+#include "RooStats/LikelihoodInterval.h"
+#include "RooStats/HypoTestInverterResult.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "ModelClone.h"
+#include "WorkerPool.h"
+#include "Instrumentation.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // apply a single-dataset function (called with the index of the dataset) to all datasets
+    //
+    // The datasets are distributed round-robin over the workers. Each worker sets up one copy of the
+    // model which it uses for all of its datasets and sends back its results in a TObjArray indexed by
+    // the position of the dataset. With a single worker, the given model is used directly in-process.
+    // Datasets for which no result could be obtained (e.g. failed worker) yield a null pointer.
+    template<class T>
+    std::vector<T*> RunBatch(const std::vector<RooAbsData*>& vData,
+			     ModelConfig& mc,
+			     unsigned int iWorkers,
+			     const std::function<T*(unsigned int,ModelConfig&)>& func)
+    {
+      std::vector<T*> vResults(vData.size(),(T*)0);
+      iWorkers = std::min(GetNWorkers(iWorkers),(unsigned int)vData.size());
+
+      // nothing to distribute
+      if(iWorkers <= 1)
+      {
+	for(unsigned int i = 0; i < vData.size(); ++i)
+	  vResults[i] = func(i,mc);
+
+	return vResults;
+      }
+
+      auto task = [&](unsigned int iWorker) -> TObject*
+	{
+	  // independent copy of the model shared by all datasets of this worker
+	  ModelClone clone(mc);
+
+	  TObjArray* pResults = new TObjArray(vData.size());
+	  pResults->SetOwner(kTRUE);
+	  for(unsigned int i = iWorker; i < vData.size(); i += iWorkers)
+	  {
+	    if(iVERBOSITY >= eINFO)
+	      std::cout << "worker " << iWorker << ": process dataset " << i + 1 << " of " << vData.size() << std::endl;
+
+	    pResults->AddAt(func(i,clone.GetModel()),i);
+	  }
+
+	  return pResults;
+	};
+
+      // collect results of all workers
+      std::vector<TObject*> vArrays = RunWorkers(iWorkers,task);
+      for(unsigned int iWorker = 0; iWorker < iWorkers; ++iWorker)
+      {
+	TObjArray* pResults = (TObjArray*)vArrays[iWorker];
+	if(!pResults)
+	  continue;
+
+	for(unsigned int i = iWorker; i < vData.size(); i += iWorkers)
+	  vResults[i] = (T*)pResults->At(i);
+
+	pResults->SetOwner(kFALSE);
+	delete pResults;
+      }
+
+      return vResults;
+    }
+  }
+
+  std::vector<LikelihoodInterval*> GetLikelihoodIntervals(const std::vector<RooAbsData*>& vData,
+							  ModelConfig& mc,
+							  double dConf)
+  {
+    CallScope scope;
+
+    std::vector<LikelihoodInterval*> vResults;
+    if(vData.empty())
+      return vResults;
+
+    // the intervals keep their profiled likelihood (built on the given model) for evaluating the
+    // limits on demand and can therefore not be streamed back from worker processes
+    // -> one profile likelihood calculator is used for all datasets
+    ProfileLikelihoodCalculator plc(*vData.front(),mc);
+    plc.SetConfidenceLevel(dConf);
+    for(auto pData : vData)
+    {
+      plc.SetData(*pData);
+      vResults.push_back(plc.GetInterval());
+    }
+
+    return vResults;
+  }
+
+#ifndef CG_EXPERIMENTAL
+  std::vector<HypoTestInverterResult*> GetFCIntervals(const std::vector<RooAbsData*>& vData,
+						      ModelConfig& mc,
+						      double dConf,
+						      double dLow,
+						      double dHigh,
+						      double dStep,
+						      unsigned int iToys,
+						      unsigned int iWorkers,
+						      unsigned int iBlockToys,
+						      FCMODE eMode)
+  {
+    return GetFCIntervals(vData,mc,dConf,std::vector<double>(vData.size(),dLow),std::vector<double>(vData.size(),dHigh),
+			  dStep,iToys,iWorkers,iBlockToys,eMode);
+  }
+
+  std::vector<HypoTestInverterResult*> GetFCIntervals(const std::vector<RooAbsData*>& vData,
+						      ModelConfig& mc,
+						      double dConf,
+						      const std::vector<double>& vLow,
+						      const std::vector<double>& vHigh,
+						      double dStep,
+						      unsigned int iToys,
+						      unsigned int iWorkers,
+						      unsigned int iBlockToys,
+						      FCMODE eMode)
+  {
+    assert((vLow.size() == vData.size()) && (vHigh.size() == vData.size()));
+    CallScope scope;
+
+    std::function<HypoTestInverterResult*(unsigned int,ModelConfig&)> func = [&](unsigned int i,ModelConfig& model)
+      {
+	return GetFCInterval(*vData.at(i),model,dConf,vLow.at(i),vHigh.at(i),dStep,iToys,1,iBlockToys,eMode);
+      };
+
+    return RunBatch(vData,mc,iWorkers,func);
+  }
+#else
+  std::vector<HypoTestInverterResult*> GetFCIntervals(const std::vector<RooAbsData*>& vData,
+						      ModelConfig& mc,
+						      double dConf,
+						      unsigned int iMaxIterations,
+						      double dLow,
+						      double dHigh,
+						      unsigned int iPoints,
+						      unsigned int iToys,
+						      unsigned int iWorkers,
+						      unsigned int iBlockToys,
+						      FCMODE eMode)
+  {
+    return GetFCIntervals(vData,mc,dConf,iMaxIterations,std::vector<double>(vData.size(),dLow),std::vector<double>(vData.size(),dHigh),
+			  iPoints,iToys,iWorkers,iBlockToys,eMode);
+  }
+
+  std::vector<HypoTestInverterResult*> GetFCIntervals(const std::vector<RooAbsData*>& vData,
+						      ModelConfig& mc,
+						      double dConf,
+						      unsigned int iMaxIterations,
+						      const std::vector<double>& vLow,
+						      const std::vector<double>& vHigh,
+						      unsigned int iPoints,
+						      unsigned int iToys,
+						      unsigned int iWorkers,
+						      unsigned int iBlockToys,
+						      FCMODE eMode)
+  {
+    assert((vLow.size() == vData.size()) && (vHigh.size() == vData.size()));
+    CallScope scope;
+
+    std::function<HypoTestInverterResult*(unsigned int,ModelConfig&)> func = [&](unsigned int i,ModelConfig& model)
+      {
+	return GetFCInterval(*vData.at(i),model,dConf,iMaxIterations,vLow.at(i),vHigh.at(i),iPoints,iToys,1,iBlockToys,eMode);
+      };
+
+    return RunBatch(vData,mc,iWorkers,func);
+  }
+#endif // CG_EXPERIMENTAL
+
+  std::vector<HypoTestInverterResult*> GetUpperLimits(const std::vector<RooAbsData*>& vData,
+						      ModelConfig& mc,
+						      bool bUseCLs,
+						      double dConf,
+						      double dLow,
+						      double dHigh,
+						      double dPrecision,
+						      unsigned int iMaxIterations,
+						      int iToys,
+						      unsigned int iWorkers)
+  {
+    return GetUpperLimits(vData,mc,bUseCLs,dConf,std::vector<double>(vData.size(),dLow),std::vector<double>(vData.size(),dHigh),
+			  dPrecision,iMaxIterations,iToys,iWorkers);
+  }
+
+  std::vector<HypoTestInverterResult*> GetUpperLimits(const std::vector<RooAbsData*>& vData,
+						      ModelConfig& mc,
+						      bool bUseCLs,
+						      double dConf,
+						      const std::vector<double>& vLow,
+						      const std::vector<double>& vHigh,
+						      double dPrecision,
+						      unsigned int iMaxIterations,
+						      int iToys,
+						      unsigned int iWorkers)
+  {
+    assert((vLow.size() == vData.size()) && (vHigh.size() == vData.size()));
+    CallScope scope;
+
+    std::function<HypoTestInverterResult*(unsigned int,ModelConfig&)> func = [&](unsigned int i,ModelConfig& model)
+      {
+	return GetUpperLimit(*vData.at(i),model,bUseCLs,dConf,vLow.at(i),vHigh.at(i),dPrecision,iMaxIterations,iToys,1);
+      };
+
+    return RunBatch(vData,mc,iWorkers,func);
+  }
+}
@@ -0,0 +1,156 @@
+#include <cmath>
+#include <iostream>
+
+#include "RooAbsData.h"
+#include "RooAbsPdf.h"
+#include "RooDataHist.h"
+#include "RooRealVar.h"
+#include "RooArgSet.h"
+#include "RooLinkedListIter.h"
+using namespace RooFit;
+
+#include "RooStats/ModelConfig.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "BinnedData.h"
+#include "LikelihoodContext.h"
+#include "SessionState.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // number of real valued observables in the given set
+    unsigned int CountRealObservables(const RooArgSet& observables)
+    {
+      unsigned int iReal = 0;
+      RooLinkedListIter it = observables.iterator();
+      RooAbsArg* pArg = 0;
+      while((pArg = (RooAbsArg*)it.Next()))
+      {
+	if(dynamic_cast<RooRealVar*>(pArg))
+	  ++iReal;
+      }
+
+      return iReal;
+    }
+
+    // apply the number of bins to all real valued observables
+    void SetBins(const RooArgSet& observables,int iBins)
+    {
+      RooLinkedListIter it = observables.iterator();
+      RooAbsArg* pArg = 0;
+      while((pArg = (RooAbsArg*)it.Next()))
+      {
+	RooRealVar* pVar = dynamic_cast<RooRealVar*>(pArg);
+	if(pVar)
+	  pVar->setBins(iBins);
+      }
+    }
+  }
+
+  void SetBinnedFits(int iBins,unsigned int iMinEvents)
+  {
+    SessionOptions& options = GetSessionState().options;
+    options.iBins = iBins;
+    options.iMinEvents = iMinEvents;
+  }
+
+  int GetNBins(const RooAbsData& data,unsigned int iObservables)
+  {
+    // bins per observable (0 = unbinned fits, < 0 = automatic)
+    const SessionOptions& options = GetSessionState().options;
+    if((options.iBins == 0) || (iObservables == 0) || data.isBinned() || (data.numEntries() < (int)options.iMinEvents))
+      return 0;
+
+    if(options.iBins > 0)
+      return options.iBins;
+
+    // automatic: bin width ~ N^(-1/(2 + D)) (optimal scaling for D-dimensional histograms)
+    return (int)ceil(2 * pow(data.numEntries(),1. / (2 + iObservables)));
+  }
+
+  RooDataHist* GetBinnedData(const RooAbsData& data,const RooAbsPdf& pdf)
+  {
+    RooArgSet* pObs = pdf.getObservables(data);
+    const int iBins = GetNBins(data,CountRealObservables(*pObs));
+    if(iBins == 0)
+    {
+      delete pObs;
+      return 0;
+    }
+
+    // binning is taken from copies of the observables (the variables of the dataset stay untouched)
+    RooArgSet* pBinnedObs = (RooArgSet*)pObs->snapshot();
+    SetBins(*pBinnedObs,iBins);
+    RooDataHist* pBinned = new RooDataHist(TString(data.GetName()) + "_binned",data.GetTitle(),*pBinnedObs,data);
+
+    if(iVERBOSITY >= eDEBUG)
+      std::cout << "fit " << data.GetName() << " with " << data.numEntries() << " entries binned with " << iBins << " bins per observable" << std::endl;
+
+    delete pBinnedObs;
+    delete pObs;
+
+    return pBinned;
+  }
+
+  int GetToyBins(const RooArgSet& observables,const RooAbsData& data)
+  {
+    return GetNBins(data,CountRealObservables(observables));
+  }
+
+  bool SetToyBinning(const RooArgSet& observables,const RooAbsData& data)
+  {
+    const int iBins = GetToyBins(observables,data);
+    if(iBins == 0)
+      return false;
+
+    SetBins(observables,iBins);
+    return true;
+  }
+
+  double GetBinningBias(RooAbsData& data,ModelConfig& mc)
+  {
+    RooAbsPdf* pPDF = mc.GetPdf();
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+
+    // store parameters of pdf
+    RooArgSet* allParams = pPDF->getParameters(data);
+    RooArgSet* pSnapshot = (RooArgSet*)allParams->snapshot();
+
+    // unbinned fit
+    SessionOptions& options = GetSessionState().options;
+    const int iBins = options.iBins;
+    options.iBins = 0;
+    double dMuHat = 0;
+    double dMuHatError = 0;
+    {
+      LikelihoodContext context(data,*pPDF,RooArgSet(*pPOI));
+      dMuHat = context.GetMuHat();
+      dMuHatError = context.GetMuHatError();
+    }
+    options.iBins = iBins;
+    allParams->assignValueOnly(*pSnapshot);
+
+    // binned fit (if the dataset qualifies)
+    double dBinnedMuHat = dMuHat;
+    {
+      LikelihoodContext context(data,*pPDF,RooArgSet(*pPOI),false);
+      dBinnedMuHat = context.GetMuHat();
+    }
+
+    // restore parameters of pdf
+    allParams->assignValueOnly(*pSnapshot);
+    delete pSnapshot;
+    delete allParams;
+
+    const double dBias = (dMuHatError > 0) ? (dBinnedMuHat - dMuHat) / dMuHatError : 0;
+    if(iVERBOSITY >= eINFO)
+      std::cout << pPOI->GetName() << "^hat = " << dMuHat << " +/- " << dMuHatError << " (unbinned) and " << dBinnedMuHat
+		<< " (binned) --> bias = " << dBias << " sigma" << std::endl;
+
+    return dBias;
+  }
+}
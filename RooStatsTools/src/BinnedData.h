@@ -0,0 +1,28 @@
+#ifndef CG_BINNEDDATA_H
+#define CG_BINNEDDATA_H
+
+class RooAbsData;
+class RooAbsPdf;
+class RooArgSet;
+class RooDataHist;
+
+namespace CG_Statistics
+{
+  // number of bins per observable used instead of the given dataset (0 = keep dataset unbinned)
+  //
+  // Only unbinned datasets with at least the minimum number of entries are binned (see SetBinnedFits).
+  int GetNBins(const RooAbsData& data,unsigned int iObservables);
+
+  // binned copy of the dataset in the observables of the given pdf (0 if the dataset is used as it is)
+  // (caller takes ownership)
+  RooDataHist* GetBinnedData(const RooAbsData& data,const RooAbsPdf& pdf);
+
+  // number of bins per observable for toys belonging to the given dataset (0 = unbinned toys)
+  int GetToyBins(const RooArgSet& observables,const RooAbsData& data);
+
+  // set the binning of the given observables for generating binned toys belonging to the given dataset
+  // (returns false if toys should be generated unbinned)
+  bool SetToyBinning(const RooArgSet& observables,const RooAbsData& data);
+}
+
+#endif // CG_BINNEDDATA_H
@@ -0,0 +1,172 @@
+#include <iostream>
+#include "unistd.h"
+
+#include "TFile.h"
+#include "TString.h"
+#include "TObjArray.h"
+#include "TVectorD.h"
+#include "TRandom3.h"
+
+#include "RooRandom.h"
+using namespace RooFit;
+
+#include "RooStats/HypoTestInverterResult.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "Checkpoint.h"
+#include "SessionState.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    TString GetEntryName(ULong64_t iKey)
+    {
+      return TString::Format("cp_%016llx",(unsigned long long)iKey);
+    }
+  }
+
+  Checkpoint::Checkpoint():
+    m_sFileName(),
+    m_pFile(0),
+    m_iOwnerPID(-1),
+    m_iFilePID(-1)
+  {}
+
+  Checkpoint::~Checkpoint()
+  {
+    Close();
+  }
+
+  Checkpoint& Checkpoint::Instance()
+  {
+    return GetSessionState().checkpoint;
+  }
+
+  bool Checkpoint::Open(const char* sFileName)
+  {
+    Close();
+    if(!sFileName || !*sFileName)
+      return true;
+
+    m_sFileName = sFileName;
+    m_iOwnerPID = getpid();
+    if(!GetFile())
+    {
+      if(iVERBOSITY >= eERROR)
+	std::cerr << "failed to open checkpoint file '" << sFileName << "'" << std::endl;
+      Close();
+      return false;
+    }
+
+    return true;
+  }
+
+  void Checkpoint::Close()
+  {
+    // a file inherited from the parent process is closed by the parent
+    if(m_pFile && (m_iFilePID == getpid()))
+    {
+      m_pFile->Close();
+      delete m_pFile;
+    }
+    m_pFile = 0;
+    m_iFilePID = -1;
+    m_iOwnerPID = -1;
+    m_sFileName.clear();
+  }
+
+  TFile* Checkpoint::GetFile()
+  {
+    if(m_sFileName.empty())
+      return 0;
+
+    // file handles must not be shared between processes
+    if(m_iFilePID != getpid())
+    {
+      const bool bOwner = (m_iOwnerPID == getpid());
+      m_pFile = TFile::Open(m_sFileName.c_str(),bOwner ? "UPDATE" : "READ");
+      if(m_pFile && m_pFile->IsZombie())
+      {
+	delete m_pFile;
+	m_pFile = 0;
+      }
+      m_iFilePID = getpid();
+    }
+
+    return m_pFile;
+  }
+
+  bool Checkpoint::Load(ULong64_t iKey,
+			HypoTestInverterResult*& pResult,
+			unsigned int& iIteration,
+			std::vector<double>& vScanPoints)
+  {
+    TFile* pFile = GetFile();
+    if(!pFile)
+      return false;
+
+    TObjArray* pEntry = 0;
+    pFile->GetObject(GetEntryName(iKey),pEntry);
+    if(!pEntry)
+      return false;
+    pEntry->SetOwner(kTRUE);
+
+    // content: result, state = (iteration, scan points...), random generator
+    HypoTestInverterResult* pSaved = dynamic_cast<HypoTestInverterResult*>(pEntry->At(0));
+    TVectorD* pState = dynamic_cast<TVectorD*>(pEntry->At(1));
+    TRandom3* pSavedRandom = dynamic_cast<TRandom3*>(pEntry->At(2));
+    TRandom3* pRandom = dynamic_cast<TRandom3*>(RooRandom::randomGenerator());
+    if(!pSaved || !pState || (pState->GetNrows() < 1) || !pSavedRandom || !pRandom)
+    {
+      delete pEntry;
+      return false;
+    }
+
+    pResult = (HypoTestInverterResult*)pEntry->RemoveAt(0);
+    iIteration = (unsigned int)(*pState)[0];
+    vScanPoints.clear();
+    for(int i = 1; i < pState->GetNrows(); ++i)
+      vScanPoints.push_back((*pState)[i]);
+    *pRandom = *pSavedRandom;
+    delete pEntry;
+
+    return true;
+  }
+
+  void Checkpoint::Save(ULong64_t iKey,
+			const HypoTestInverterResult& result,
+			unsigned int iIteration,
+			const std::vector<double>& vScanPoints)
+  {
+    if(m_iOwnerPID != getpid())
+      return;
+
+    TFile* pFile = GetFile();
+    if(!pFile)
+      return;
+
+    TVectorD state(vScanPoints.size() + 1);
+    state[0] = iIteration;
+    for(unsigned int i = 0; i < vScanPoints.size(); ++i)
+      state[i + 1] = vScanPoints[i];
+
+    // written as one object
+    TObjArray entry(3);
+    entry.Add(const_cast<HypoTestInverterResult*>(&result));
+    entry.Add(&state);
+    entry.Add(RooRandom::randomGenerator());
+
+    pFile->WriteTObject(&entry,GetEntryName(iKey),"WriteDelete");
+    pFile->Flush();
+  }
+
+  bool SetCheckpointFile(const char* sFileName)
+  {
+    // file I/O of ROOT
+    GlobalLock lock;
+    return Checkpoint::Instance().Open(sFileName);
+  }
+}
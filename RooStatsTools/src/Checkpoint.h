@@ -0,0 +1,65 @@
+#ifndef CG_CHECKPOINT_H
+#define CG_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+
+#include "RtypesCore.h"
+
+class TFile;
+namespace RooStats
+{
+  class HypoTestInverterResult;
+}
+
+namespace CG_Statistics
+{
+  // checkpoints of running scans in a ROOT file
+  //
+  // A checkpoint consists of the inversion result obtained so far, the number of the next iteration, the
+  // points to be tested in it and the state of the global random generator. It is saved under a name
+  // derived from its key (a hash of the model, the dataset and all arguments of the scan) as one object, so
+  // an interruption while writing keeps the previous checkpoint. Loading a checkpoint restores the random
+  // generator, so a resumed scan produces the same result as an uninterrupted one. As for the sampling
+  // distribution store, only the process which opened the file writes to it.
+  class Checkpoint
+  {
+  public:
+    Checkpoint();
+    ~Checkpoint();
+
+    // open/create checkpoint file (closes previous file, empty name = no checkpoints)
+    bool Open(const char* sFileName);
+    void Close();
+    bool IsOpen() const {return !m_sFileName.empty();}
+
+    // load checkpoint and restore random generator (false if not found, caller takes ownership of pResult)
+    bool Load(ULong64_t iKey,
+	      RooStats::HypoTestInverterResult*& pResult,
+	      unsigned int& iIteration,
+	      std::vector<double>& vScanPoints);
+
+    // save checkpoint (replaces existing one)
+    void Save(ULong64_t iKey,
+	      const RooStats::HypoTestInverterResult& result,
+	      unsigned int iIteration,
+	      const std::vector<double>& vScanPoints);
+
+    // checkpoint file of the active session (see Session)
+    static Checkpoint& Instance();
+
+  private:
+    Checkpoint(const Checkpoint&);
+    Checkpoint& operator=(const Checkpoint&);
+
+    // file opened by the current process (0 if the file cannot be opened)
+    TFile* GetFile();
+
+    std::string m_sFileName;
+    TFile* m_pFile;
+    int m_iOwnerPID;
+    int m_iFilePID;
+  };
+}
+
+#endif // CG_CHECKPOINT_H
@@ -0,0 +1,261 @@
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "TInterpreter.h"
+#include "TString.h"
+
+#include "RooAbsData.h"
+#include "RooAbsPdf.h"
+#include "RooRealVar.h"
+#include "RooConstVar.h"
+#include "RooArgSet.h"
+#include "RooArgList.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "CompiledNLL.h"
+#include "NLLTranslator.h"
+#include "SessionState.h"
+#include "Fingerprint.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // compiled functions by generated source (0 = compilation or check failed)
+    std::map<std::string,CompiledNLL::NLLFunction> gFunctions;
+    // shared by all sessions (also serialises the interpreter calls)
+    std::mutex gFunctionsMutex;
+
+    // translation of a pdf into C++ expressions
+    class NLLCodeGenerator : public PdfTranslator
+    {
+    public:
+      NLLCodeGenerator(const RooRealVar& obs):
+	PdfTranslator(obs),
+	m_params(),
+	m_sSetup(),
+	m_sExpected(),
+	m_vExpressions(),
+	m_iTerms(0)
+      {}
+
+      // expression of the normalised pdf at x (empty if not supported)
+      std::string GetDensity() const {return (m_vExpressions.size() == 1) ? m_vExpressions.back() : "";}
+
+      const RooArgList& GetParameters() const {return m_params;}
+      const std::string& GetSetup() const {return m_sSetup;}
+      // expected number of events (empty if the pdf has no yields)
+      const std::string& GetExpected() const {return m_sExpected;}
+
+    protected:
+      virtual bool AddGaussian(const RooAbsReal& mean,const RooAbsReal& sigma)
+      {
+	std::string sMean, sSigma;
+	if(!GetParameter(mean,sMean) || !GetParameter(sigma,sSigma))
+	  return false;
+
+	const std::string sNorm = NewTerm();
+	m_sSetup += "  const double " + sNorm + " = CG_Statistics::GaussianIntegral(" + sMean + "," + sSigma + ",a,b);\n";
+	m_vExpressions.push_back("(exp(-0.5 * (x[i] - " + sMean + ") * (x[i] - " + sMean + ") / (" + sSigma + " * " + sSigma + ")) / " + sNorm + ")");
+	return true;
+      }
+
+      virtual bool AddExponential(const RooAbsReal& c)
+      {
+	std::string sSlope;
+	if(!GetParameter(c,sSlope))
+	  return false;
+
+	const std::string sNorm = NewTerm();
+	m_sSetup += "  const double " + sNorm + " = CG_Statistics::ExponentialIntegral(" + sSlope + ",a,b);\n";
+	m_vExpressions.push_back("(exp(" + sSlope + " * x[i]) / " + sNorm + ")");
+	return true;
+      }
+
+      virtual bool AddPolynomial(const RooArgList&)
+      {
+	return false;
+      }
+
+      virtual bool AddSum(const RooArgList& coefs,bool bYields,unsigned int iComponents)
+      {
+	std::vector<std::string> vCoefs;
+	for(int i = 0; i < coefs.getSize(); ++i)
+	{
+	  std::string sCoef;
+	  if(!GetParameter(*coefs.at(i),sCoef))
+	    return false;
+	  vCoefs.push_back(sCoef);
+	}
+
+	// sum of yields or last fraction
+	std::string sSum = "1";
+	for(auto& sCoef : vCoefs)
+	  sSum += " - " + sCoef;
+	if(bYields)
+	{
+	  sSum = "0";
+	  for(auto& sCoef : vCoefs)
+	    sSum += " + " + sCoef;
+	}
+	const std::string sLast = NewTerm();
+	m_sSetup += "  const double " + sLast + " = " + sSum + ";\n";
+	if(bYields)
+	  m_sExpected = sLast;
+	else
+	  vCoefs.push_back(sLast);
+
+	// components are the last translated expressions
+	std::string sExpr = "(";
+	const unsigned int iFirst = m_vExpressions.size() - iComponents;
+	for(unsigned int i = 0; i < iComponents; ++i)
+	  sExpr += ((i > 0) ? " + " : "") + vCoefs.at(i) + " * " + m_vExpressions.at(iFirst + i);
+	sExpr += ")";
+	m_vExpressions.resize(iFirst);
+	m_vExpressions.push_back(bYields ? "(" + sExpr + " / " + sLast + ")" : sExpr);
+
+	return true;
+      }
+
+    private:
+      // C++ expression of a parameter (element of the parameter array or literal for constants)
+      bool GetParameter(const RooAbsReal& arg,std::string& sExpr)
+      {
+	if(dynamic_cast<const RooConstVar*>(&arg))
+	{
+	  sExpr = TString::Format("%.17g",arg.getVal()).Data();
+	  return true;
+	}
+
+	if(!dynamic_cast<const RooRealVar*>(&arg))
+	  return false;
+
+	int iIndex = m_params.index(&arg);
+	if(iIndex < 0)
+	{
+	  iIndex = m_params.getSize();
+	  m_params.add(arg);
+	}
+	sExpr = TString::Format("p[%d]",iIndex).Data();
+
+	return true;
+      }
+
+      std::string NewTerm()
+      {
+	return TString::Format("t%u",m_iTerms++).Data();
+      }
+
+      RooArgList m_params;
+      std::string m_sSetup;
+      std::string m_sExpected;
+      std::vector<std::string> m_vExpressions;
+      unsigned int m_iTerms;
+    };
+
+    // compile the given function once (0 if compilation fails)
+    CompiledNLL::NLLFunction Compile(const std::string& sName,const std::string& sCode)
+    {
+      if(!gInterpreter->Declare((sIntegralDeclarations + sCode).c_str()))
+	return 0;
+
+      return (CompiledNLL::NLLFunction)gInterpreter->Calc(TString::Format("(long)&%s",sName.c_str()));
+    }
+  }
+
+  bool UseCompiledNLL()
+  {
+    return GetSessionState().options.bCompiledNLL;
+  }
+
+  void SetCompiledNLL(bool bCompiled)
+  {
+    GetSessionState().options.bCompiledNLL = bCompiled;
+  }
+
+  CompiledNLL::CompiledNLL(const char* name,const RooArgList& params,NLLFunction pFunction,
+			   const std::vector<double>& vX,const std::vector<double>& vW):
+    RooAbsReal(name,"compiled NLL"),
+    m_params("params","parameters",this),
+    m_pFunction(pFunction),
+    m_vX(vX),
+    m_vW(vW),
+    m_vValues(params.getSize())
+  {
+    m_params.add(params);
+  }
+
+  CompiledNLL::CompiledNLL(const CompiledNLL& other,const char* name):
+    RooAbsReal(other,name),
+    m_params("params",this,other.m_params),
+    m_pFunction(other.m_pFunction),
+    m_vX(other.m_vX),
+    m_vW(other.m_vW),
+    m_vValues(other.m_vValues)
+  {}
+
+  Double_t CompiledNLL::evaluate() const
+  {
+    for(unsigned int i = 0; i < m_vValues.size(); ++i)
+      m_vValues[i] = ((RooAbsReal&)m_params[i]).getVal();
+
+    return m_pFunction(m_vValues.data(),m_vX.data(),m_vW.data(),m_vX.size());
+  }
+
+  CompiledNLL* CompiledNLL::Create(RooAbsPdf& pdf,RooAbsData& data,bool bExtended)
+  {
+    // one real valued observable with a finite range
+    RooRealVar* pX = GetSingleObservable(pdf,data);
+    if(!pX)
+      return 0;
+
+    NLLCodeGenerator generator(*pX);
+    const std::string sDensity = generator.Translate(pdf) ? generator.GetDensity() : "";
+    if(sDensity.empty() || (bExtended && generator.GetExpected().empty()))
+      return 0;
+
+    // NLL = -sum_i w_i log(f(x_i)) (+ N_exp - N_obs log(N_exp) for extended fits)
+    const std::string sBody = TString::Format("(const double* p,const double* x,const double* w,unsigned long n)\n{\n"
+					      "  const double a = %.17g;\n  const double b = %.17g;\n",pX->getMin(),pX->getMax()).Data()
+      + generator.GetSetup()
+      + "  double nll = 0;\n  double sumw = 0;\n"
+      + "  for(unsigned long i = 0; i < n; ++i)\n  {\n"
+      + "    nll -= w[i] * log(" + sDensity + ");\n    sumw += w[i];\n  }\n"
+      + (bExtended ? "  nll += " + generator.GetExpected() + " - sumw * log(" + generator.GetExpected() + ");\n" : std::string())
+      + "  return nll;\n}\n";
+    const std::string sName = TString::Format("cg_nll_%016llx",(unsigned long long)HashString(sBody.c_str())).Data();
+
+    // observable values and weights
+    std::vector<double> vX;
+    std::vector<double> vW;
+    GetObservableValues(data,*pX,vX,vW);
+
+    std::lock_guard<std::mutex> lock(gFunctionsMutex);
+    auto it = gFunctions.find(sBody);
+    if(it != gFunctions.end())
+      return it->second ? new CompiledNLL(("nll_" + std::string(pdf.GetName())).c_str(),generator.GetParameters(),it->second,vX,vW) : 0;
+
+    NLLFunction pFunction = Compile(sName,"#include <cmath>\ndouble " + sName + sBody);
+    CompiledNLL* pNLL = pFunction ? new CompiledNLL(("nll_" + std::string(pdf.GetName())).c_str(),generator.GetParameters(),pFunction,vX,vW) : 0;
+
+    // cross-check with RooFit NLL on first use
+    if(pNLL)
+    {
+      if(!CheckNLL(*pNLL,pdf,data,bExtended,"compiled"))
+      {
+	delete pNLL;
+	pNLL = 0;
+	pFunction = 0;
+      }
+      else if(iVERBOSITY >= eDEBUG)
+	std::cout << "compiled NLL " << sName << " of " << pdf.GetName() << ":\n" << sBody << std::endl;
+    }
+    gFunctions[sBody] = pFunction;
+
+    return pNLL;
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef CG_COMPILEDNLL_H
+#define CG_COMPILEDNLL_H
+
+#include <vector>
+
+#include "RooAbsReal.h"
+#include "RooListProxy.h"
+
+class RooAbsData;
+class RooAbsPdf;
+
+namespace CG_Statistics
+{
+  // NLL of a pdf with fixed structure evaluated by C++ code generated for the pdf and compiled at runtime
+  //
+  // Supported are the pdfs translated by PdfTranslator without RooPolynomial components (RooGaussian,
+  // RooExponential and RooAddPdf sums of them) with variables or constants as parameters. The generated
+  // function computes the normalisation integrals once per evaluation and loops over plain arrays of
+  // observable values and weights extracted from the dataset. Each generated
+  // function is compiled with cling once per process and checked against the RooFit NLL on first use.
+  class CompiledNLL : public RooAbsReal
+  {
+  public:
+    // NLL(parameters, observable values, weights, number of entries)
+    typedef double (*NLLFunction)(const double*,const double*,const double*,unsigned long);
+
+    // compiled NLL of the pdf for the dataset (0 if the pdf is not supported or the check failed)
+    static CompiledNLL* Create(RooAbsPdf& pdf,RooAbsData& data,bool bExtended);
+
+    CompiledNLL(const CompiledNLL& other,const char* name = 0);
+    virtual TObject* clone(const char* newname) const {return new CompiledNLL(*this,newname);}
+    // change of the NLL defining the parameter errors
+    virtual Double_t defaultErrorLevel() const {return 0.5;}
+
+  protected:
+    virtual Double_t evaluate() const;
+
+  private:
+    CompiledNLL(const char* name,const RooArgList& params,NLLFunction pFunction,
+		const std::vector<double>& vX,const std::vector<double>& vW);
+
+    RooListProxy m_params;
+    NLLFunction m_pFunction;
+    std::vector<double> m_vX;
+    std::vector<double> m_vW;
+    mutable std::vector<double> m_vValues;
+  };
+
+  // true if fits should use compiled NLLs (see SetCompiledNLL)
+  bool UseCompiledNLL();
+}
+
+#endif // CG_COMPILEDNLL_H
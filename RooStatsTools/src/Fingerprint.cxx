@@ -0,0 +1,119 @@
+#include <vector>
+
+#include "RooAbsCollection.h"
+#include "RooAbsData.h"
+#include "RooAbsReal.h"
+#include "RooAbsCategory.h"
+#include "RooAbsPdf.h"
+#include "RooRealVar.h"
+#include "RooArgSet.h"
+#include "RooLinkedListIter.h"
+using namespace RooFit;
+
+// custom include(s)
+#include "Fingerprint.h"
+
+namespace CG_Statistics
+{
+  ULong64_t HashString(const char* sValue)
+  {
+    ULong64_t iHash = 14695981039346656037ULL;
+    for(; sValue && *sValue; ++sValue)
+    {
+      iHash ^= (unsigned char)*sValue;
+      iHash *= 1099511628211ULL;
+    }
+
+    return iHash;
+  }
+
+  ULong64_t GetValuesHash(const RooAbsCollection& set)
+  {
+    ULong64_t iHash = set.getSize();
+    RooLinkedListIter it = set.iterator();
+    RooAbsArg* arg = 0;
+    while((arg = (RooAbsArg*)it.Next()))
+    {
+      iHash = HashCombine(iHash,HashString(arg->GetName()));
+      if(RooAbsReal* real = dynamic_cast<RooAbsReal*>(arg))
+	iHash = HashCombine(iHash,HashDouble(real->getVal()));
+      else if(RooAbsCategory* cat = dynamic_cast<RooAbsCategory*>(arg))
+	iHash = HashCombine(iHash,cat->getIndex());
+    }
+
+    return iHash;
+  }
+
+  ULong64_t GetDataHash(const RooAbsData& data)
+  {
+    ULong64_t iHash = HashCombine(data.numEntries(),HashDouble(data.sumEntries()));
+
+    // the dataset reuses the same row object for all entries
+    const RooArgSet* pRow = data.get();
+    if(!pRow)
+      return iHash;
+    std::vector<RooAbsReal*> vReals;
+    std::vector<RooAbsCategory*> vCats;
+    RooLinkedListIter it = pRow->iterator();
+    RooAbsArg* arg = 0;
+    while((arg = (RooAbsArg*)it.Next()))
+    {
+      iHash = HashCombine(iHash,HashString(arg->GetName()));
+      if(RooAbsReal* real = dynamic_cast<RooAbsReal*>(arg))
+	vReals.push_back(real);
+      else if(RooAbsCategory* cat = dynamic_cast<RooAbsCategory*>(arg))
+	vCats.push_back(cat);
+    }
+
+    for(int i = 0; i < data.numEntries(); ++i)
+    {
+      data.get(i);
+      for(auto real : vReals)
+	iHash = HashCombine(iHash,HashDouble(real->getVal()));
+      for(auto cat : vCats)
+	iHash = HashCombine(iHash,cat->getIndex());
+      iHash = HashCombine(iHash,HashDouble(data.weight()));
+    }
+
+    return iHash;
+  }
+
+  ULong64_t GetPdfHash(const RooAbsPdf& pdf)
+  {
+    ULong64_t iHash = HashString(pdf.GetName());
+
+    RooArgSet* pComponents = pdf.getComponents();
+    RooLinkedListIter it = pComponents->iterator();
+    RooAbsArg* arg = 0;
+    while((arg = (RooAbsArg*)it.Next()))
+    {
+      iHash = HashCombine(iHash,HashString(arg->GetName()));
+      iHash = HashCombine(iHash,HashString(arg->ClassName()));
+    }
+    delete pComponents;
+
+    RooArgSet* pVariables = pdf.getVariables();
+    it = pVariables->iterator();
+    while((arg = (RooAbsArg*)it.Next()))
+    {
+      iHash = HashCombine(iHash,HashString(arg->GetName()));
+      iHash = HashCombine(iHash,arg->isConstant());
+      if(RooRealVar* var = dynamic_cast<RooRealVar*>(arg))
+      {
+	iHash = HashCombine(iHash,HashDouble(var->getMin()));
+	iHash = HashCombine(iHash,HashDouble(var->getMax()));
+	iHash = HashCombine(iHash,var->getBins());
+	if(var->isConstant())
+	  iHash = HashCombine(iHash,HashDouble(var->getVal()));
+      }
+      else if(RooAbsCategory* cat = dynamic_cast<RooAbsCategory*>(arg))
+      {
+	if(cat->isConstant())
+	  iHash = HashCombine(iHash,cat->getIndex());
+      }
+    }
+    delete pVariables;
+
+    return iHash;
+  }
+}
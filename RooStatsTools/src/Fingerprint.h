@@ -0,0 +1,46 @@
+#ifndef CG_FINGERPRINT_H
+#define CG_FINGERPRINT_H
+
+#include <cstring>
+
+#include "RtypesCore.h"
+
+class RooAbsCollection;
+class RooAbsData;
+class RooAbsPdf;
+
+namespace CG_Statistics
+{
+  // combine two hash values
+  inline ULong64_t HashCombine(ULong64_t iSeed,ULong64_t iValue)
+  {
+    return iSeed ^ (iValue + 0x9e3779b97f4a7c15ULL + (iSeed << 6) + (iSeed >> 2));
+  }
+
+  // hash of the bit pattern of a double
+  inline ULong64_t HashDouble(double dValue)
+  {
+    // do not distinguish between +0 and -0
+    if(dValue == 0)
+      dValue = 0;
+    ULong64_t iBits = 0;
+    std::memcpy(&iBits,&dValue,sizeof(dValue));
+    return iBits;
+  }
+
+  // FNV-1a hash of a string
+  ULong64_t HashString(const char* sValue);
+
+  // hash of names and values of all real and category valued elements
+  ULong64_t GetValuesHash(const RooAbsCollection& set);
+
+  // hash of the content (observable values and weights) of a dataset
+  ULong64_t GetDataHash(const RooAbsData& data);
+
+  // hash of the structure of a pdf (names and classes of all components), the names, ranges and constant
+  // flags of all its variables and the values of the constant ones
+  // (independent of memory addresses and hence stable between programme runs)
+  ULong64_t GetPdfHash(const RooAbsPdf& pdf);
+}
+
+#endif // CG_FINGERPRINT_H
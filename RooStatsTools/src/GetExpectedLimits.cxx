@@ -0,0 +1,88 @@
+#include <iostream>
+#include <limits>
+
+#include "Math/ProbFunc.h"
+#include "Math/QuantFuncMathCore.h"
+
+#include "RooAbsData.h"
+#include "RooRealVar.h"
+using namespace RooFit;
+
+#include "RooStats/ModelConfig.h"
+#include "RooStats/HypoTestInverterResult.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "AsimovCache.h"
+#include "AsymptoticTools.h"
+#include "Instrumentation.h"
+
+namespace CG_Statistics
+{
+  ExpectedLimits GetExpectedLimits(RooAbsData& data,
+				   ModelConfig& mc,
+				   bool bUseCLs,
+				   double dConf,
+				   double dLow,
+				   double dHigh,
+				   double dPrecision,
+				   unsigned int iMaxIterations)
+  {
+    CallScope scope;
+
+    // all limits are NaN if they cannot be calculated
+    const double dNaN = std::numeric_limits<double>::quiet_NaN();
+    ExpectedLimits limits = {dNaN,dNaN,dNaN,dNaN,dNaN,dNaN};
+
+    // observed limit
+    HypoTestInverterResult* pResult = GetUpperLimit(data,mc,bUseCLs,dConf,dLow,dHigh,dPrecision,iMaxIterations);
+    if(!pResult)
+      return limits;
+    limits.dObserved = pResult->UpperLimit();
+    delete pResult;
+
+    // get parameter of interest
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+
+    // get sigma(mu^prime) at mu^prime = 0 (already known from observed CL(s) limit which used the same
+    // POI range, part of the key of the Asimov cache)
+    double dSigma = 0;
+    {
+      NegativePOIRange range(*pPOI);
+      ScopedTimer timer(&PerfCounters::dInversionTime);
+      dSigma = AsimovCache::Instance().GetSigma(data,mc,0);
+    }
+    if(!IsValidSigma(dSigma))
+    {
+      if(iVERBOSITY >= eERROR)
+	std::cerr << "expected limits need sigma(" << pPOI->GetName() << ") of the Asimov dataset but got " << dSigma << std::endl;
+      return limits;
+    }
+
+    // expected limit for a b-only observation fluctuated by N sigma (arxiv:1007.1727v3 equations 88 and 89)
+    // CL(s+b): sigma * (Phi^-1(1 - alpha) + N)
+    // CL(s):   sigma * (Phi^-1(1 - alpha * Phi(N)) + N)
+    const double dAlpha = 1 - dConf;
+    double vBand[5];
+    for(int N = -2; N <= 2; ++N)
+    {
+      const double dCLb = bUseCLs ? ROOT::Math::normal_cdf(N,1) : 1;
+      vBand[N + 2] = dSigma * (ROOT::Math::normal_quantile(1 - dAlpha * dCLb,1) + N);
+    }
+    limits.dMinus2 = vBand[0];
+    limits.dMinus1 = vBand[1];
+    limits.dMedian = vBand[2];
+    limits.dPlus1  = vBand[3];
+    limits.dPlus2  = vBand[4];
+
+    if(iVERBOSITY >= eINFO)
+    {
+      std::cout << "observed limit: " << limits.dObserved << std::endl;
+      std::cout << "expected limit: " << limits.dMedian << " [" << limits.dMinus1 << "," << limits.dPlus1 << "] (1 sigma) ["
+		<< limits.dMinus2 << "," << limits.dPlus2 << "] (2 sigma)" << std::endl;
+    }
+
+    return limits;
+  }
+}
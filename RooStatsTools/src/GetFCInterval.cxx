@@ -1,25 +1,204 @@
 #include <algorithm>
-#include <utility>
-#include <set>
+#include <cmath>
+#include <iostream>
+#include <map>
 #include <iterator>
+#include <vector>
+
+#include "Math/ProbFunc.h"
 
 #include "RooAbsData.h"
+#include "RooAbsPdf.h"
 #include "RooRealVar.h"
 using namespace RooFit;
 
+#include "TObjArray.h"
+
 #include "RooStats/ModelConfig.h"
-#include "RooStats/FrequentistCalculator.h"
-#include "RooStats/ProfileLikelihoodTestStat.h"
-#include "RooStats/HypoTestInverter.h"
+#include "RooStats/HypoTestResult.h"
 #include "RooStats/HypoTestInverterResult.h"
-#include "RooStats/ToyMCSampler.h"
 using namespace RooStats;
 
 // custom include(s)
 #include "RooStatsTools.h"
+#include "WorkerPool.h"
+#include "RootFinder.h"
+#include "ToyEngine.h"
+#include "AsimovCache.h"
+#include "LikelihoodContext.h"
+#include "Instrumentation.h"
+#include "Checkpoint.h"
+#include "Fingerprint.h"
+#include "ModelClone.h"
 
 namespace CG_Statistics
 {
+  namespace
+  {
+    // iPoints equidistant points in [dLow ... dHigh]
+    std::vector<double> GetGridPoints(double dLow,double dHigh,unsigned int iPoints)
+    {
+      std::vector<double> vPoints;
+      if(iPoints == 1)
+	vPoints.push_back(0.5 * (dLow + dHigh));
+      else
+      {
+	for(unsigned int i = 0; i < iPoints; ++i)
+	  vPoints.push_back(dLow + i * (dHigh - dLow) / (iPoints - 1));
+      }
+
+      return vPoints;
+    }
+
+    // test the given points and add the results to the given inversion result
+    //
+    // The points are distributed round-robin over the workers and each worker splits the toys of its
+    // points over its share of the remaining workers (e.g. 2 points with 8 workers -> 4 workers per point).
+    // The null hypothesis is the tested point and toys are only generated for it. With iBlockToys > 0 the
+    // toys are generated sequentially until CL(s+b) is clearly above or below 1 - dConf
+    // (see RunSequentialToyHypoTest). New toys for the sampling distribution store are passed back to this
+    // process which writes them (see RunWorkers).
+    void RunFCScan(HypoTestInverterResult& r,
+		   RooAbsData& data,
+		   ModelConfig& mc,
+		   const std::vector<double>& vPoints,
+		   unsigned int iToys,
+		   unsigned int iWorkers,
+		   unsigned int iBlockToys)
+    {
+      if(vPoints.empty())
+	return;
+
+      RooRealVar* poi = (RooRealVar*)mc.GetParametersOfInterest()->first();
+      const double dTarget = 1 - r.ConfidenceLevel();
+
+      iWorkers = GetNWorkers(iWorkers);
+      const unsigned int iPointWorkers = std::min(iWorkers,(unsigned int)vPoints.size());
+
+      auto task = [&](unsigned int iWorker) -> TObject*
+	{
+	  const unsigned int iToyWorkers = GetWorkerShare(iWorkers,iPointWorkers,iWorker);
+
+	  TObjArray* pResults = new TObjArray(vPoints.size());
+	  pResults->SetOwner(kTRUE);
+	  for(unsigned int i = iWorker; i < vPoints.size(); i += iPointWorkers)
+	  {
+	    if(iVERBOSITY >= eINFO)
+	      std::cout << "test " << poi->GetName() << " = " << vPoints.at(i) << std::endl;
+
+	    pResults->AddAt(RunSequentialToyHypoTest(data,mc,vPoints.at(i),0,eTWOSIDED,dTarget,iToys,iBlockToys,iToyWorkers),i);
+	  }
+
+	  return pResults;
+	};
+
+      // copies of the model for the toy workers are made once and inherited by the point workers, so they
+      // are reused for all blocks and points
+      PrepareWorkerModels(mc,(iWorkers + iPointWorkers - 1) / iPointWorkers);
+      // add results in the order of the given points
+      std::vector<TObject*> vArrays = RunWorkers(iPointWorkers,task);
+      for(unsigned int i = 0; i < vPoints.size(); ++i)
+      {
+	TObjArray* pResults = (TObjArray*)vArrays.at(i % iPointWorkers);
+	HypoTestResult* pResult = pResults ? (HypoTestResult*)pResults->At(i) : 0;
+	if(pResult)
+	  r.Add(vPoints.at(i),*pResult);
+      }
+
+      for(auto pObj : vArrays)
+	delete pObj;
+    }
+
+    // test the given points using the asymptotic distribution of the two-sided test statistic and add
+    // the results to the given inversion result
+    //
+    // t_mu = -2 log(lambda(mu)) is evaluated with the NLL of the given context (conditional fits start
+    // from already fitted neighbours). Without lower boundary of the POI, t_mu follows a chi^2 distribution
+    // (arxiv:1007.1727v3 equation 36): p = 2 Phi_c(sqrt(t)). A lower boundary m is taken into account as for
+    // t~_mu in arxiv:1007.1727v3 equation 43 with sigma of the b-only Asimov dataset (dSigma, see
+    // GetBoundarySigma):
+    // p = 2 Phi_c(sqrt(t))                                 for t <= ((mu - m)/sigma)^2
+    // p = Phi_c(sqrt(t)) + Phi_c((t + a^2)/(2a))           for t >  a^2 = ((mu - m)/sigma)^2
+    // p = Phi_c(sqrt(t))                                   for t > 0 at the boundary (a = 0)
+    void RunAsymptoticFCScan(HypoTestInverterResult& r,
+			     LikelihoodContext& context,
+			     ModelConfig& mc,
+			     double dSigma,
+			     const std::vector<double>& vPoints)
+    {
+      RooRealVar* poi = (RooRealVar*)mc.GetParametersOfInterest()->first();
+      const double dUncondNLL = context.GetUnconditionalNLL();
+      const bool bBounded = poi->hasMin();
+
+      for(double x : vPoints)
+      {
+	const double t = std::max(2 * (context.GetConditionalNLL(x) - dUncondNLL),0.);
+	const double a = bBounded ? (x - poi->getMin()) / dSigma : 0;
+
+	double p = 0;
+	if(!bBounded || (t <= a * a))
+	  p = 2 * ROOT::Math::normal_cdf_c(sqrt(t),1);
+	else if(a <= 0)
+	  p = ROOT::Math::normal_cdf_c(sqrt(t),1);
+	else
+	  p = ROOT::Math::normal_cdf_c(sqrt(t),1) + ROOT::Math::normal_cdf_c((t + a * a) / (2 * a),1);
+
+	if(iVERBOSITY >= eINFO)
+	  std::cout << "test " << poi->GetName() << " = " << x << ": t = " << t << " --> CL(s+b) = " << p << std::endl;
+
+	// CL(b) = 1 and CL(s+b) = p
+	r.Add(x,HypoTestResult("AsymptoticFC",1,p));
+      }
+    }
+
+    // sigma(mu') at the lower boundary of the POI for RunAsymptoticFCScan (Asimov dataset and fits are only
+    // done once, 0 for POIs without lower boundary, not valid if it cannot be evaluated, see IsValidSigma)
+    double GetBoundarySigma(RooAbsData& data,ModelConfig& mc)
+    {
+      RooRealVar* poi = (RooRealVar*)mc.GetParametersOfInterest()->first();
+      if(!poi->hasMin())
+	return 0;
+
+      return AsimovCache::Instance().GetSigma(data,mc,std::max(poi->getMin(),0.));
+    }
+
+    // asymptotic formulae are assumed to be valid if the observed number of events and the numbers of
+    // events expected (extended pdfs only) at both ends of the tested range [dLow ... dHigh] are large enough
+    // (the expected number of events is usually monotonic in the POI)
+    bool IsAsymptoticRegime(RooAbsData& data,ModelConfig& mc,double dLow,double dHigh)
+    {
+      const double dMinEvents = 100;
+      if(data.sumEntries() < dMinEvents)
+	return false;
+
+      RooAbsPdf* pPDF = mc.GetPdf();
+      if(!pPDF->canBeExtended())
+	return false;
+
+      RooRealVar* poi = (RooRealVar*)mc.GetParametersOfInterest()->first();
+      const double dOldValue = poi->getVal();
+      poi->setVal(dLow);
+      const double dExpectedLow = pPDF->expectedEvents(mc.GetObservables());
+      poi->setVal(dHigh);
+      const double dExpectedHigh = pPDF->expectedEvents(mc.GetObservables());
+      poi->setVal(dOldValue);
+
+      return (dExpectedLow >= dMinEvents) && (dExpectedHigh >= dMinEvents);
+    }
+
+    // key of the checkpoints of a scan (model, dataset and all arguments affecting the result)
+    ULong64_t GetCheckpointKey(RooAbsData& data,ModelConfig& mc,const std::vector<double>& vArguments)
+    {
+      ULong64_t iHash = GetPdfHash(*mc.GetPdf());
+      iHash = HashCombine(iHash,HashString(mc.GetParametersOfInterest()->first()->GetName()));
+      iHash = HashCombine(iHash,GetDataHash(data));
+      for(double dArgument : vArguments)
+	iHash = HashCombine(iHash,HashDouble(dArgument));
+
+      return iHash;
+    }
+  }
+  
 #ifndef CG_EXPERIMENTAL
   HypoTestInverterResult* GetFCInterval(RooAbsData& data,
 					ModelConfig& mc,
@@ -27,7 +206,10 @@ namespace CG_Statistics
 					double dLow,
 					double dHigh,
 					double dStep,
-					unsigned int iToys)
+					unsigned int iToys,
+					unsigned int iWorkers,
+					unsigned int iBlockToys,
+					FCMODE eMode)
 #else
   HypoTestInverterResult* GetFCInterval(RooAbsData& data,
 					ModelConfig& mc,
@@ -36,9 +218,15 @@ namespace CG_Statistics
 					double dLow,
 					double dHigh,
 					unsigned int iPoints,
-					unsigned int iToys)
+					unsigned int iToys,
+					unsigned int iWorkers,
+					unsigned int iBlockToys,
+					FCMODE eMode)
 #endif // CG_EXPERIMENTAL    
   {
+    CallScope scope;
+    ScopedTimer timer(&PerfCounters::dInversionTime);
+
     // get parameter of interest
     RooRealVar* poi = (RooRealVar*)mc.GetParametersOfInterest()->first();
 
@@ -46,76 +234,118 @@ namespace CG_Statistics
     assert(dLow < dHigh);
     assert(dLow < poi->getMax());
     assert(dHigh > poi->getMin());
-    assert(iToys > 1/(1 - dConf));
     
-    // build profile likelihood test statistics
-    ProfileLikelihoodTestStat plts(*mc.GetPdf());
+    // set scan range
+    dLow  = std::max(dLow,poi->getMin());
+    dHigh = std::min(dHigh,poi->getMax());
 
-    ModelConfig* bModel = (ModelConfig*)mc.Clone("bModel");
-    poi->setVal(0);
-    bModel->SetSnapshot(*poi);
+    // use toys only where needed
+    bool bAsymptotic = (eMode == eASYMPTOTIC) || ((eMode == eAUTOMATIC) && IsAsymptoticRegime(data,mc,dLow,dHigh));
 
-    // build the frequentist calculator
-    FrequentistCalculator fc(data,*bModel,mc);
-    fc.SetToys(iToys,0);
-  
-    // initialise hypo test inverter
-    HypoTestInverter calc(fc,poi,1-dConf);
+    // the boundary of the POI needs sigma(mu') from the Asimov dataset
+    const double dSigma = bAsymptotic ? GetBoundarySigma(data,mc) : 0;
+    if(bAsymptotic && poi->hasMin() && !IsValidSigma(dSigma))
+    {
+      if(eMode == eASYMPTOTIC)
+      {
+	if(iVERBOSITY >= eERROR)
+	  std::cerr << "asymptotic FC interval needs sigma(" << poi->GetName() << ") of the Asimov dataset but got " << dSigma << std::endl;
+	return 0;
+      }
+
+      if(iVERBOSITY >= eWARNING)
+	std::cout << "sigma(" << poi->GetName() << ") of the Asimov dataset is " << dSigma << " -> use toys" << std::endl;
+      bAsymptotic = false;
+    }
+    assert(bAsymptotic || (iToys > 1/(1 - dConf)));
     if(iVERBOSITY >= eINFO)
-      calc.SetVerbose(2);
+      std::cout << "calculate CL(s+b) using " << (bAsymptotic ? "asymptotic formulae" : "toys") << std::endl;
 
-    // configrue toy MC sample
-    ToyMCSampler* toymcs = (ToyMCSampler*)calc.GetHypoTestCalculator()->GetTestStatSampler();
-    toymcs->SetTestStatistic(&plts);
-    if (!mc.GetPdf()->canBeExtended())
-      toymcs->SetNEventsPerToy(1);
+    // NLL and unconditional fit are shared by all points (asymptotic mode only)
+    LikelihoodContext* pContext = bAsymptotic ? new LikelihoodContext(data,*mc.GetPdf(),RooArgSet(*poi),false) : 0;
 
-    // set scan range
-    dLow  = std::max(dLow,poi->getMin());
-    dHigh = std::min(dHigh,poi->getMax());
+    // two-sided interval from CL(s+b) of all tested points
+    HypoTestInverterResult* r = new HypoTestInverterResult(bAsymptotic ? "AsymptoticFCInterval" : "FCInterval",*poi,dConf);
+    r->UseCLs(false);
+    r->SetTwoSided(true);
+
+    auto scan = [&](const std::vector<double>& vPoints)
+      {
+	if(pContext)
+	  RunAsymptoticFCScan(*r,*pContext,mc,dSigma,vPoints);
+	else
+	  RunFCScan(*r,data,mc,vPoints,iToys,iWorkers,iBlockToys);
+      };
+
+    // resume from checkpoint
+    Checkpoint& checkpoint = Checkpoint::Instance();
+    ULong64_t iKey = 0;
+    bool bResumed = false;
+    // number of iterations performed
+    unsigned int iIterations = 1;
+    std::vector<double> vScanPoints;
+    if(checkpoint.IsOpen())
+    {
+#ifndef CG_EXPERIMENTAL
+      iKey = GetCheckpointKey(data,mc,{dConf,dLow,dHigh,dStep,(double)iToys,(double)iWorkers,(double)iBlockToys,(double)bAsymptotic});
+#else
+      iKey = GetCheckpointKey(data,mc,{dConf,(double)iMaxIterations,dLow,dHigh,(double)iPoints,(double)iToys,(double)iWorkers,(double)iBlockToys,(double)bAsymptotic});
+#endif // CG_EXPERIMENTAL
+      HypoTestInverterResult* pSaved = 0;
+      bResumed = checkpoint.Load(iKey,pSaved,iIterations,vScanPoints);
+      if(bResumed)
+      {
+	delete r;
+	r = pSaved;
+	if(iVERBOSITY >= eINFO)
+	  std::cout << "resume scan at iteration " << iIterations << " with " << r->ArraySize() << " tested point(s)" << std::endl;
+      }
+    }
 
 #ifndef CG_EXPERIMENTAL
     // run fixed scan
     unsigned int iPoints = (unsigned int)((dHigh - dLow)/dStep + 0.5) + 1;
-    calc.SetFixedScan(iPoints,dLow,dHigh);
+    if(!bResumed)
+      vScanPoints = GetGridPoints(dLow,dHigh,iPoints);
 
-    // get result
-    HypoTestInverterResult* r = calc.GetInterval();
+    // get result (with checkpoints after every group of points with one point per worker)
+    const unsigned int iGroup = checkpoint.IsOpen() ? GetNWorkers(iWorkers) : vScanPoints.size();
+    while(!vScanPoints.empty())
+    {
+      const unsigned int iTested = std::min(iGroup,(unsigned int)vScanPoints.size());
+      scan(std::vector<double>(vScanPoints.begin(),vScanPoints.begin() + iTested));
+      vScanPoints.erase(vScanPoints.begin(),vScanPoints.begin() + iTested);
+
+      if(checkpoint.IsOpen())
+	checkpoint.Save(iKey,*r,++iIterations,vScanPoints);
+    }
 #else
-    std::vector<std::pair<double,double> > vScanRanges;
-    vScanRanges.push_back(std::make_pair(dLow,dHigh));
+    // start with equidistant scan of full range
+    if(!bResumed)
+      vScanPoints = GetGridPoints(dLow,dHigh,iPoints);
 
-    // number of iterations performed
-    unsigned int iIterations = 1;
-    // list of scanned points with associated p-values
-    std::set<std::pair<double,double> > sPoints;
-    // obtained results from the scans
-    HypoTestInverterResult* r = 0;
-    // number of points already scanned
-    int iScannedPoints = 0;
-    // number of points to use in a scan
-    int iCurPoints = iPoints;
-    do
+    // scanned points with associated p-values (updated with the results of every iteration)
+    std::map<double,double> sPoints;
+    for(int i = 0; bResumed && (i < r->ArraySize()); ++i)
+      sPoints[r->GetXValue(i)] = r->CLsplusb(i);
+
+    // resumed scan may already be finished
+    const bool bFinished = bResumed && (vScanPoints.empty() || (iIterations > iMaxIterations));
+    while(!bFinished)
     {
       if(iVERBOSITY >= eINFO)
-	std::cout << "iteration: " << iIterations << " with " << vScanRanges.size() << " range(s)" << std::endl;
+	std::cout << "iteration: " << iIterations << " with " << vScanPoints.size() << " point(s)" << std::endl;
       
-      // do fixed scans in region of interests
-      for(auto& range : vScanRanges)
+      // test points of current iteration (in parallel)
+      scan(vScanPoints);
+
+      // update p-values of recently scanned points (toys for an already scanned point are merged)
+      for(double x : vScanPoints)
       {
-	if(iVERBOSITY >= eINFO)
-	  std::cout << "scan [" << range.first << " ... " << range.second << "] with " << iCurPoints << " points" << std::endl;
-	
-	calc.RunFixedScan(iCurPoints,range.first,range.second);
+	int iIndex = r->FindIndex(x);
+	if(iIndex >= 0)
+	  sPoints[r->GetXValue(iIndex)] = r->CLsplusb(iIndex);
       }
-
-      // get current result
-      r = calc.GetInterval();
-      assert(r);
-      
-      // get list of recently scanned points with associated p-values
-      for(int iIndex = iScannedPoints; iIndex < r->ArraySize(); ++iIndex)
-	sPoints.insert(std::make_pair(r->GetXValue(iIndex),r->CLsplusb(iIndex)));
       assert(!sPoints.empty());
 
       if(iVERBOSITY >= eDEBUG)
@@ -124,46 +354,42 @@ namespace CG_Statistics
 	  std::cout << (*it).first << ": " << (*it).second << std::endl;
       }
       
-      // update number of scanned points
-      iScannedPoints = r->ArraySize();
-
-      // clear regions of interest
-      vScanRanges.clear();
+      // clear points for next iteration
+      vScanPoints.clear();
 
-      // update regions of interest
       // search for adjacent points A and B which have p-values on different sides of the target p-value
-      // then add the range [A ... B] to the regions of interest
-      // as we already have the p-values at A and B, the actual new range to scan is
-      // step = abs(A - B)/ (iPoints - 1) --> [A + step ... B - step] in iPoints - 2 steps (assuming A < B)
+      // and add the root finder estimate for the interval boundary in [A ... B] to the next iteration
+      // (the outer neighbours of A and B on the same side of the target are used for the interpolation)
+      const double dTarget = 1 - dConf;
       for(auto it = sPoints.begin(); it != std::prev(sPoints.end()); ++it)
       {
 	auto next = std::next(it);
-	if(((*it).second - (1 - dConf)) * ((*next).second - (1 - dConf)) < 0)
+	if(((*it).second - dTarget) * ((*next).second - dTarget) < 0)
 	{
-	  dLow = (*it).first + ((*next).first - (*it).first) / (iPoints - 1);
-	  dHigh = (*next).first - ((*next).first - (*it).first) / (iPoints - 1);
-	  vScanRanges.push_back(std::make_pair(dLow,dHigh));
+	  RootFinder finder(dTarget,(*it).first,(*next).first);
+	  finder.AddPoint((*it).first,(*it).second);
+	  finder.AddPoint((*next).first,(*next).second);
+	  if((it != sPoints.begin()) && (((*std::prev(it)).second - dTarget) * ((*it).second - dTarget) > 0))
+	    finder.AddPoint((*std::prev(it)).first,(*std::prev(it)).second);
+	  auto after = std::next(next);
+	  if((after != sPoints.end()) && (((*after).second - dTarget) * ((*next).second - dTarget) > 0))
+	    finder.AddPoint((*after).first,(*after).second);
+
+	  vScanPoints.push_back(finder.GetNextPoint());
 	}
       }
 
-      
-      // delete clone
-      delete r;
-
-      // reduce number of scanned points by 2 after first iteration as new range boundaries will already be scanned from previous iteration
-      if(iIterations == 1)
-	iCurPoints -= 2;
-      
       ++iIterations;
-    } while(iIterations <= iMaxIterations);
+      if(checkpoint.IsOpen())
+	checkpoint.Save(iKey,*r,iIterations,vScanPoints);
 
-    // get final result
-    r = calc.GetInterval();
+      // no further refinement possible
+      if(vScanPoints.empty() || (iIterations > iMaxIterations))
+	break;
+    }
 #endif // CG_EXPERIMENTAL    
 
-    
-    // clean up
-    delete bModel;
+    delete pContext;
 
     return r;
   }
@@ -6,12 +6,17 @@ using namespace RooFit;
 #include "RooStats/LikelihoodInterval.h"
 using namespace RooStats;
 
+// custom include(s)
+#include "Instrumentation.h"
+
 namespace CG_Statistics
 {
   LikelihoodInterval* GetLikelihoodInterval(RooAbsData& data,
 					    ModelConfig& mc,
 					    double dConf)
   {
+    CallScope scope;
+
     // initialise profile likelihood calculator
     ProfileLikelihoodCalculator plc(data,mc);
     plc.SetConfidenceLevel(dConf);
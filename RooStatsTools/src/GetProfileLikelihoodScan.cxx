@@ -0,0 +1,279 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "Math/QuantFuncMathCore.h"
+#include "TNtupleD.h"
+#include "TVectorD.h"
+
+#include "RooAbsData.h"
+#include "RooAbsPdf.h"
+#include "RooRealVar.h"
+#include "RooArgSet.h"
+#include "RooLinkedListIter.h"
+using namespace RooFit;
+
+#include "RooStats/ModelConfig.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "ModelClone.h"
+#include "WorkerPool.h"
+#include "LikelihoodContext.h"
+#include "Instrumentation.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // point on the scan lattice (integer coordinate per POI)
+    typedef std::vector<int> LatticePoint;
+
+    // boustrophedon (serpentine) order of lattice points with the given spacing
+    //
+    // The direction along an axis flips with the parity of the sum of the outer coordinates (in units of
+    // the spacing), so consecutive points are neighbours on the lattice.
+    struct SerpentineLess
+    {
+      explicit SerpentineLess(int iStep): m_iStep(iStep) {}
+
+      bool operator()(const LatticePoint& a,const LatticePoint& b) const
+      {
+	int iParity = 0;
+	for(unsigned int i = 0; i < a.size(); ++i)
+	{
+	  if(a[i] != b[i])
+	    return (iParity % 2 == 0) ? (a[i] < b[i]) : (a[i] > b[i]);
+	  iParity += a[i] / m_iStep;
+	}
+
+	return false;
+      }
+
+      int m_iStep;
+    };
+
+    // iCount points with spacing iStep along each axis starting at the given lower corner
+    std::vector<LatticePoint> GetBlockPoints(const LatticePoint& lower,int iStep,int iCount)
+    {
+      std::vector<LatticePoint> vPoints;
+      LatticePoint offset(lower.size(),0);
+      while(true)
+      {
+	LatticePoint point(lower);
+	for(unsigned int i = 0; i < lower.size(); ++i)
+	  point[i] += offset[i] * iStep;
+	vPoints.push_back(point);
+
+	// next offset (odometer)
+	unsigned int i = 0;
+	for(; i < offset.size(); ++i)
+	{
+	  if(++offset[i] < iCount)
+	    break;
+	  offset[i] = 0;
+	}
+	if(i == offset.size())
+	  break;
+      }
+
+      return vPoints;
+    }
+
+    // profiled NLL for the given POI values
+    //
+    // The points are split into contiguous chunks (one per worker). Each worker fits its chunk in the given
+    // order with its own likelihood context, so every conditional fit starts from an already fitted neighbour.
+    // Points of failed workers yield NaN.
+    std::vector<double> EvaluateProfile(RooAbsData& data,
+					ModelConfig& mc,
+					const std::vector<std::vector<double> >& vValues,
+					unsigned int iWorkers)
+    {
+      std::vector<double> vNLL(vValues.size(),std::numeric_limits<double>::quiet_NaN());
+      if(vValues.empty())
+	return vNLL;
+
+      iWorkers = std::min(GetNWorkers(iWorkers),(unsigned int)vValues.size());
+      std::vector<unsigned int> vBegin(1,0);
+      for(unsigned int iWorker = 0; iWorker < iWorkers; ++iWorker)
+	vBegin.push_back(vBegin.back() + GetWorkerShare(vValues.size(),iWorkers,iWorker));
+
+      auto task = [&](unsigned int iWorker) -> TObject*
+	{
+	  // independent copy of the model (made once per scan and worker)
+	  ModelClone& clone = GetWorkerModel(mc,iWorker);
+	  LikelihoodContext context(data,*clone.GetModel().GetPdf(),*clone.GetModel().GetParametersOfInterest(),false);
+
+	  TVectorD* pNLL = new TVectorD(vBegin[iWorker + 1] - vBegin[iWorker]);
+	  for(unsigned int i = vBegin[iWorker]; i < vBegin[iWorker + 1]; ++i)
+	    (*pNLL)[i - vBegin[iWorker]] = context.GetConditionalNLL(vValues.at(i));
+
+	  return pNLL;
+	};
+
+      PrepareWorkerModels(mc,iWorkers);
+      std::vector<TObject*> vResults = RunWorkers(iWorkers,task);
+      for(unsigned int iWorker = 0; iWorker < iWorkers; ++iWorker)
+      {
+	TVectorD* pNLL = (TVectorD*)vResults[iWorker];
+	if(!pNLL)
+	  continue;
+
+	for(unsigned int i = vBegin[iWorker]; i < vBegin[iWorker + 1]; ++i)
+	  vNLL[i] = (*pNLL)[i - vBegin[iWorker]];
+	delete pNLL;
+      }
+
+      return vNLL;
+    }
+  }
+
+  TNtupleD* GetProfileLikelihoodScan(RooAbsData& data,
+				     ModelConfig& mc,
+				     unsigned int iPoints,
+				     double dConf,
+				     unsigned int iRefinements,
+				     unsigned int iWorkers)
+  {
+    CallScope scope;
+
+    RooAbsPdf* pPDF = mc.GetPdf();
+    assert(pPDF);
+    assert(iPoints > 1);
+
+    // get parameters of interest
+    std::vector<RooRealVar*> vPOIs;
+    RooLinkedListIter it = mc.GetParametersOfInterest()->iterator();
+    RooRealVar* poi = 0;
+    while((poi = (RooRealVar*)it.Next()))
+      vPOIs.push_back(poi);
+    const unsigned int iDim = vPOIs.size();
+    assert(iDim > 0);
+
+    // store parameters of pdf
+    RooArgSet* allParams = pPDF->getParameters(data);
+    RooArgSet* pSnapshot = (RooArgSet*)allParams->snapshot();
+
+    // global minimum (parameters stay at the best fit values which are the starting point of the workers)
+    double dMinNLL = 0;
+    {
+      LikelihoodContext context(data,*pPDF,*mc.GetParametersOfInterest(),false);
+      dMinNLL = context.GetUnconditionalNLL();
+    }
+
+    // contour level of q = 2 * (NLL - NLL_min)
+    const double dLevel = ROOT::Math::chisquared_quantile(dConf,iDim);
+
+    // lattice with the resolution of the last refinement (initial grid uses every iStep-th lattice point)
+    int iStep = 1 << iRefinements;
+    const int iSize = (iPoints - 1) * iStep + 1;
+    auto GetValues = [&](const LatticePoint& point)
+      {
+	std::vector<double> vValues;
+	for(unsigned int i = 0; i < iDim; ++i)
+	  vValues.push_back(vPOIs[i]->getMin() + point[i] * (vPOIs[i]->getMax() - vPOIs[i]->getMin()) / (iSize - 1));
+	return vValues;
+      };
+
+    // profiled NLL of all evaluated points
+    std::map<LatticePoint,double> mNLL;
+    std::vector<LatticePoint> vNew = GetBlockPoints(LatticePoint(iDim,0),iStep,iPoints);
+    for(unsigned int iRound = 0; !vNew.empty(); ++iRound)
+    {
+      if(iVERBOSITY >= eINFO)
+	std::cout << "round " << iRound << ": evaluate " << vNew.size() << " point(s)" << std::endl;
+
+      // warm start: consecutive points are neighbours
+      std::sort(vNew.begin(),vNew.end(),SerpentineLess(iStep));
+      std::vector<std::vector<double> > vValues;
+      for(auto& point : vNew)
+	vValues.push_back(GetValues(point));
+
+      std::vector<double> vNLL = EvaluateProfile(data,mc,vValues,iWorkers);
+      for(unsigned int i = 0; i < vNew.size(); ++i)
+      {
+	if(std::isnan(vNLL[i]))
+	  continue;
+	mNLL[vNew[i]] = vNLL[i];
+	dMinNLL = std::min(dMinNLL,vNLL[i]);
+      }
+
+      vNew.clear();
+      if((iRound >= iRefinements) || (iStep < 2))
+	break;
+
+      // refine cells (hypercubes with side iStep) whose corners lie on both sides of the contour
+      std::set<LatticePoint> sNew;
+      for(auto& entry : mNLL)
+      {
+	const LatticePoint& lower = entry.first;
+	bool bLowerCorner = true;
+	for(unsigned int i = 0; i < iDim; ++i)
+	  bLowerCorner = bLowerCorner && (lower[i] % iStep == 0) && (lower[i] + iStep < iSize);
+	if(!bLowerCorner)
+	  continue;
+
+	bool bAbove = false;
+	bool bBelow = false;
+	bool bComplete = true;
+	for(auto& corner : GetBlockPoints(lower,iStep,2))
+	{
+	  auto found = mNLL.find(corner);
+	  if(found == mNLL.end())
+	  {
+	    bComplete = false;
+	    break;
+	  }
+	  const double q = 2 * (found->second - dMinNLL);
+	  bAbove = bAbove || (q > dLevel);
+	  bBelow = bBelow || (q < dLevel);
+	}
+	if(!bComplete || !bAbove || !bBelow)
+	  continue;
+
+	for(auto& point : GetBlockPoints(lower,iStep / 2,3))
+	{
+	  if(mNLL.find(point) == mNLL.end())
+	    sNew.insert(point);
+	}
+      }
+
+      iStep /= 2;
+      vNew.assign(sNew.begin(),sNew.end());
+    }
+
+    // one entry per point: POI values and q
+    std::string sVarList;
+    for(auto pPOI : vPOIs)
+      sVarList += std::string(pPOI->GetName()) + ":";
+    sVarList += "q";
+    TNtupleD* pScan = new TNtupleD("ProfileLikelihoodScan","q = 2 * (NLL - NLL_min)",sVarList.c_str());
+    pScan->SetDirectory(0);
+    std::vector<double> vRow(iDim + 1);
+    for(auto& entry : mNLL)
+    {
+      std::vector<double> vValues = GetValues(entry.first);
+      std::copy(vValues.begin(),vValues.end(),vRow.begin());
+      vRow[iDim] = 2 * (entry.second - dMinNLL);
+      pScan->Fill(&vRow[0]);
+    }
+
+    if(iVERBOSITY >= eINFO)
+      std::cout << "evaluated " << mNLL.size() << " point(s), contour level q = " << dLevel << std::endl;
+
+    // restore parameters of pdf
+    allParams->assignValueOnly(*pSnapshot);
+    delete pSnapshot;
+    delete allParams;
+
+    return pScan;
+  }
+}
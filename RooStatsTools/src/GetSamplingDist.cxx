@@ -3,43 +3,61 @@
 #include "RooAbsData.h"
 //#include "RooAbsPdf.h"
 //#include "RooFitResult.h"
-//#include "RooRealVar.h"
+#include "RooRealVar.h"
 //#include "RooLinkedListIter.h"
 using namespace RooFit;
 
 #include "RooStats/ModelConfig.h"
 #include "RooStats/HypoTestResult.h"
-#include "RooStats/ToyMCSampler.h"
-#include "RooStats/ProfileLikelihoodTestStat.h"
-#include "RooStats/FrequentistCalculator.h"
+#include "RooStats/SamplingDistribution.h"
 using namespace RooStats;
 
+// custom include(s)
+#include "RooStatsTools.h"
+#include "ToyEngine.h"
+#include "Instrumentation.h"
+
 namespace CG_Statistics
 {
   SamplingDistribution* GetSamplingDist(RooAbsData& data,
 					ModelConfig& mc,
-					int iToys)
+					int iToys,
+					unsigned int iWorkers)
   {
-    // need second model
-    ModelConfig* bModel = (ModelConfig*)mc.Clone("bModel");
+    CallScope scope;
+
+    // null hypothesis is given by the snapshot of the model
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+    const double dNullPOI = mc.GetSnapshot() ? mc.GetSnapshot()->getRealValue(pPOI->GetName(),pPOI->getVal()) : pPOI->getVal();
 
-    // initialise frequentist calculator
-    FrequentistCalculator fcalc(data,*bModel,mc);
-    fcalc.SetToys(iToys,0);
+    HypoTestResult* pResult = RunToyHypoTest(data,mc,dNullPOI,dNullPOI,eDISCOVERY,iToys,0,iWorkers);
+    assert(pResult);
 
-    // use profile likelihood as test statistic
-    ProfileLikelihoodTestStat profll(*mc.GetPdf());
-    profll.SetOneSidedDiscovery(true);
+    // take ownership of the distribution from the result
+    SamplingDistribution* pDist = pResult->GetNullDistribution();
+    pResult->SetNullDistribution(0);
+    delete pResult;
+
+    return pDist;
+  }
+
+  TestStatSketch* GetSamplingDistSketch(RooAbsData& data,
+					ModelConfig& mc,
+					unsigned int iToys,
+					double dRelAccuracy,
+					unsigned int iWorkers,
+					unsigned int iBlockToys)
+  {
+    CallScope scope;
 
-    ToyMCSampler *toymcs = (ToyMCSampler*)fcalc.GetTestStatSampler();
-    toymcs->SetTestStatistic(&profll);
+    // null hypothesis is given by the snapshot of the model
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+    const double dNullPOI = mc.GetSnapshot() ? mc.GetSnapshot()->getRealValue(pPOI->GetName(),pPOI->getVal()) : pPOI->getVal();
 
-    if (!mc.GetPdf()->canBeExtended())
-      toymcs->SetNEventsPerToy(1);
-      
-    HypoTestResult* pResult = fcalc.GetHypoTest();
-    delete bModel;
+    TestStatSketch* pSketch = new TestStatSketch(dRelAccuracy);
+    TestStatSketch altSketch(dRelAccuracy);
+    FillToySketches(data,mc,dNullPOI,dNullPOI,eDISCOVERY,iToys,0,iWorkers,iBlockToys,*pSketch,altSketch);
 
-    return pResult->GetNullDistribution();
+    return pSketch;
   }
 }
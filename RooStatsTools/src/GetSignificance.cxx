@@ -1,3 +1,5 @@
+#include <vector>
+
 #include "Math/ProbFunc.h"
 
 #include "RooAbsData.h"
@@ -9,38 +11,38 @@ using namespace RooFit;
 
 #include "RooStats/ModelConfig.h"
 #include "RooStats/HypoTestResult.h"
-#include "RooStats/ToyMCSampler.h"
-#include "RooStats/ProfileLikelihoodTestStat.h"
-#include "RooStats/FrequentistCalculator.h"
 using namespace RooStats;
 
+// custom include(s)
+#include "RooStatsTools.h"
+#include "LikelihoodContext.h"
+#include "ToyEngine.h"
+#include "Instrumentation.h"
+
 namespace CG_Statistics
 {
   HypoTestResult* GetSignificance(RooAbsData& data,
 				  ModelConfig& mc,
-				  int iToys)
+				  int iToys,
+				  bool bImportanceSampling,
+				  unsigned int iWorkers)
   {
+    CallScope scope;
+
     if(iToys > 0)
     {
-      // need second model
-      ModelConfig* bModel = (ModelConfig*)mc.Clone("bModel");
+      // null hypothesis is given by the snapshot of the model
+      RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+      const double dNullPOI = mc.GetSnapshot() ? mc.GetSnapshot()->getRealValue(pPOI->GetName(),pPOI->getVal()) : pPOI->getVal();
 
-      // initialise frequentist calculator
-      FrequentistCalculator fcalc(data,*bModel,mc);
-      fcalc.SetToys(iToys,0);
+      // weighted toys with p-value uncertainty
+      if(bImportanceSampling)
+	return RunImportanceSampledHypoTest(data,mc,dNullPOI,eDISCOVERY,iToys,iWorkers);
 
-      // use profile likelihood as test statistic
-      ProfileLikelihoodTestStat profll(*mc.GetPdf());
-      profll.SetOneSidedDiscovery(true);
-
-      ToyMCSampler *toymcs = (ToyMCSampler*)fcalc.GetTestStatSampler();
-      toymcs->SetTestStatistic(&profll);
-
-      if (!mc.GetPdf()->canBeExtended())
-	toymcs->SetNEventsPerToy(1);
-      
-      HypoTestResult* pResult = fcalc.GetHypoTest();
-      delete bModel;
+      HypoTestResult* pResult = RunToyHypoTest(data,mc,dNullPOI,dNullPOI,eDISCOVERY,iToys,0,iWorkers);
+      // p-value refers to the null hypothesis
+      if(pResult)
+	pResult->SetBackgroundAsAlt(false);
 
       return pResult;
     }
@@ -49,36 +51,27 @@ namespace CG_Statistics
       RooAbsPdf* pPDF = mc.GetPdf();
       assert(pPDF);
 
-      // make sure POI can float
-      RooLinkedListIter it = mc.GetParametersOfInterest()->iterator();
-      RooRealVar *myarg;
-      while((myarg = (RooRealVar *)it.Next()))
-	myarg->setConstant(0);
+      // NLL is built once and shared by both fits (the context makes sure the POIs can float)
+      LikelihoodContext context(data,*pPDF,*mc.GetParametersOfInterest());
       
       // unconditional fit
-      RooFitResult* r = pPDF->fitTo(data,
-				    Extended(pPDF->canBeExtended()),
-				    Save(),
-				    PrintLevel(0));
-      r->Print("v");
-      double dUncondNll = r->minNll();
-      delete r; r = 0;
+      double dUncondNll = context.GetUnconditionalNLL();
+      if(iVERBOSITY >= eDEBUG)
+	context.GetUnconditionalFit().Print("v");
 
       // conditional fit
 
-      // load null hypothesis values and set POIs to constant
+      // load null hypothesis values of POIs (fit starts from unconditional minimum)
       mc.LoadSnapshot();
-      it = mc.GetParametersOfInterest()->iterator();
+      std::vector<double> vNullValues;
+      RooLinkedListIter it = mc.GetParametersOfInterest()->iterator();
+      RooRealVar *myarg;
       while((myarg = (RooRealVar *)it.Next()))
-	myarg->setConstant(1);
+	vNullValues.push_back(myarg->getVal());
 
-      r = pPDF->fitTo(data,
-		      Extended(pPDF->canBeExtended()),
-		      Save(),
-		      PrintLevel(0));
-      r->Print("v");
-      double dCondNll = r->minNll();
-      delete r; r = 0;
+      double dCondNll = context.GetConditionalNLL(vNullValues);
+      if(iVERBOSITY >= eDEBUG)
+	context.GetLastConditionalFit()->Print("v");
 
       return new HypoTestResult("AsymptoticSignificance",ROOT::Math::normal_cdf_c(sqrt(2 * (dCondNll - dUncondNll))),0);
     }
@@ -1,10 +1,13 @@
 #include <iostream>
+#include <mutex>
+
+#include "Math/ProbFunc.h"
+#include "Math/QuantFuncMathCore.h"
 
 #include "RooMsgService.h"
 #include "RooAbsData.h"
 #include "RooAbsPdf.h"
 #include "RooRealVar.h"
-#include "RooFitResult.h"
 #include "RooArgSet.h"
 using namespace RooFit;
 
@@ -12,79 +15,43 @@ using namespace RooFit;
 #include "RooStats/AsymptoticCalculator.h"
 #include "RooStats/HypoTestResult.h"
 #include "RooStats/HypoTestInverterResult.h"
+#include "RooStats/SamplingDistribution.h"
 using namespace RooStats;
 
 // custom include(s)
 #include "RooStatsTools.h"
+#include "ToyEngine.h"
+#include "AsimovCache.h"
+#include "AsymptoticTools.h"
+#include "LikelihoodContext.h"
+#include "RootFinder.h"
+#include "Instrumentation.h"
 
 namespace CG_Statistics
 {
-  double EvaluateQMu(RooAbsData& data,RooAbsPdf& pdf,RooRealVar& poi,double dMuTest)
+  namespace
   {
-    // calculate q_mu: arxiv:1007.1727v3 equation 14                                                                                                     
-    RooFitResult* r = 0;
-
-    // make unconditional fit                            
-    poi.setConstant(false);
-    r = pdf.fitTo(data,PrintLevel(-1),Save(),Extended(pdf.canBeExtended()));
-    const double dUncondNLL = r->minNll();
-    delete r; r = 0;
-    
-    // check for mu > mu^hat
-    if(poi.getVal() > dMuTest)
-    {
-      return 0.0;
-    }
-    // do conditional fit
-    else
-    {                        
-      poi.setVal(dMuTest);
-      poi.setConstant(true);
-      r = pdf.fitTo(data,PrintLevel(-1),Save(),Extended(pdf.canBeExtended()));
-      const double dCondNLL = r->minNll();
-      delete r; r = 0;
-      poi.setConstant(false);
-
-      return 2 * (dCondNLL - dUncondNLL);
-    }
+    // message levels of RooFit and RooStats are process wide and only set once (for all sessions)
+    std::once_flag gQuietOnce;
   }
 
-  double GetSigma(RooAbsData& data,ModelConfig& mc,double dMuTest)
+  double EvaluateQMu(RooAbsData& data,RooAbsPdf& pdf,RooRealVar& poi,double dMuTest)
   {
-    RooAbsPdf* pPDF = mc.GetPdf();
-    assert(pPDF);
+    LikelihoodContext context(data,pdf,RooArgSet(poi));
+    return context.EvaluateQMu(dMuTest);
+  }
 
-    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
-    assert(pPOI);
+  NegativePOIRange::NegativePOIRange(RooRealVar& poi):
+    m_poi(poi),
+    m_dOldMin(poi.getMin())
+  {
+    if(m_dOldMin >= 0)
+      m_poi.setMin(-1 * m_poi.getMax());
+  }
 
-    // store global observables                                                                                                                  
-    const RooArgSet* pGlobalObservables = mc.GetGlobalObservables();  
-    RooArgSet* allVars = pPDF->getVariables();
-    RooArgSet globObs;
-    if(pGlobalObservables)
-      pGlobalObservables->snapshot(globObs);
-
-    // build Asimov dataset and set global observables                                                                                           
-    RooArgSet globs;
-    pPOI->setVal(dMuTest);
-    RooAbsData* pAsimovData = AsymptoticCalculator::MakeAsimovData(data,mc,*pPOI,globs);
-    *allVars = globs;
-  
-    // evaluate q_mu_A for a test value of mu                                                                                                    
-    double dMuEval = std::min(pPOI->getMax(),dMuTest + pPOI->getError());
-    pPOI->setVal(dMuEval);
-
-    // arxiv:1007.1727v3 equation 54                                                                                                             
-    double dSigma = (dMuEval - dMuTest) / sqrt(EvaluateQMu(*pAsimovData,*pPDF,*pPOI,dMuEval));
-
-    delete pAsimovData;
-    assert(dSigma > 0);
-
-    // reset global observables                                                                                                                  
-    *allVars = globObs;
-    delete allVars;
-
-    return dSigma;
+  NegativePOIRange::~NegativePOIRange()
+  {
+    m_poi.setMin(m_dOldMin);
   }
 
   HypoTestInverterResult* GetUpperLimit(RooAbsData& data,
@@ -95,50 +62,84 @@ namespace CG_Statistics
 					double dHigh,
 					double dPrecision,
 					unsigned int iMaxIterations,
-					int iToys)
+					int iToys,
+					unsigned int iWorkers)
   {
-    RooMsgService::instance().setGlobalKillBelow(ERROR);
-    AsymptoticCalculator::SetPrintLevel(-1);
+    CallScope scope;
+    ScopedTimer timer(&PerfCounters::dInversionTime);
+
+    std::call_once(gQuietOnce,[]()
+		   {
+		     RooMsgService::instance().setGlobalKillBelow(ERROR);
+		     AsymptoticCalculator::SetPrintLevel(-1);
+		   });
     
-    // using toys
-    if(iToys > 0)
+    // get PDF
+    RooAbsPdf* pPDF = mc.GetPdf();
+    assert(pPDF);
+    
+    // get parameter of interes
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+    assert(pPOI);
+
+    // make sure POI can go negative
+    NegativePOIRange range(*pPOI);
+
+    // set scan range
+    dLow  = std::max(dLow,pPOI->getMin());
+    dHigh = std::min(dHigh,pPOI->getMax());
+
+    // search for CL(s) = 1 - dConf
+    HypoTestInverterResult* result = new HypoTestInverterResult((iToys > 0) ? "ToyCLs" : "AsymptoticCLs",*pPOI,dConf);
+    result->UseCLs(bUseCLs);
+    unsigned int iIteration = 0;
+    double dRelDiff = 1;
+    double dMuTest, CLsb, CLb, CLs, dSigma, sqrt_q_mu;
+    // NLL and unconditional fit are shared by all iterations
+    // (with toys the unconditional fit only provides the start value: it is a single fit on the observed
+    // data compared to the two fits per toy of each tested point, but usually saves several of these points)
+    LikelihoodContext context(data,*pPDF,RooArgSet(*pPOI));
+
+    // start root finder at asymptotic limit for a Gaussian estimator of the POI:
+    // mu^hat + sigma * Phi^-1(1 - alpha) for CL(s+b) and mu^hat + sigma * Phi^-1(1 - alpha * Phi(mu^hat/sigma)) for CL(s)
+    RootFinder finder(1 - dConf,dLow,dHigh);
+    const double dMuHat = context.GetMuHat();
+    const double dMuHatError = context.GetMuHatError();
+    if(dMuHatError > 0)
     {
-      return 0;
+      const double dAlpha = (1 - dConf) * (bUseCLs ? ROOT::Math::normal_cdf(dMuHat/dMuHatError,1) : 1);
+      finder.SetStartValues(dMuHat + dMuHatError * ROOT::Math::normal_quantile(1 - dAlpha,1),dMuHatError);
     }
-    // using asymptotic formulae
-    else
+    do
     {
-      // get PDF
-      RooAbsPdf* pPDF = mc.GetPdf();
-      assert(pPDF);
-    
-      // get parameter of interes
-      RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
-      assert(pPOI);
-
-      // make sure POI can go negative
-      double dOldMin = pPOI->getMin();
-      if(dOldMin >= 0)
-	pPOI->setMin(-1 * pPOI->getMax());
-
-      // set scan range
-      dLow  = std::max(dLow,pPOI->getMin());
-      dHigh = std::min(dHigh,pPOI->getMax());
-
-      // run bi-section to find CLs upper limit
-      HypoTestInverterResult* result = new HypoTestInverterResult("AsymptoticCLs",*pPOI,dConf);
-      result->UseCLs(bUseCLs);
-      unsigned int iIteration = 0;
-      double dRelDiff = 1;
-      double dMuTest, CLsb, CLb, dSigma, sqrt_q_mu;
-      do
+      ++iIteration;
+      // set new tested value
+      dMuTest = finder.GetNextPoint();
+
+      // using toys
+      if(iToys > 0)
       {
-	++iIteration;
-	// set new tested value
-	dMuTest = 0.5 * (dLow + dHigh);
+	// sampling distributions of q_mu for s+b (mu = dMuTest) and b-only (mu = 0) hypotheses
+	HypoTestResult* pToyResult = RunToyHypoTest(data,mc,dMuTest,0,eONESIDED,iToys,bUseCLs ? iToys : 0,iWorkers);
+	if(!pToyResult)
+	{
+	  if(iVERBOSITY >= eERROR)
+	    std::cerr << "all workers failed to generate toys for " << pPOI->GetName() << " = " << dMuTest << std::endl;
+	  delete result;
+	  return 0;
+	}
 
+	CLsb = pToyResult->CLsplusb();
+	CLb = bUseCLs ? pToyResult->CLb() : 1.0;
+
+	result->Add(dMuTest,*pToyResult);
+	delete pToyResult;
+      }
+      // using asymptotic formulae
+      else
+      {
 	// getr sqrt(q_mu)
-	sqrt_q_mu = sqrt(EvaluateQMu(data,*pPDF,*pPOI,dMuTest));
+	sqrt_q_mu = sqrt(context.EvaluateQMu(dMuTest));
 
 	// get CL(s+b) according to arxiv:1007.1727v3 equation 59
 	CLsb = ROOT::Math::normal_cdf_c(sqrt_q_mu,1);
@@ -146,9 +147,16 @@ namespace CG_Statistics
 	// apply correction for CL(s)
 	if(bUseCLs)
 	{
-	  // get sigma(mu^prime) at mu^prime = 0
-	  dSigma = GetSigma(data,mc,0);
-  
+	  // get sigma(mu^prime) at mu^prime = 0 (Asimov dataset and fits are only done once)
+	  dSigma = AsimovCache::Instance().GetSigma(data,mc,0);
+	  if(!IsValidSigma(dSigma))
+	  {
+	    if(iVERBOSITY >= eERROR)
+	      std::cerr << "CL(s) limit needs sigma(" << pPOI->GetName() << ") of the Asimov dataset but got " << dSigma << std::endl;
+	    delete result;
+	    return 0;
+	  }
+
 	  // get CL(b) according to arxiv:1007.1727v3 equation 57 with mu^prime = 0
 	  CLb = ROOT::Math::normal_cdf_c(sqrt_q_mu - dMuTest/dSigma,1);
 	  assert(CLb > 0);
@@ -156,27 +164,31 @@ namespace CG_Statistics
 	else
 	  CLb = 1.0;
 
-	if(CLsb/CLb > 1 - dConf)
-	  dLow = dMuTest;
-	else
-	  dHigh = dMuTest;
-
-	dRelDiff = fabs(1 - dConf - CLsb/CLb) / (1 - dConf);
-
-	if(iVERBOSITY >= eINFO)
-	  std::cout << pPOI->GetName() << " = " << dMuTest << ": CL(s+b) = " << CLsb << " and CL(b) = " << CLb << " --> CL(s) = " << CLsb/CLb << std::endl;
-
 	result->Add(dMuTest,HypoTestResult("AsymptoticCLs",CLb,CLsb));
       }
-      while((iIteration < iMaxIterations) && (dRelDiff > dPrecision));
+
+      // CL(b) = 0 can only happen with toys if no b-only toy is compatible with the observation
+      CLs = (CLb > 0) ? CLsb/CLb : 0;
+      finder.AddPoint(dMuTest,CLs);
+
+      dRelDiff = fabs(1 - dConf - CLs) / (1 - dConf);
 
       if(iVERBOSITY >= eINFO)
-	std::cout << "found limit after " << iIteration << " iterations" << std::endl;
-    
-      // reset minimum of POI
-      pPOI->setMin(dOldMin);
+	std::cout << pPOI->GetName() << " = " << dMuTest << ": CL(s+b) = " << CLsb << " and CL(b) = " << CLb << " --> CL(s) = " << CLs << std::endl;
+    }
+    while((iIteration < iMaxIterations) && (dRelDiff > dPrecision));
 
-      return result;
+    if(iVERBOSITY >= eINFO)
+    {
+      std::cout << "found limit after " << iIteration << " iterations";
+      if(iToys > 0)
+	std::cout << " generating " << scope.GetCounters().iToys << " toys in total";
+      std::cout << std::endl;
     }
+    
+    if(iVERBOSITY >= eDEBUG)
+      std::cout << "performed " << context.GetNFits() << " fits on observed data" << std::endl;
+
+    return result;
   }
 }
@@ -0,0 +1,204 @@
+#include <vector>
+
+#include "TMatrixDSym.h"
+#include "Math/IFunction.h"
+#include "Math/Minimizer.h"
+#include "Math/MinimizerOptions.h"
+#include "Math/Factory.h"
+
+#include "RooRealVar.h"
+#include "RooArgList.h"
+#include "RooFitResult.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "GradientMinimizer.h"
+#include "SessionState.h"
+#include "BatchNLL.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // NLL as function of the floating parameters with analytic gradient
+    class NLLGradientFunction : public ROOT::Math::IMultiGradFunction
+    {
+    public:
+      // vIndices: position of each floating parameter in the parameters of the NLL
+      NLLGradientFunction(const BatchNLL& nll,const std::vector<RooRealVar*>& vVars,const std::vector<unsigned int>& vIndices,
+			  unsigned int& iEvaluations):
+	m_nll(nll),
+	m_vVars(vVars),
+	m_vIndices(vIndices),
+	m_vGradient(),
+	m_iEvaluations(iEvaluations)
+      {}
+
+      virtual unsigned int NDim() const {return m_vVars.size();}
+      virtual ROOT::Math::IMultiGradFunction* Clone() const {return new NLLGradientFunction(*this);}
+
+      virtual void Gradient(const double* x,double* grad) const
+      {
+	double f = 0;
+	FdF(x,f,grad);
+      }
+
+      virtual void FdF(const double* x,double& f,double* grad) const
+      {
+	SetValues(x);
+	f = m_nll.EvaluateWithGradient(m_vGradient);
+	for(unsigned int i = 0; i < m_vIndices.size(); ++i)
+	  grad[i] = m_vGradient[m_vIndices[i]];
+	++m_iEvaluations;
+      }
+
+    private:
+      virtual double DoEval(const double* x) const
+      {
+	SetValues(x);
+	++m_iEvaluations;
+	return m_nll.getVal();
+      }
+
+      virtual double DoDerivative(const double* x,unsigned int iCoord) const
+      {
+	std::vector<double> vGradient(NDim());
+	Gradient(x,vGradient.data());
+	return vGradient[iCoord];
+      }
+
+      void SetValues(const double* x) const
+      {
+	for(unsigned int i = 0; i < m_vVars.size(); ++i)
+	  m_vVars[i]->setVal(x[i]);
+      }
+
+      const BatchNLL& m_nll;
+      std::vector<RooRealVar*> m_vVars;
+      std::vector<unsigned int> m_vIndices;
+      mutable std::vector<double> m_vGradient;
+      unsigned int& m_iEvaluations;
+    };
+
+    // fit result filled from a ROOT::Math::Minimizer (the setters of RooFitResult are protected)
+    class GradientFitResult : public RooFitResult
+    {
+    public:
+      GradientFitResult(const RooArgList& constParams,const RooArgList& initParams,const RooArgList& finalParams,
+			double dMinNLL,double dEDM,int iStatus,int iCovQual):
+	RooFitResult("fitresult","fit with analytic gradients")
+      {
+	setConstParList(constParams);
+	setInitParList(initParams);
+	setFinalParList(finalParams);
+	setMinNLL(dMinNLL);
+	setEDM(dEDM);
+	setStatus(iStatus);
+	setCovQual(iCovQual);
+      }
+    };
+  }
+
+  bool UseAnalyticGradients()
+  {
+    return GetSessionState().options.bAnalyticGradients;
+  }
+
+  void SetAnalyticGradients(bool bGradients)
+  {
+    GetSessionState().options.bAnalyticGradients = bGradients;
+  }
+
+  RooFitResult* MinimizeWithGradient(const BatchNLL& nll,bool bHesse,int& iStatus,unsigned int& iEvaluations)
+  {
+    // floating parameters (all parameters are variables or constants, see BatchNLL::HasGradient)
+    const RooArgList& params = nll.GetParameters();
+    std::vector<RooRealVar*> vVars;
+    std::vector<unsigned int> vIndices;
+    RooArgList constParams;
+    RooArgList floatParams;
+    for(int i = 0; i < params.getSize(); ++i)
+    {
+      RooRealVar* var = dynamic_cast<RooRealVar*>(params.at(i));
+      if(!var)
+	continue;
+      if(var->isConstant())
+	constParams.add(*var);
+      else
+      {
+	vVars.push_back(var);
+	vIndices.push_back(i);
+	floatParams.add(*var);
+      }
+    }
+    if(vVars.empty())
+      return 0;
+
+    ROOT::Math::Minimizer* pMinimizer = ROOT::Math::Factory::CreateMinimizer(ROOT::Math::MinimizerOptions::DefaultMinimizerType(),
+									     ROOT::Math::MinimizerOptions::DefaultMinimizerAlgo());
+    if(!pMinimizer)
+      return 0;
+
+    // same settings as RooMinimizer
+    unsigned int iCalls = 0;
+    NLLGradientFunction function(nll,vVars,vIndices,iCalls);
+    pMinimizer->SetPrintLevel(-1);
+    pMinimizer->SetStrategy(ROOT::Math::MinimizerOptions::DefaultStrategy());
+    pMinimizer->SetTolerance(ROOT::Math::MinimizerOptions::DefaultTolerance());
+    pMinimizer->SetErrorDef(nll.defaultErrorLevel());
+    pMinimizer->SetMaxFunctionCalls(500 * vVars.size());
+    pMinimizer->SetMaxIterations(500 * vVars.size());
+    pMinimizer->SetFunction(function);
+    for(unsigned int i = 0; i < vVars.size(); ++i)
+    {
+      RooRealVar* var = vVars[i];
+      double dStep = var->getError();
+      if(dStep <= 0)
+	dStep = (var->hasMin() && var->hasMax()) ? 0.1 * (var->getMax() - var->getMin()) : 1;
+
+      if(var->hasMin() && var->hasMax())
+	pMinimizer->SetLimitedVariable(i,var->GetName(),var->getVal(),dStep,var->getMin(),var->getMax());
+      else if(var->hasMin())
+	pMinimizer->SetLowerLimitedVariable(i,var->GetName(),var->getVal(),dStep,var->getMin());
+      else if(var->hasMax())
+	pMinimizer->SetUpperLimitedVariable(i,var->GetName(),var->getVal(),dStep,var->getMax());
+      else
+	pMinimizer->SetVariable(i,var->GetName(),var->getVal(),dStep);
+    }
+
+    RooArgList* pInitParams = (RooArgList*)floatParams.snapshot();
+    pMinimizer->Minimize();
+    iStatus = pMinimizer->Status();
+    if(bHesse)
+      pMinimizer->Hesse();
+
+    // parameters at the minimum
+    const double* pValues = pMinimizer->X();
+    const double* pErrors = pMinimizer->Errors();
+    for(unsigned int i = 0; i < vVars.size(); ++i)
+    {
+      vVars[i]->setVal(pValues[i]);
+      if(pErrors)
+	vVars[i]->setError(pErrors[i]);
+    }
+
+    RooFitResult* pResult = new GradientFitResult(constParams,*pInitParams,floatParams,pMinimizer->MinValue(),pMinimizer->Edm(),
+						  iStatus,pMinimizer->CovMatrixStatus());
+    if(pMinimizer->CovMatrixStatus() > 0)
+    {
+      TMatrixDSym cov(vVars.size());
+      for(unsigned int i = 0; i < vVars.size(); ++i)
+      {
+	for(unsigned int j = 0; j < vVars.size(); ++j)
+	  cov(i,j) = pMinimizer->CovMatrix(i,j);
+      }
+      pResult->setCovarianceMatrix(cov);
+    }
+    iEvaluations = iCalls;
+
+    delete pInitParams;
+    delete pMinimizer;
+
+    return pResult;
+  }
+}
@@ -0,0 +1,22 @@
+#ifndef CG_GRADIENTMINIMIZER_H
+#define CG_GRADIENTMINIMIZER_H
+
+class RooFitResult;
+
+namespace CG_Statistics
+{
+  class BatchNLL;
+
+  // minimise the NLL with the default minimizer (see ROOT::Math::MinimizerOptions) using its analytic
+  // gradient (see BatchNLL::EvaluateWithGradient) instead of finite differences
+  //
+  // Strategy, tolerance and call limits are the same as for RooMinimizer. The floating parameters are set
+  // to their values at the minimum and their errors are updated. Returns the fit result (caller takes
+  // ownership) or 0 if the minimisation could not be set up (e.g. no floating parameters).
+  RooFitResult* MinimizeWithGradient(const BatchNLL& nll,bool bHesse,int& iStatus,unsigned int& iEvaluations);
+
+  // true if fits should use analytic gradients (see SetAnalyticGradients)
+  bool UseAnalyticGradients();
+}
+
+#endif // CG_GRADIENTMINIMIZER_H
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+
+#include "RooStats/HypoTestResult.h"
+#include "RooStats/HypoTestInverterResult.h"
+#include "RooStats/SamplingDistribution.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "Instrumentation.h"
+#include "SessionState.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // a - b
+    PerfCounters SubtractPerfCounters(const PerfCounters& a,const PerfCounters& b)
+    {
+      PerfCounters diff;
+      diff.iFits = a.iFits - b.iFits;
+      diff.iNLLEvaluations = a.iNLLEvaluations - b.iNLLEvaluations;
+      diff.iToys = a.iToys - b.iToys;
+      diff.iFailedFits = a.iFailedFits - b.iFailedFits;
+      diff.dGenerationTime = a.dGenerationTime - b.dGenerationTime;
+      diff.dUncondFitTime = a.dUncondFitTime - b.dUncondFitTime;
+      diff.dCondFitTime = a.dCondFitTime - b.dCondFitTime;
+      diff.dTestStatTime = a.dTestStatTime - b.dTestStatTime;
+      diff.dInversionTime = a.dInversionTime - b.dInversionTime;
+
+      return diff;
+    }
+  }
+
+  PerfCounters GetProcessPerfCounters()
+  {
+    SessionState& state = GetSessionState();
+    std::lock_guard<std::mutex> lock(state.countersMutex);
+    return state.counters;
+  }
+
+  void AddProcessPerfCounters(const PerfCounters& counters)
+  {
+    SessionState& state = GetSessionState();
+    std::lock_guard<std::mutex> lock(state.countersMutex);
+    AddPerfCounters(state.counters,counters);
+  }
+
+  void SetProcessPerfCounters(const PerfCounters& counters)
+  {
+    SessionState& state = GetSessionState();
+    std::lock_guard<std::mutex> lock(state.countersMutex);
+    state.counters = counters;
+  }
+
+  void AddPerfCounters(PerfCounters& a,const PerfCounters& b)
+  {
+    a.iFits += b.iFits;
+    a.iNLLEvaluations += b.iNLLEvaluations;
+    a.iToys += b.iToys;
+    a.iFailedFits += b.iFailedFits;
+    a.dGenerationTime += b.dGenerationTime;
+    a.dUncondFitTime += b.dUncondFitTime;
+    a.dCondFitTime += b.dCondFitTime;
+    a.dTestStatTime += b.dTestStatTime;
+    a.dInversionTime += b.dInversionTime;
+  }
+
+  namespace
+  {
+    // time of all fits booked so far
+    double GetFitTime(const PerfCounters& counters)
+    {
+      return counters.dUncondFitTime + counters.dCondFitTime + counters.dTestStatTime;
+    }
+  }
+
+  GenerationTimer::GenerationTimer():
+    m_start(std::chrono::steady_clock::now()),
+    m_dFitTime(GetFitTime(GetProcessPerfCounters()))
+  {}
+
+  GenerationTimer::~GenerationTimer()
+  {
+    double dWall = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    double dFitTime = GetFitTime(GetProcessPerfCounters()) - m_dFitTime;
+
+    PerfCounters counters = PerfCounters();
+    counters.dGenerationTime = std::max(dWall - dFitTime,0.);
+    AddProcessPerfCounters(counters);
+  }
+
+  void AddToys(ULong64_t iToys)
+  {
+    PerfCounters counters = PerfCounters();
+    counters.iToys = iToys;
+    AddProcessPerfCounters(counters);
+  }
+
+  void AddToys(const HypoTestResult* pResult)
+  {
+    if(!pResult)
+      return;
+
+    if(pResult->GetNullDistribution())
+      AddToys(pResult->GetNullDistribution()->GetSize());
+    if(pResult->GetAltDistribution())
+      AddToys(pResult->GetAltDistribution()->GetSize());
+  }
+
+  void AddToys(const HypoTestInverterResult* pResult)
+  {
+    if(!pResult)
+      return;
+
+    for(int i = 0; i < pResult->ArraySize(); ++i)
+      AddToys(pResult->GetResult(i));
+  }
+
+  CallScope::CallScope():
+    m_lock(),
+    m_start(GetProcessPerfCounters())
+  {
+    ++GetSessionState().iCallDepth;
+  }
+
+  CallScope::~CallScope()
+  {
+    SessionState& state = GetSessionState();
+    if(--state.iCallDepth == 0)
+    {
+      // Asimov datasets and copies of the model are only reused within one call (see AsimovCache and
+      // ModelClonePool)
+      state.asimovCache.Clear();
+      state.modelClones.Clear();
+
+      std::lock_guard<std::mutex> lock(state.countersMutex);
+      state.lastCall = SubtractPerfCounters(state.counters,m_start);
+    }
+  }
+
+  PerfCounters CallScope::GetCounters() const
+  {
+    return SubtractPerfCounters(GetProcessPerfCounters(),m_start);
+  }
+
+  PerfCounters GetPerfCounters()
+  {
+    return GetProcessPerfCounters();
+  }
+
+  PerfCounters GetLastCallPerfCounters()
+  {
+    SessionState& state = GetSessionState();
+    std::lock_guard<std::mutex> lock(state.countersMutex);
+    return state.lastCall;
+  }
+
+  void ResetPerfCounters()
+  {
+    SessionState& state = GetSessionState();
+    std::lock_guard<std::mutex> lock(state.countersMutex);
+    state.counters = PerfCounters();
+    state.lastCall = PerfCounters();
+  }
+
+  void PrintPerfCounters(const PerfCounters& counters)
+  {
+    std::cout << "fits:               " << counters.iFits << " (" << counters.iFailedFits << " failed)" << std::endl;
+    std::cout << "NLL evaluations:    " << counters.iNLLEvaluations << std::endl;
+    std::cout << "toys:               " << counters.iToys << std::endl;
+    std::cout << "toy generation:     " << counters.dGenerationTime << " s" << std::endl;
+    std::cout << "unconditional fits: " << counters.dUncondFitTime << " s" << std::endl;
+    std::cout << "conditional fits:   " << counters.dCondFitTime << " s" << std::endl;
+    std::cout << "test statistics:    " << counters.dTestStatTime << " s" << std::endl;
+    std::cout << "inversion:          " << counters.dInversionTime << " s" << std::endl;
+  }
+}
@@ -0,0 +1,98 @@
+#ifndef CG_INSTRUMENTATION_H
+#define CG_INSTRUMENTATION_H
+
+#include <chrono>
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "SessionState.h"
+
+namespace RooStats
+{
+  class HypoTestResult;
+  class HypoTestInverterResult;
+}
+
+namespace CG_Statistics
+{
+  // copy of the counters of this process or of the active session
+  PerfCounters GetProcessPerfCounters();
+
+  // add to/replace the counters of this process or of the active session
+  // (all updates of the counters go through these functions which serialise them)
+  void AddProcessPerfCounters(const PerfCounters& counters);
+  void SetProcessPerfCounters(const PerfCounters& counters);
+
+  // a += b
+  void AddPerfCounters(PerfCounters& a,const PerfCounters& b);
+
+  // adds the wall time between construction and destruction to the given timer of the counters
+  class ScopedTimer
+  {
+  public:
+    explicit ScopedTimer(double PerfCounters::* pTimer):
+      m_pTimer(pTimer),
+      m_start(std::chrono::steady_clock::now())
+    {}
+
+    ~ScopedTimer()
+    {
+      PerfCounters counters = PerfCounters();
+      counters.*m_pTimer = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+      AddProcessPerfCounters(counters);
+    }
+
+  private:
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+
+    double PerfCounters::* m_pTimer;
+    std::chrono::steady_clock::time_point m_start;
+  };
+
+  // books the wall time between construction and destruction as toy generation time
+  // (without the time of the fits and test statistic evaluations done in the meantime which are booked separately)
+  class GenerationTimer
+  {
+  public:
+    GenerationTimer();
+    ~GenerationTimer();
+
+  private:
+    GenerationTimer(const GenerationTimer&);
+    GenerationTimer& operator=(const GenerationTimer&);
+
+    std::chrono::steady_clock::time_point m_start;
+    double m_dFitTime;
+  };
+
+  // add number of toys stored in the sampling distributions of the given result(s) to the counters
+  void AddToys(ULong64_t iToys);
+  void AddToys(const RooStats::HypoTestResult* pResult);
+  void AddToys(const RooStats::HypoTestInverterResult* pResult);
+
+  // marks a call to a public function
+  //
+  // The counters accumulated between construction and destruction of the outermost scope are stored as
+  // counters of the last call (nested calls, e.g. from the batch functions, do not count as separate calls).
+  // The end of the outermost scope also clears the Asimov cache and the copies of the model made for workers.
+  // The scope holds the GlobalLock.
+  class CallScope
+  {
+  public:
+    CallScope();
+    ~CallScope();
+
+    // counters accumulated since construction
+    PerfCounters GetCounters() const;
+
+  private:
+    CallScope(const CallScope&);
+    CallScope& operator=(const CallScope&);
+
+    GlobalLock m_lock;
+    PerfCounters m_start;
+  };
+}
+
+#endif // CG_INSTRUMENTATION_H
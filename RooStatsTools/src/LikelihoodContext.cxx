@@ -0,0 +1,253 @@
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "Math/MinimizerOptions.h"
+
+#include "RooAbsData.h"
+#include "RooDataHist.h"
+#include "RooAbsPdf.h"
+#include "RooAbsReal.h"
+#include "RooRealVar.h"
+#include "RooFitResult.h"
+#include "RooMinimizer.h"
+#include "RooLinkedListIter.h"
+using namespace RooFit;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "LikelihoodContext.h"
+#include "BinnedData.h"
+#include "CompiledNLL.h"
+#include "BatchNLL.h"
+#include "GradientMinimizer.h"
+#include "Instrumentation.h"
+
+namespace CG_Statistics
+{
+  LikelihoodContext::LikelihoodContext(RooAbsData& data,RooAbsPdf& pdf,const RooArgSet& pois,bool bHesse):
+    m_pBinnedData(0),
+    m_pNLL(0),
+    m_vPOIs(),
+    m_floatParams(),
+    m_bNLLPOIsConstant(false),
+    m_bHesse(bHesse),
+    m_pUncondPoint(0),
+    m_pUncondFit(0),
+    m_pLastCondFit(0),
+    m_vPoints(),
+    m_iFits(0)
+  {
+    RooLinkedListIter it = pois.iterator();
+    RooRealVar* poi = 0;
+    while((poi = (RooRealVar*)it.Next()))
+    {
+      poi->setConstant(false);
+      m_vPOIs.push_back(poi);
+    }
+    assert(!m_vPOIs.empty());
+
+    // floating parameters define the state of a fitted point
+    RooArgSet* allParams = pdf.getParameters(data);
+    RooArgSet* floatParams = (RooArgSet*)allParams->selectByAttrib("Constant",kFALSE);
+    m_floatParams.add(*floatParams);
+    delete floatParams;
+    delete allParams;
+
+    // binned fast path for large unbinned datasets
+    m_pBinnedData = GetBinnedData(data,pdf);
+
+    // build NLL once and cache constant terms (with floating POIs)
+    RooAbsData& fitData = m_pBinnedData ? (RooAbsData&)*m_pBinnedData : data;
+    if(UseCompiledNLL() && !UseAnalyticGradients())
+      m_pNLL = CompiledNLL::Create(pdf,fitData,pdf.canBeExtended());
+    // analytic gradients are provided by batch NLLs
+    if(!m_pNLL && (UseBatchNLL() || UseAnalyticGradients()))
+      m_pNLL = BatchNLL::Create(pdf,fitData,pdf.canBeExtended());
+    if(!m_pNLL)
+      m_pNLL = pdf.createNLL(fitData,Extended(pdf.canBeExtended()));
+    m_pNLL->constOptimizeTestStatistic(RooAbsArg::Activate,kTRUE);
+  }
+
+  LikelihoodContext::~LikelihoodContext()
+  {
+    for(auto pPoint : m_vPoints)
+      delete pPoint;
+    delete m_pUncondFit;
+    delete m_pLastCondFit;
+    delete m_pNLL;
+    delete m_pBinnedData;
+  }
+
+  void LikelihoodContext::SetPOIsConstant(bool bConstant)
+  {
+    for(auto poi : m_vPOIs)
+      poi->setConstant(bConstant);
+
+    // cached constant terms depend on the set of constant parameters
+    if(bConstant != m_bNLLPOIsConstant)
+    {
+      m_pNLL->constOptimizeTestStatistic(RooAbsArg::ConfigChange,kTRUE);
+      m_bNLLPOIsConstant = bConstant;
+    }
+    // values of constant POIs might have changed
+    else if(bConstant)
+      m_pNLL->constOptimizeTestStatistic(RooAbsArg::ValueChange,kTRUE);
+  }
+
+  int LikelihoodContext::FindClosestPoint(const std::vector<double>& vPOIValues) const
+  {
+    int iClosest = -1;
+    double dMinDist = std::numeric_limits<double>::max();
+    for(unsigned int iPoint = 0; iPoint < m_vPoints.size(); ++iPoint)
+    {
+      double dDist = 0;
+      for(unsigned int iPOI = 0; iPOI < m_vPOIs.size(); ++iPOI)
+      {
+	double dDelta = vPOIValues.at(iPOI) - m_vPoints[iPoint]->vPOIValues.at(iPOI);
+	// measure distances in units of the uncertainty from the unconditional fit
+	double dScale = m_pUncondFit ? m_vPOIs[iPOI]->getError() : 0;
+	if(dScale > 0)
+	  dDelta /= dScale;
+	dDist += dDelta * dDelta;
+      }
+
+      if(dDist < dMinDist)
+      {
+	dMinDist = dDist;
+	iClosest = iPoint;
+      }
+    }
+
+    return iClosest;
+  }
+
+  LikelihoodContext::FitPoint* LikelihoodContext::Minimize(bool bHesse,RooFitResult** ppResult)
+  {
+    ScopedTimer timer(m_bNLLPOIsConstant ? &PerfCounters::dCondFitTime : &PerfCounters::dUncondFitTime);
+
+    int iStatus = 0;
+    unsigned int iEvaluations = 0;
+    RooFitResult* pResult = 0;
+
+    // analytic gradients if supported by the NLL
+    BatchNLL* pBatchNLL = UseAnalyticGradients() ? dynamic_cast<BatchNLL*>(m_pNLL) : 0;
+    if(pBatchNLL && pBatchNLL->HasGradient())
+      pResult = MinimizeWithGradient(*pBatchNLL,bHesse,iStatus,iEvaluations);
+
+    // gradients from finite differences
+    if(!pResult)
+    {
+      RooMinimizer minim(*m_pNLL);
+      minim.setPrintLevel(-1);
+      minim.setPrintEvalErrors(-1);
+      minim.setStrategy(ROOT::Math::MinimizerOptions::DefaultStrategy());
+      iStatus = minim.minimize(ROOT::Math::MinimizerOptions::DefaultMinimizerType().c_str(),
+			       ROOT::Math::MinimizerOptions::DefaultMinimizerAlgo().c_str());
+      if(bHesse)
+	minim.hesse();
+      iEvaluations = minim.evalCounter();
+      pResult = minim.save();
+    }
+    ++m_iFits;
+
+    PerfCounters counters = PerfCounters();
+    counters.iFits = 1;
+    counters.iNLLEvaluations = iEvaluations;
+    if(iStatus != 0)
+    {
+      counters.iFailedFits = 1;
+      if(iVERBOSITY >= eWARNING)
+	std::cout << "minimisation of " << m_pNLL->GetName() << " finished with status " << iStatus << std::endl;
+    }
+    AddProcessPerfCounters(counters);
+
+    delete *ppResult;
+    *ppResult = pResult;
+
+    FitPoint* pPoint = new FitPoint;
+    for(auto poi : m_vPOIs)
+      pPoint->vPOIValues.push_back(poi->getVal());
+    pPoint->dNLL = (*ppResult)->minNll();
+    m_floatParams.snapshot(pPoint->values);
+    m_vPoints.push_back(pPoint);
+
+    return pPoint;
+  }
+
+  double LikelihoodContext::GetUnconditionalNLL()
+  {
+    if(!m_pUncondPoint)
+    {
+      SetPOIsConstant(false);
+      m_pUncondPoint = Minimize(m_bHesse,&m_pUncondFit);
+    }
+
+    return m_pUncondPoint->dNLL;
+  }
+
+  const RooFitResult& LikelihoodContext::GetUnconditionalFit()
+  {
+    GetUnconditionalNLL();
+    return *m_pUncondFit;
+  }
+
+  double LikelihoodContext::GetMuHat(unsigned int iPOI)
+  {
+    GetUnconditionalNLL();
+    return m_pUncondPoint->vPOIValues.at(iPOI);
+  }
+
+  double LikelihoodContext::GetMuHatError(unsigned int iPOI)
+  {
+    GetUnconditionalNLL();
+    RooRealVar* pFitted = (RooRealVar*)m_pUncondFit->floatParsFinal().find(m_vPOIs.at(iPOI)->GetName());
+
+    return pFitted ? pFitted->getError() : 0;
+  }
+
+  double LikelihoodContext::GetConditionalNLL(const std::vector<double>& vPOIValues)
+  {
+    assert(vPOIValues.size() == m_vPOIs.size());
+
+    // warm start from closest point (or return it if it is the requested one)
+    int iClosest = FindClosestPoint(vPOIValues);
+    if(iClosest >= 0)
+    {
+      FitPoint* pClosest = m_vPoints[iClosest];
+      m_floatParams.assignValueOnly(pClosest->values);
+      if((pClosest != m_pUncondPoint) && (pClosest->vPOIValues == vPOIValues))
+	return pClosest->dNLL;
+    }
+
+    for(unsigned int iPOI = 0; iPOI < m_vPOIs.size(); ++iPOI)
+      m_vPOIs[iPOI]->setVal(vPOIValues[iPOI]);
+    SetPOIsConstant(true);
+
+    FitPoint* pPoint = Minimize(false,&m_pLastCondFit);
+    // store requested values (fixed POIs are not changed by the fit)
+    pPoint->vPOIValues = vPOIValues;
+
+    // leave POIs floating
+    for(auto poi : m_vPOIs)
+      poi->setConstant(false);
+
+    return pPoint->dNLL;
+  }
+
+  double LikelihoodContext::EvaluateQMu(double dMuTest)
+  {
+    const double dUncondNLL = GetUnconditionalNLL();
+
+    // check for mu > mu^hat
+    if(GetMuHat() > dMuTest)
+    {
+      m_floatParams.assignValueOnly(m_pUncondPoint->values);
+      return 0.0;
+    }
+    // do conditional fit
+    else
+      return 2 * (GetConditionalNLL(dMuTest) - dUncondNLL);
+  }
+}
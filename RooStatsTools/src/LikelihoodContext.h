@@ -0,0 +1,90 @@
+#ifndef CG_LIKELIHOODCONTEXT_H
+#define CG_LIKELIHOODCONTEXT_H
+
+#include <vector>
+
+#include "RooArgSet.h"
+
+class RooAbsData;
+class RooDataHist;
+class RooAbsPdf;
+class RooAbsReal;
+class RooRealVar;
+class RooFitResult;
+
+namespace CG_Statistics
+{
+  // negative log-likelihood of one dataset with cached fit results
+  //
+  // The NLL (including constant term optimisation) is built once. The unconditional fit with floating POIs
+  // is done once and its minimum, parameter values and covariance matrix are kept. Every conditional fit
+  // (POIs fixed to given values) starts from the parameter values of the closest point in POI space which
+  // has been fitted before. Repeated requests for the same point are answered from the cache. All
+  // minimisations are recorded in the performance counters (see PerfCounters).
+  //
+  // Large unbinned datasets are replaced by a binned copy if requested (see SetBinnedFits).
+  //
+  // The dataset and the pdf have to outlive the context. The constant flags of the parameters (except
+  // for the POIs) must not be changed while the context is in use.
+  class LikelihoodContext
+  {
+  public:
+    // bHesse: run HESSE after the unconditional fit (needed for GetMuHatError)
+    LikelihoodContext(RooAbsData& data,RooAbsPdf& pdf,const RooArgSet& pois,bool bHesse = true);
+    ~LikelihoodContext();
+
+    // minimum of the NLL with floating POIs
+    double GetUnconditionalNLL();
+    // result of the unconditional fit (including covariance matrix)
+    const RooFitResult& GetUnconditionalFit();
+    // best fit value of the i-th POI
+    double GetMuHat(unsigned int iPOI = 0);
+    // uncertainty of best fit value of the i-th POI (from HESSE or MIGRAD if HESSE is disabled)
+    double GetMuHatError(unsigned int iPOI = 0);
+
+    // minimum of the NLL with the POIs fixed to the given values
+    double GetConditionalNLL(const std::vector<double>& vPOIValues);
+    double GetConditionalNLL(double dMu) {return GetConditionalNLL(std::vector<double>(1,dMu));}
+    // result of the last conditional fit (0 if no conditional fit has been done yet)
+    const RooFitResult* GetLastConditionalFit() const {return m_pLastCondFit;}
+
+    // q_mu for the first POI (arxiv:1007.1727v3 equation 14)
+    double EvaluateQMu(double dMuTest);
+
+    // number of minimisations performed
+    unsigned int GetNFits() const {return m_iFits;}
+
+  private:
+    LikelihoodContext(const LikelihoodContext&);
+    LikelihoodContext& operator=(const LikelihoodContext&);
+
+    // fitted point in POI space
+    struct FitPoint
+    {
+      std::vector<double> vPOIValues;   // values of POIs
+      double dNLL;                      // minimum of NLL
+      RooArgSet values;                 // values of floating parameters at minimum
+    };
+
+    // fix/release POIs and update constant term optimisation of NLL if needed
+    void SetPOIsConstant(bool bConstant);
+    // index of closest fitted point (-1 if none)
+    int FindClosestPoint(const std::vector<double>& vPOIValues) const;
+    // run minimisation and store point
+    FitPoint* Minimize(bool bHesse,RooFitResult** ppResult);
+
+    RooDataHist* m_pBinnedData;
+    RooAbsReal* m_pNLL;
+    std::vector<RooRealVar*> m_vPOIs;
+    RooArgSet m_floatParams;
+    bool m_bNLLPOIsConstant;
+    bool m_bHesse;
+    FitPoint* m_pUncondPoint;
+    RooFitResult* m_pUncondFit;
+    RooFitResult* m_pLastCondFit;
+    std::vector<FitPoint*> m_vPoints;
+    unsigned int m_iFits;
+  };
+}
+
+#endif // CG_LIKELIHOODCONTEXT_H
@@ -0,0 +1,128 @@
+#include <cassert>
+
+#include "RooWorkspace.h"
+#include "RooAbsPdf.h"
+#include "RooRealVar.h"
+#include "RooArgSet.h"
+#include "RooLinkedListIter.h"
+using namespace RooFit;
+
+#include "RooStats/ModelConfig.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "ModelClone.h"
+#include "Fingerprint.h"
+#include "SessionState.h"
+
+namespace CG_Statistics
+{
+  ModelClone::ModelClone(const ModelConfig& mc):
+    m_pWS(0),
+    m_pModel(0)
+  {
+    assert(mc.GetWS());
+    assert(mc.GetPdf());
+
+    // deep copy of all objects in the workspace
+    m_pWS = new RooWorkspace(*mc.GetWS());
+
+    // set up equivalent model configuration (sets are resolved by name in the copied workspace)
+    m_pModel = new ModelConfig(mc.GetName(),m_pWS);
+    m_pModel->SetPdf(mc.GetPdf()->GetName());
+    if(mc.GetObservables())
+      m_pModel->SetObservables(*mc.GetObservables());
+    if(mc.GetParametersOfInterest())
+      m_pModel->SetParametersOfInterest(*mc.GetParametersOfInterest());
+    if(mc.GetNuisanceParameters())
+      m_pModel->SetNuisanceParameters(*mc.GetNuisanceParameters());
+    if(mc.GetGlobalObservables())
+      m_pModel->SetGlobalObservables(*mc.GetGlobalObservables());
+    if(mc.GetConditionalObservables())
+      m_pModel->SetConditionalObservables(*mc.GetConditionalObservables());
+
+    // copy snapshot (ModelConfig::GetSnapshot loads it into the workspace, so restore current values afterwards)
+    RooArgSet* allVars = mc.GetPdf()->getVariables();
+    RooArgSet currentValues;
+    allVars->snapshot(currentValues);
+    const RooArgSet* pSnapshot = mc.GetSnapshot();
+    if(pSnapshot)
+      m_pModel->SetSnapshot(*pSnapshot);
+    *allVars = currentValues;
+    delete allVars;
+  }
+
+  ModelClone::~ModelClone()
+  {
+    delete m_pModel;
+    delete m_pWS;
+  }
+
+  RooRealVar* ModelClone::GetPOI() const
+  {
+    return (RooRealVar*)m_pModel->GetParametersOfInterest()->first();
+  }
+
+  void ModelClone::Update(const ModelConfig& mc)
+  {
+    RooArgSet origVars(mc.GetWS()->allVars());
+    RooArgSet copiedVars(m_pWS->allVars());
+    RooLinkedListIter it = origVars.iterator();
+    RooRealVar* pOrig = 0;
+    while((pOrig = (RooRealVar*)it.Next()))
+    {
+      RooRealVar* pCopy = (RooRealVar*)copiedVars.find(pOrig->GetName());
+      if(!pCopy)
+	continue;
+
+      // range first (values are clipped to it)
+      pCopy->setRange(pOrig->getMin(),pOrig->getMax());
+      pCopy->setVal(pOrig->getVal());
+      pCopy->setError(pOrig->getError());
+      pCopy->setConstant(pOrig->isConstant());
+    }
+
+    RooArgSet copiedCats(m_pWS->allCats());
+    copiedCats.assignValueOnly(mc.GetWS()->allCats());
+  }
+
+  void ModelClonePool::Prepare(const ModelConfig& mc,unsigned int iWorkers)
+  {
+    const ULong64_t iKey = HashCombine((ULong64_t)&mc,GetPdfHash(*mc.GetPdf()));
+    if(iKey != m_iKey)
+    {
+      Clear();
+      m_iKey = iKey;
+    }
+
+    while(m_vClones.size() < iWorkers)
+      m_vClones.push_back(new ModelClone(mc));
+  }
+
+  ModelClone& ModelClonePool::Get(const ModelConfig& mc,unsigned int iWorker)
+  {
+    Prepare(mc,iWorker + 1);
+    ModelClone& clone = *m_vClones[iWorker];
+    clone.Update(mc);
+
+    return clone;
+  }
+
+  void ModelClonePool::Clear()
+  {
+    for(auto pClone : m_vClones)
+      delete pClone;
+    m_vClones.clear();
+    m_iKey = 0;
+  }
+
+  ModelClone& GetWorkerModel(const ModelConfig& mc,unsigned int iWorker)
+  {
+    return GetSessionState().modelClones.Get(mc,iWorker);
+  }
+
+  void PrepareWorkerModels(const ModelConfig& mc,unsigned int iWorkers)
+  {
+    GetSessionState().modelClones.Prepare(mc,iWorkers);
+  }
+}
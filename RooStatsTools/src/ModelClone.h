@@ -0,0 +1,78 @@
+#ifndef CG_MODELCLONE_H
+#define CG_MODELCLONE_H
+
+#include <vector>
+
+#include "RtypesCore.h"
+
+class RooWorkspace;
+class RooRealVar;
+namespace RooStats
+{
+  class ModelConfig;
+}
+
+namespace CG_Statistics
+{
+  // independent copy of a model definition
+  //
+  // The workspace of the given model is copied together with the current values, ranges and constant
+  // flags of all variables. A new ModelConfig referring to the copied workspace is set up with the
+  // same pdf, parameter sets and snapshot. Changes applied to the clone do not affect the original model.
+  class ModelClone
+  {
+  public:
+    explicit ModelClone(const RooStats::ModelConfig& mc);
+    ~ModelClone();
+
+    RooStats::ModelConfig& GetModel() {return *m_pModel;}
+    RooWorkspace& GetWorkspace() {return *m_pWS;}
+    // first parameter of interest
+    RooRealVar* GetPOI() const;
+
+    // set the values, errors, ranges and constant flags of all variables to those of the given model (the
+    // model this copy was made of)
+    void Update(const RooStats::ModelConfig& mc);
+
+  private:
+    ModelClone(const ModelClone&);
+    ModelClone& operator=(const ModelClone&);
+
+    RooWorkspace* m_pWS;
+    RooStats::ModelConfig* m_pModel;
+  };
+
+  // copies of one model for the workers of repeated parallel tasks (e.g. toy loops)
+  //
+  // The copies are made once per outermost call (the pool is cleared at its end, see CallScope) instead of
+  // once per task and updated to the current state of the model on each use (see ModelClone::Update).
+  // Copies made before forking the workers are inherited by them, so forked workers do not copy the
+  // workspace either. Requesting the copy of another model replaces all copies.
+  class ModelClonePool
+  {
+  public:
+    ModelClonePool(): m_iKey(0), m_vClones() {}
+    ~ModelClonePool() {Clear();}
+
+    // make copies of the model for the workers 0 ... iWorkers - 1 (if they do not exist yet)
+    void Prepare(const RooStats::ModelConfig& mc,unsigned int iWorkers);
+    // copy of the model for the given worker (updated to the current state of the model)
+    ModelClone& Get(const RooStats::ModelConfig& mc,unsigned int iWorker);
+    // delete all copies
+    void Clear();
+
+  private:
+    ModelClonePool(const ModelClonePool&);
+    ModelClonePool& operator=(const ModelClonePool&);
+
+    ULong64_t m_iKey;                   // model of the copies (address and structure, see GetPdfHash)
+    std::vector<ModelClone*> m_vClones;
+  };
+
+  // copy of the model for the given worker from the pool of the active session (see ModelClonePool)
+  ModelClone& GetWorkerModel(const RooStats::ModelConfig& mc,unsigned int iWorker);
+  // make the copies of the model for iWorkers workers before forking them (see ModelClonePool)
+  void PrepareWorkerModels(const RooStats::ModelConfig& mc,unsigned int iWorkers);
+}
+
+#endif // CG_MODELCLONE_H
@@ -0,0 +1,217 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "TString.h"
+
+#include "RooAbsData.h"
+#include "RooAbsPdf.h"
+#include "RooAddPdf.h"
+#include "RooGaussian.h"
+#include "RooExponential.h"
+#include "RooPolynomial.h"
+#include "RooRealProxy.h"
+#include "RooListProxy.h"
+#include "RooRealVar.h"
+#include "RooArgSet.h"
+#include "RooArgList.h"
+using namespace RooFit;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "NLLTranslator.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // proxies of the servers (the servers themselves are not ordered if a parameter is used twice)
+    struct GaussianAccess : public RooGaussian
+    {
+      static const RooRealProxy& X(const RooGaussian& pdf) {return pdf.*(&GaussianAccess::x);}
+      static const RooRealProxy& Mean(const RooGaussian& pdf) {return pdf.*(&GaussianAccess::mean);}
+      static const RooRealProxy& Sigma(const RooGaussian& pdf) {return pdf.*(&GaussianAccess::sigma);}
+    };
+
+    struct ExponentialAccess : public RooExponential
+    {
+      static const RooRealProxy& X(const RooExponential& pdf) {return pdf.*(&ExponentialAccess::x);}
+      static const RooRealProxy& Slope(const RooExponential& pdf) {return pdf.*(&ExponentialAccess::c);}
+    };
+
+    // RooPolynomial has no getters for its coefficients and lowest order
+    struct PolynomialAccess : public RooPolynomial
+    {
+      static const RooRealProxy& X(const RooPolynomial& pdf) {return pdf.*(&PolynomialAccess::_x);}
+      static const RooListProxy& Coefs(const RooPolynomial& pdf) {return pdf.*(&PolynomialAccess::_coefList);}
+      static int LowestOrder(const RooPolynomial& pdf) {return pdf.*(&PolynomialAccess::_lowestOrder);}
+    };
+  }
+
+  double GaussianIntegral(double dMean,double dSigma,double a,double b)
+  {
+    return sqrt(M_PI / 2) * dSigma * (erf((b - dMean) / (sqrt(2.) * dSigma)) - erf((a - dMean) / (sqrt(2.) * dSigma)));
+  }
+
+  double ExponentialIntegral(double c,double a,double b)
+  {
+    return (c == 0) ? (b - a) : (exp(c * b) - exp(c * a)) / c;
+  }
+
+  const char* const sIntegralDeclarations =
+    "namespace CG_Statistics\n{\n"
+    "  double GaussianIntegral(double dMean,double dSigma,double a,double b);\n"
+    "  double ExponentialIntegral(double c,double a,double b);\n"
+    "}\n";
+
+  PdfTranslator::PdfTranslator(const RooRealVar& obs):
+    m_obs(obs),
+    m_sStructure()
+  {}
+
+  bool PdfTranslator::IsObservable(const RooAbsArg& arg) const
+  {
+    return !strcmp(arg.GetName(),m_obs.GetName());
+  }
+
+  bool PdfTranslator::IsParameter(const RooAbsArg& arg)
+  {
+    if(!dynamic_cast<const RooAbsReal*>(&arg) || arg.dependsOn(m_obs))
+      return false;
+
+    m_sStructure += std::string(arg.GetName()) + ",";
+    return true;
+  }
+
+  bool PdfTranslator::Translate(const RooAbsPdf& pdf)
+  {
+    if(dynamic_cast<const RooGaussian*>(&pdf))
+    {
+      const RooGaussian& gauss = (const RooGaussian&)pdf;
+      const RooAbsReal& mean = GaussianAccess::Mean(gauss).arg();
+      const RooAbsReal& sigma = GaussianAccess::Sigma(gauss).arg();
+      m_sStructure += "gauss(";
+      if(!IsObservable(GaussianAccess::X(gauss).arg()) || !IsParameter(mean) || !IsParameter(sigma) || !AddGaussian(mean,sigma))
+	return false;
+    }
+    else if(dynamic_cast<const RooExponential*>(&pdf))
+    {
+      const RooExponential& expo = (const RooExponential&)pdf;
+      const RooAbsReal& c = ExponentialAccess::Slope(expo).arg();
+      m_sStructure += "exp(";
+      if(!IsObservable(ExponentialAccess::X(expo).arg()) || !IsParameter(c) || !AddExponential(c))
+	return false;
+    }
+    else if(dynamic_cast<const RooPolynomial*>(&pdf))
+    {
+      // only 1 + c_0 x + c_1 x^2 + ... (other lowest orders drop the constant or the linear term)
+      const RooPolynomial& poly = (const RooPolynomial&)pdf;
+      const RooArgList& coefs = PolynomialAccess::Coefs(poly);
+      const int iLowestOrder = PolynomialAccess::LowestOrder(poly);
+      m_sStructure += TString::Format("poly%d(",iLowestOrder).Data();
+      if((iLowestOrder != 1) || !IsObservable(PolynomialAccess::X(poly).arg()))
+	return false;
+      for(int i = 0; i < coefs.getSize(); ++i)
+      {
+	if(!IsParameter(*coefs.at(i)))
+	  return false;
+      }
+      if(!AddPolynomial(coefs))
+	return false;
+    }
+    else if(dynamic_cast<const RooAddPdf*>(&pdf))
+    {
+      const RooAddPdf& add = (const RooAddPdf&)pdf;
+      const RooArgList& pdfs = add.pdfList();
+      const RooArgList& coefs = add.coefList();
+      const bool bYields = (coefs.getSize() == pdfs.getSize());
+      if(!bYields && (coefs.getSize() != pdfs.getSize() - 1))
+	return false;
+
+      m_sStructure += bYields ? "sumN(" : "sumf(";
+      for(int i = 0; i < pdfs.getSize(); ++i)
+      {
+	if(!Translate((const RooAbsPdf&)*pdfs.at(i)))
+	  return false;
+      }
+      for(int i = 0; i < coefs.getSize(); ++i)
+      {
+	if(!IsParameter(*coefs.at(i)))
+	  return false;
+      }
+      if(!AddSum(coefs,bYields,pdfs.getSize()))
+	return false;
+    }
+    else
+      return false;
+
+    m_sStructure += ")";
+
+    return true;
+  }
+
+  bool PdfTranslator::TranslateConstraint(const RooAbsPdf& constraint,const RooAbsPdf& pdf)
+  {
+    if(!dynamic_cast<const RooGaussian*>(&constraint) || constraint.dependsOn(m_obs))
+      return false;
+
+    const RooGaussian& gauss = (const RooGaussian&)constraint;
+    const RooAbsReal& x = GaussianAccess::X(gauss).arg();
+    const RooAbsReal& mean = GaussianAccess::Mean(gauss).arg();
+    const RooAbsReal& sigma = GaussianAccess::Sigma(gauss).arg();
+    const bool bX = pdf.dependsOn(x);
+    const bool bMean = pdf.dependsOn(mean);
+    if(!bX && !bMean)
+      return true;
+
+    // Gaussian is symmetric in observable and mean
+    const RooAbsReal& param = bX ? x : mean;
+    const RooAbsReal& value = bX ? mean : x;
+    if((bX && bMean) || !dynamic_cast<const RooRealVar*>(&param) || pdf.dependsOn(sigma))
+      return false;
+
+    m_sStructure += "constr(";
+    if(!IsParameter(param) || !IsParameter(value) || !IsParameter(sigma) || !AddConstraint((const RooRealVar&)param,value,sigma))
+      return false;
+    m_sStructure += ")";
+
+    return true;
+  }
+
+  RooRealVar* GetSingleObservable(const RooAbsPdf& pdf,const RooAbsData& data)
+  {
+    RooArgSet* pObs = pdf.getObservables(data);
+    RooRealVar* pX = (pObs->getSize() == 1) ? dynamic_cast<RooRealVar*>(pObs->first()) : 0;
+    delete pObs;
+
+    return (pX && pX->hasMin() && pX->hasMax()) ? pX : 0;
+  }
+
+  void GetObservableValues(RooAbsData& data,const RooRealVar& obs,std::vector<double>& vX,std::vector<double>& vW)
+  {
+    vX.clear();
+    vW.clear();
+    vX.reserve(data.numEntries());
+    vW.reserve(data.numEntries());
+    for(int i = 0; i < data.numEntries(); ++i)
+    {
+      vX.push_back(data.get(i)->getRealValue(obs.GetName()));
+      vW.push_back(data.weight());
+    }
+  }
+
+  bool CheckNLL(RooAbsReal& nll,RooAbsPdf& pdf,RooAbsData& data,bool bExtended,const char* sType)
+  {
+    RooAbsReal* pRefNLL = pdf.createNLL(data,Extended(bExtended));
+    const double dRef = pRefNLL->getVal();
+    const double dValue = nll.getVal();
+    delete pRefNLL;
+
+    const bool bPassed = (fabs(dValue - dRef) <= 1e-8 * (1 + fabs(dRef)));
+    if(!bPassed && (iVERBOSITY >= eWARNING))
+      std::cout << sType << " NLL of " << pdf.GetName() << " differs from RooFit NLL (" << dValue << " vs " << dRef
+		<< ") -> use RooFit NLL" << std::endl;
+
+    return bPassed;
+  }
+}
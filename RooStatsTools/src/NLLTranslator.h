@@ -0,0 +1,75 @@
+#ifndef CG_NLLTRANSLATOR_H
+#define CG_NLLTRANSLATOR_H
+
+#include <string>
+#include <vector>
+
+class RooAbsArg;
+class RooAbsData;
+class RooAbsPdf;
+class RooAbsReal;
+class RooArgList;
+class RooRealVar;
+
+namespace CG_Statistics
+{
+  // normalisation integrals over [a,b] of exp(-0.5 ((x - mean)/sigma)^2) and exp(c x)
+  double GaussianIntegral(double dMean,double dSigma,double a,double b);
+  double ExponentialIntegral(double c,double a,double b);
+  // declarations of the integrals for code compiled at runtime
+  extern const char* const sIntegralDeclarations;
+
+  // translation of a pdf of one real valued observable into a specialised NLL (see CompiledNLL and BatchNLL)
+  //
+  // Supported are RooGaussian, RooExponential, RooPolynomial (lowest order 1) and RooAddPdf sums of them
+  // (with yields or fractions as coefficients) whose parameters are real valued functions not depending on
+  // the observable. Components are passed to the implementation before the sums containing them.
+  class PdfTranslator
+  {
+  public:
+    explicit PdfTranslator(const RooRealVar& obs);
+    virtual ~PdfTranslator() {}
+
+    // translate the pdf and its components (false if a component is not supported)
+    bool Translate(const RooAbsPdf& pdf);
+    // translate a RooGaussian constraint term of the translated pdf (false if not supported)
+    //
+    // One of its observable and mean must be a variable of the pdf (the constrained parameter) and the other
+    // one must not be used by the pdf (the global observable). Terms not constraining any parameter of the
+    // pdf are skipped as by RooAbsPdf::createNLL.
+    bool TranslateConstraint(const RooAbsPdf& constraint,const RooAbsPdf& pdf);
+
+    // types and parameter names of all translated components (key of the cross-check)
+    const std::string& GetStructure() const {return m_sStructure;}
+
+  protected:
+    // components in the order of translation (false if not supported by the implementation)
+    virtual bool AddGaussian(const RooAbsReal& mean,const RooAbsReal& sigma) = 0;
+    virtual bool AddExponential(const RooAbsReal& c) = 0;
+    // 1 + c_0 x + c_1 x^2 + ...
+    virtual bool AddPolynomial(const RooArgList& coefs) = 0;
+    // sum of the iComponents components translated last (one coefficient less than components for fractions)
+    virtual bool AddSum(const RooArgList& coefs,bool bYields,unsigned int iComponents) = 0;
+    // -log of the Gaussian of value around param normalised over the range of param
+    virtual bool AddConstraint(const RooRealVar&,const RooAbsReal&,const RooAbsReal&) {return false;}
+
+    const RooRealVar& m_obs;
+
+  private:
+    bool IsObservable(const RooAbsArg& arg) const;
+    bool IsParameter(const RooAbsArg& arg);
+
+    std::string m_sStructure;
+  };
+
+  // the only observable of the pdf in the dataset if it is real valued with a finite range (0 otherwise)
+  RooRealVar* GetSingleObservable(const RooAbsPdf& pdf,const RooAbsData& data);
+
+  // contiguous values of the observable and weights of all entries of the dataset
+  void GetObservableValues(RooAbsData& data,const RooRealVar& obs,std::vector<double>& vX,std::vector<double>& vW);
+
+  // compare the NLL with the RooFit NLL of the pdf (prints a warning naming sType if they differ)
+  bool CheckNLL(RooAbsReal& nll,RooAbsPdf& pdf,RooAbsData& data,bool bExtended,const char* sType);
+}
+
+#endif // CG_NLLTRANSLATOR_H
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "Math/ProbFunc.h"
+#include "Math/QuantFuncMathCore.h"
+
+// custom include(s)
+#include "RootFinder.h"
+
+namespace CG_Statistics
+{
+  RootFinder::RootFinder(double dTarget,
+			 double dLow,
+			 double dHigh,
+			 METHOD eMethod,
+			 bool bDecreasing):
+    m_dTarget(dTarget),
+    m_dLow(dLow),
+    m_dHigh(dHigh),
+    m_eMethod(eMethod),
+    m_bDecreasing(bDecreasing),
+    m_bHasStart(false),
+    m_dGuess(0),
+    m_dScale(0),
+    m_vPoints(),
+    m_vWidths()
+  {
+    assert(dLow < dHigh);
+    assert((dTarget > 0) && (dTarget < 1));
+  }
+
+  void RootFinder::SetStartValues(double dGuess,double dScale)
+  {
+    // ignore useless start values (e.g. from failed fits)
+    if(!std::isfinite(dGuess) || !std::isfinite(dScale) || (dScale <= 0))
+      return;
+
+    m_bHasStart = true;
+    m_dGuess = std::min(std::max(dGuess,m_dLow),m_dHigh);
+    m_dScale = dScale;
+  }
+
+  double RootFinder::Transform(double dPValue) const
+  {
+    // avoid infinities for p-values of 0 or 1 (e.g. from toys)
+    const double dEpsilon = 1e-12;
+    dPValue = std::min(std::max(dPValue,dEpsilon),1 - dEpsilon);
+
+    return ROOT::Math::normal_quantile(dPValue,1) - ROOT::Math::normal_quantile(m_dTarget,1);
+  }
+
+  void RootFinder::AddPoint(double x,double dPValue)
+  {
+    const double f = Transform(dPValue);
+    auto it = std::lower_bound(m_vPoints.begin(),m_vPoints.end(),std::make_pair(x,-HUGE_VAL));
+    if((it != m_vPoints.end()) && (it->first == x))
+      it->second = f;
+    else
+      m_vPoints.insert(it,std::make_pair(x,f));
+
+    m_vWidths.push_back(GetBracketWidth());
+  }
+
+  bool RootFinder::FindBracket(unsigned int& iLow,unsigned int& iHigh) const
+  {
+    for(unsigned int i = 0; i + 1 < m_vPoints.size(); ++i)
+    {
+      if(m_vPoints[i].second * m_vPoints[i+1].second <= 0)
+      {
+	iLow = i;
+	iHigh = i + 1;
+	return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool RootFinder::IsBracketed() const
+  {
+    unsigned int iLow, iHigh;
+    return FindBracket(iLow,iHigh);
+  }
+
+  double RootFinder::GetBracketWidth() const
+  {
+    unsigned int iLow, iHigh;
+    if(FindBracket(iLow,iHigh))
+      return m_vPoints[iHigh].first - m_vPoints[iLow].first;
+
+    return m_dHigh - m_dLow;
+  }
+
+  double RootFinder::Extrapolate() const
+  {
+    // bisection of the part of the range which can still contain the root
+    if(m_eMethod == eBISECTION)
+    {
+      double dLow = m_dLow;
+      double dHigh = m_dHigh;
+      for(auto& point : m_vPoints)
+      {
+	// point lies left of the root
+	if((point.second > 0) == m_bDecreasing)
+	  dLow = std::max(dLow,point.first);
+	else
+	  dHigh = std::min(dHigh,point.first);
+      }
+
+      return 0.5 * (dLow + dHigh);
+    }
+
+    // all points are on the same side of the root
+    const bool bRight = ((m_vPoints.front().second > 0) == m_bDecreasing);
+    const unsigned int iEdge = bRight ? m_vPoints.size() - 1 : 0;
+    const double xEdge = m_vPoints[iEdge].first;
+    const double fEdge = m_vPoints[iEdge].second;
+
+    double dStep = m_bHasStart ? m_dScale : 0.25 * (m_dHigh - m_dLow);
+    if(m_vPoints.size() > 1)
+    {
+      const unsigned int iNext = bRight ? iEdge - 1 : iEdge + 1;
+      const double dDist = fabs(xEdge - m_vPoints[iNext].first);
+      const double dSlope = (fEdge - m_vPoints[iNext].second) / (xEdge - m_vPoints[iNext].first);
+
+      // at least double the previous step unless the secant points closer
+      dStep = std::max(dStep,2 * dDist);
+      if(dSlope * fEdge * (bRight ? 1 : -1) < 0)
+	dStep = std::min(1.2 * fabs(fEdge / dSlope),4 * dStep);
+    }
+
+    double x = xEdge + (bRight ? dStep : -dStep);
+    return std::min(std::max(x,m_dLow),m_dHigh);
+  }
+
+  double RootFinder::Interpolate(unsigned int iLow,unsigned int iHigh) const
+  {
+    const double a = m_vPoints[iLow].first;
+    const double fa = m_vPoints[iLow].second;
+    const double b = m_vPoints[iHigh].first;
+    const double fb = m_vPoints[iHigh].second;
+    const double dBisection = 0.5 * (a + b);
+
+    if(fa == 0)
+      return a;
+    if(fb == 0)
+      return b;
+
+    if(m_eMethod == eBISECTION)
+      return dBisection;
+
+    // interpolation did not halve the bracket within the last two steps
+    const unsigned int n = m_vWidths.size();
+    if((n >= 3) && (m_vWidths[n-1] > 0.5 * m_vWidths[n-3]))
+      return dBisection;
+
+    // secant between bracket points
+    double x = a - fa * (b - a) / (fb - fa);
+
+    // inverse quadratic interpolation including the closest neighbour of the bracket
+    int iThird = -1;
+    if(iLow > 0)
+      iThird = iLow - 1;
+    if((iHigh + 1 < m_vPoints.size()) && ((iThird < 0) || (fabs(m_vPoints[iHigh+1].second) < fabs(m_vPoints[iThird].second))))
+      iThird = iHigh + 1;
+    if(iThird >= 0)
+    {
+      const double c = m_vPoints[iThird].first;
+      const double fc = m_vPoints[iThird].second;
+      if((fc != fa) && (fc != fb))
+      {
+	double xIQI = a * fb * fc / ((fa - fb) * (fa - fc))
+	  + b * fa * fc / ((fb - fa) * (fb - fc))
+	  + c * fa * fb / ((fc - fa) * (fc - fb));
+	if((xIQI > a) && (xIQI < b))
+	  x = xIQI;
+      }
+    }
+
+    // do not test points (almost) identical to the bracket boundaries
+    const double dMargin = 0.02 * (b - a);
+    return std::min(std::max(x,a + dMargin),b - dMargin);
+  }
+
+  double RootFinder::GetNextPoint() const
+  {
+    if(m_vPoints.empty())
+      return (m_bHasStart && (m_eMethod != eBISECTION)) ? m_dGuess : 0.5 * (m_dLow + m_dHigh);
+
+    unsigned int iLow, iHigh;
+    if(FindBracket(iLow,iHigh))
+      return Interpolate(iLow,iHigh);
+
+    return Extrapolate();
+  }
+}
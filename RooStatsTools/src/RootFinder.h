@@ -0,0 +1,73 @@
+#ifndef CG_ROOTFINDER_H
+#define CG_ROOTFINDER_H
+
+#include <vector>
+#include <utility>
+
+namespace CG_Statistics
+{
+  // bracketed root finder for p-value curves p(x) = dTarget
+  //
+  // The finder does not evaluate p(x) itself. It proposes the next point to test (GetNextPoint) and is
+  // fed with the obtained p-values (AddPoint). Interpolation is done in normal_quantile(p) space in which
+  // p-value curves are close to linear:
+  //  - before a bracket is found, it starts at a given guess and steps/extrapolates with growing steps
+  //  - once the root is bracketed, it uses inverse quadratic or secant interpolation (eSECANT) and falls
+  //    back to bisection whenever the interpolation leaves the bracket or does not shrink it fast enough
+  //  - eBISECTION always halves the bracket (starting from the full range)
+  class RootFinder
+  {
+  public:
+    enum METHOD {eBISECTION = 0, eSECANT = 1};
+
+    // bDecreasing: direction of p(x) used before a root has been bracketed
+    RootFinder(double dTarget,
+	       double dLow,
+	       double dHigh,
+	       METHOD eMethod = eSECANT,
+	       bool bDecreasing = true);
+
+    // start search at dGuess with dScale as expected distance to the root (e.g. uncertainty on the POI)
+    void SetStartValues(double dGuess,double dScale);
+
+    // next point to be evaluated
+    double GetNextPoint() const;
+
+    // add evaluated point
+    void AddPoint(double x,double dPValue);
+
+    // true if the root is bracketed by evaluated points
+    bool IsBracketed() const;
+
+    // width of current bracket (range width if not bracketed)
+    double GetBracketWidth() const;
+
+    // number of evaluated points
+    unsigned int GetNPoints() const {return m_vPoints.size();}
+
+  private:
+    // distance to target in normal_quantile space
+    double Transform(double dPValue) const;
+    // find adjacent points with different sign (indices into sorted points, false if none)
+    bool FindBracket(unsigned int& iLow,unsigned int& iHigh) const;
+    // step outside of the evaluated points towards the root
+    double Extrapolate() const;
+    // interpolate within bracket
+    double Interpolate(unsigned int iLow,unsigned int iHigh) const;
+
+    double m_dTarget;
+    double m_dLow;
+    double m_dHigh;
+    METHOD m_eMethod;
+    bool m_bDecreasing;
+    bool m_bHasStart;
+    double m_dGuess;
+    double m_dScale;
+    // evaluated points (x, transformed p-value) sorted in x
+    std::vector<std::pair<double,double> > m_vPoints;
+    // bracket widths after each evaluation
+    std::vector<double> m_vWidths;
+  };
+}
+
+#endif // CG_ROOTFINDER_H
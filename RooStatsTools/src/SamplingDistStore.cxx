@@ -0,0 +1,207 @@
+#include <iostream>
+#include "unistd.h"
+
+#include "TFile.h"
+#include "TNamed.h"
+#include "TString.h"
+
+#include "RooArgSet.h"
+
+#include "RooStats/SamplingDistribution.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "SamplingDistStore.h"
+#include "SessionState.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    TString GetEntryName(ULong64_t iKey)
+    {
+      return TString::Format("sd_%016llx",(unsigned long long)iKey);
+    }
+
+    TString GetSeedsName(ULong64_t iKey)
+    {
+      return TString::Format("seeds_%016llx",(unsigned long long)iKey);
+    }
+  }
+
+  SamplingDistStore::SamplingDistStore():
+    m_sFileName(),
+    m_pFile(0),
+    m_iOwnerPID(-1),
+    m_iFilePID(-1),
+    m_pNuisanceValues(0),
+    m_pending()
+  {
+    m_pending.SetOwner(kTRUE);
+  }
+
+  SamplingDistStore::~SamplingDistStore()
+  {
+    Close();
+  }
+
+  SamplingDistStore& SamplingDistStore::Instance()
+  {
+    return GetSessionState().store;
+  }
+
+  bool SamplingDistStore::Open(const char* sFileName,const RooArgSet* pNuisanceValues)
+  {
+    Close();
+    if(!sFileName || !*sFileName)
+      return true;
+
+    m_sFileName = sFileName;
+    m_iOwnerPID = getpid();
+    if(!GetFile())
+    {
+      if(iVERBOSITY >= eERROR)
+	std::cerr << "failed to open sampling distribution store '" << sFileName << "'" << std::endl;
+      Close();
+      return false;
+    }
+
+    if(pNuisanceValues)
+      m_pNuisanceValues = (RooArgSet*)pNuisanceValues->snapshot();
+
+    return true;
+  }
+
+  void SamplingDistStore::Close()
+  {
+    // a file inherited from the parent process is closed by the parent
+    if(m_pFile && (m_iFilePID == getpid()))
+    {
+      m_pFile->Close();
+      delete m_pFile;
+    }
+    if((m_pending.GetSize() > 0) && (iVERBOSITY >= eWARNING))
+      std::cerr << "discard " << m_pending.GetSize() << " entries not written to sampling distribution store" << std::endl;
+    m_pending.Delete();
+    delete m_pNuisanceValues;
+    m_pNuisanceValues = 0;
+    m_pFile = 0;
+    m_iFilePID = -1;
+    m_iOwnerPID = -1;
+    m_sFileName.clear();
+  }
+
+  TFile* SamplingDistStore::GetFile()
+  {
+    if(m_sFileName.empty())
+      return 0;
+
+    // file handles must not be shared between processes
+    if(m_iFilePID != getpid())
+    {
+      const bool bOwner = (m_iOwnerPID == getpid());
+      m_pFile = TFile::Open(m_sFileName.c_str(),bOwner ? "UPDATE" : "READ");
+      if(m_pFile && m_pFile->IsZombie())
+      {
+	delete m_pFile;
+	m_pFile = 0;
+      }
+      m_iFilePID = getpid();
+    }
+
+    return m_pFile;
+  }
+
+  TObject* SamplingDistStore::GetEntry(const TString& sName)
+  {
+    TObject* pPending = m_pending.FindObject(sName);
+    if(pPending)
+      return pPending->Clone();
+
+    TFile* pFile = GetFile();
+    if(!pFile)
+      return 0;
+
+    return pFile->Get(sName);
+  }
+
+  void SamplingDistStore::PutEntry(TNamed* pEntry)
+  {
+    if(m_iOwnerPID != getpid())
+    {
+      delete m_pending.Remove(m_pending.FindObject(pEntry->GetName()));
+      m_pending.Add(pEntry);
+      return;
+    }
+
+    TFile* pFile = GetFile();
+    if(pFile)
+    {
+      pFile->WriteTObject(pEntry,pEntry->GetName(),"WriteDelete");
+      pFile->Flush();
+    }
+    delete pEntry;
+  }
+
+  SamplingDistribution* SamplingDistStore::Get(ULong64_t iKey)
+  {
+    if(!IsOpen())
+      return 0;
+
+    return dynamic_cast<SamplingDistribution*>(GetEntry(GetEntryName(iKey)));
+  }
+
+  void SamplingDistStore::Put(ULong64_t iKey,const SamplingDistribution& dist,const char* sSeeds)
+  {
+    if(!IsOpen())
+      return;
+
+    PutEntry((SamplingDistribution*)dist.Clone(GetEntryName(iKey)));
+    PutEntry(new TNamed(GetSeedsName(iKey),sSeeds));
+  }
+
+  TString SamplingDistStore::GetSeeds(ULong64_t iKey)
+  {
+    if(!IsOpen())
+      return "";
+
+    TNamed* pSeeds = dynamic_cast<TNamed*>(GetEntry(GetSeedsName(iKey)));
+    TString sSeeds = pSeeds ? pSeeds->GetTitle() : "";
+    delete pSeeds;
+
+    return sSeeds;
+  }
+
+  TList* SamplingDistStore::TakePending()
+  {
+    if(m_pending.GetSize() == 0)
+      return 0;
+
+    TList* pEntries = new TList();
+    pEntries->SetOwner(kTRUE);
+    pEntries->AddAll(&m_pending);
+    m_pending.SetOwner(kFALSE);
+    m_pending.Clear();
+    m_pending.SetOwner(kTRUE);
+
+    return pEntries;
+  }
+
+  void SamplingDistStore::AddPending(const TList& entries)
+  {
+    if(!IsOpen())
+      return;
+
+    TIter next(&entries);
+    while(TObject* pEntry = next())
+      PutEntry((TNamed*)pEntry->Clone());
+  }
+
+  bool SetSamplingDistStore(const char* sFileName,const RooArgSet* pNuisanceValues)
+  {
+    // file I/O of ROOT
+    GlobalLock lock;
+    return SamplingDistStore::Instance().Open(sFileName,pNuisanceValues);
+  }
+}
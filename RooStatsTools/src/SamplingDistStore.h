@@ -0,0 +1,78 @@
+#ifndef CG_SAMPLINGDISTSTORE_H
+#define CG_SAMPLINGDISTSTORE_H
+
+#include <string>
+
+#include "RtypesCore.h"
+#include "TList.h"
+#include "TString.h"
+
+class TFile;
+class RooArgSet;
+namespace RooStats
+{
+  class SamplingDistribution;
+}
+
+namespace CG_Statistics
+{
+  // persistent store of sampling distributions in a ROOT file
+  //
+  // Each distribution is saved under a name derived from its key (e.g. a hash of the model, the test
+  // statistic and the parameter values used for generating the toys) together with the seeds used for
+  // generating its toys. Only the process which opened the store writes to the file. Other processes
+  // (e.g. forked workers) reopen the file read-only on first access and keep their new entries in memory
+  // until they are handed to the parent process (see TakePending and RunWorkers).
+  class SamplingDistStore
+  {
+  public:
+    SamplingDistStore();
+    ~SamplingDistStore();
+
+    // open/create store in the given file (closes previous store, empty name = no store)
+    // pNuisanceValues: fixed values of nuisance parameters for generating toys (0 = profile on observed data)
+    bool Open(const char* sFileName,const RooArgSet* pNuisanceValues = 0);
+    void Close();
+    bool IsOpen() const {return !m_sFileName.empty();}
+
+    // fixed values of the nuisance parameters for generating toys (0 if profiled on observed data)
+    const RooArgSet* GetNuisanceValues() const {return m_pNuisanceValues;}
+
+    // copy of stored distribution (0 if not found, caller takes ownership)
+    RooStats::SamplingDistribution* Get(ULong64_t iKey);
+
+    // store distribution with the seeds used for generating its toys (replaces existing entry)
+    void Put(ULong64_t iKey,const RooStats::SamplingDistribution& dist,const char* sSeeds);
+
+    // seeds of the stored distribution as "seed:toys" separated by blanks (empty if none)
+    TString GetSeeds(ULong64_t iKey);
+
+    // entries not yet written by a process which is not the owner of the store (0 if none, caller takes
+    // ownership) and adding such entries of another process
+    TList* TakePending();
+    void AddPending(const TList& entries);
+
+    // store of the active session (see Session)
+    static SamplingDistStore& Instance();
+
+  private:
+    SamplingDistStore(const SamplingDistStore&);
+    SamplingDistStore& operator=(const SamplingDistStore&);
+
+    // file opened by the current process (0 if the file cannot be opened)
+    TFile* GetFile();
+    // copy of the entry with the given name (pending entries first)
+    TObject* GetEntry(const TString& sName);
+    // write entry (or keep it as pending entry in other processes than the owner, takes ownership)
+    void PutEntry(TNamed* pEntry);
+
+    std::string m_sFileName;
+    TFile* m_pFile;
+    int m_iOwnerPID;
+    int m_iFilePID;
+    RooArgSet* m_pNuisanceValues;
+    TList m_pending;
+  };
+}
+
+#endif // CG_SAMPLINGDISTSTORE_H
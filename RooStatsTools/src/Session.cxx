@@ -0,0 +1,115 @@
+#include <cassert>
+#include <mutex>
+
+#include "TThread.h"
+
+#include "RooWorkspace.h"
+#include "RooAbsData.h"
+using namespace RooFit;
+
+#include "RooStats/ModelConfig.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "SessionState.h"
+#include "ModelClone.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // state of the session active in this thread (0 = state of the process)
+    thread_local SessionState* gpActiveState = 0;
+
+    // held by the outermost GlobalLock of a thread (the depth is inherited by forked workers)
+    std::mutex gGlobalMutex;
+    thread_local unsigned int giLockDepth = 0;
+
+    std::once_flag gThreadsInitialised;
+  }
+
+  SessionState& GetSessionState()
+  {
+    static SessionState processState;
+    return gpActiveState ? *gpActiveState : processState;
+  }
+
+  GlobalLock::GlobalLock():
+    m_ePrevious(eSILENT)
+  {
+    if(giLockDepth++ > 0)
+      return;
+
+    gGlobalMutex.lock();
+    m_ePrevious = iVERBOSITY;
+    const SessionState& state = GetSessionState();
+    if(state.bSession)
+      iVERBOSITY = state.eVerbosity;
+  }
+
+  GlobalLock::~GlobalLock()
+  {
+    if(--giLockDepth > 0)
+      return;
+
+    if(GetSessionState().bSession)
+      iVERBOSITY = m_ePrevious;
+    gGlobalMutex.unlock();
+  }
+
+  Session::Session(const ModelConfig& mc):
+    m_pClone(0),
+    m_pState(new SessionState())
+  {
+    // internal locks of ROOT (e.g. for the interpreter and the type system)
+    std::call_once(gThreadsInitialised,[]() {TThread::Initialize();});
+
+    GlobalLock lock;
+    m_pClone = new ModelClone(mc);
+    m_pState->options = GetSessionState().options;
+    m_pState->bSession = true;
+    m_pState->eVerbosity = iVERBOSITY;
+  }
+
+  Session::~Session()
+  {
+    assert(gpActiveState != m_pState);
+
+    GlobalLock lock;
+    delete m_pState;
+    delete m_pClone;
+  }
+
+  ModelConfig& Session::GetModel()
+  {
+    return m_pClone->GetModel();
+  }
+
+  RooAbsData* Session::GetData(const char* sName)
+  {
+    GlobalLock lock;
+    return m_pClone->GetWorkspace().data(sName);
+  }
+
+  VERBOSITY Session::GetVerbosity() const
+  {
+    return m_pState->eVerbosity;
+  }
+
+  void Session::SetVerbosity(VERBOSITY eVerbosity)
+  {
+    m_pState->eVerbosity = eVerbosity;
+  }
+
+  Session::Scope::Scope(Session& session):
+    m_pPrevious(gpActiveState)
+  {
+    gpActiveState = session.m_pState;
+  }
+
+  Session::Scope::~Scope()
+  {
+    gpActiveState = m_pPrevious;
+  }
+}
@@ -0,0 +1,90 @@
+#ifndef CG_SESSIONSTATE_H
+#define CG_SESSIONSTATE_H
+
+#include <mutex>
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "AsimovCache.h"
+#include "SamplingDistStore.h"
+#include "Checkpoint.h"
+#include "ModelClone.h"
+
+namespace CG_Statistics
+{
+  // options set by the public setters
+  struct SessionOptions
+  {
+    SessionOptions():
+      iBins(0),
+      iMinEvents(10000),
+      dSketchAccuracy(0),
+      bCompiledNLL(false),
+      bBatchNLL(false),
+      bAnalyticGradients(false)
+    {}
+
+    int iBins;                   // see SetBinnedFits
+    unsigned int iMinEvents;     // see SetBinnedFits
+    double dSketchAccuracy;      // see SetToySketches
+    bool bCompiledNLL;           // see SetCompiledNLL
+    bool bBatchNLL;              // see SetBatchNLL
+    bool bAnalyticGradients;     // see SetAnalyticGradients
+  };
+
+  // options, caches and performance counters of one session (or of all calls outside of sessions)
+  struct SessionState
+  {
+    SessionState():
+      options(),
+      asimovCache(),
+      store(),
+      checkpoint(),
+      modelClones(),
+      counters(),
+      lastCall(),
+      countersMutex(),
+      iCallDepth(0),
+      bSession(false),
+      eVerbosity(eSILENT)
+    {}
+
+    SessionOptions options;
+    AsimovCache asimovCache;
+    SamplingDistStore store;
+    Checkpoint checkpoint;
+    ModelClonePool modelClones;  // copies of the model for workers (see GetWorkerModel)
+    PerfCounters counters;       // accumulated counters (see GetPerfCounters)
+    PerfCounters lastCall;       // counters of last call (see CallScope)
+    std::mutex countersMutex;    // serialises access to the counters (see AddProcessPerfCounters)
+    unsigned int iCallDepth;     // number of nested calls (see CallScope)
+    bool bSession;               // state of a session (not of the process)
+    VERBOSITY eVerbosity;        // verbosity of the session (see GlobalLock)
+
+  private:
+    SessionState(const SessionState&);
+    SessionState& operator=(const SessionState&);
+  };
+
+  // state of the session active in the current thread (state of the process if no session is active)
+  SessionState& GetSessionState();
+
+  // lock serialising the calls of all threads (RooFit, RooRandom and ROOT I/O are not thread-safe)
+  //
+  // Nested locks of the same thread (also of a forked worker) do not block. The outermost lock sets
+  // iVERBOSITY to the verbosity of the active session and restores it when released.
+  class GlobalLock
+  {
+  public:
+    GlobalLock();
+    ~GlobalLock();
+
+  private:
+    GlobalLock(const GlobalLock&);
+    GlobalLock& operator=(const GlobalLock&);
+
+    VERBOSITY m_ePrevious;
+  };
+}
+
+#endif // CG_SESSIONSTATE_H
@@ -0,0 +1,157 @@
+#include <cassert>
+#include <cmath>
+#include <iterator>
+#include <vector>
+
+#include "RooStats/SamplingDistribution.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+
+ClassImp(CG_Statistics::TestStatSketch)
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // values up to this limit are counted in the zero bin
+    const double dMinValue = 1e-8;
+  }
+
+  TestStatSketch::TestStatSketch(double dRelAccuracy,unsigned int iMaxBins):
+    m_dRelAccuracy(dRelAccuracy),
+    m_dGamma((1 + dRelAccuracy) / (1 - dRelAccuracy)),
+    m_iMaxBins(iMaxBins),
+    m_mBins(),
+    m_dZeroWeight(0),
+    m_dSumW(0),
+    m_dSumW2(0),
+    m_iEntries(0)
+  {
+    assert((dRelAccuracy > 0) && (dRelAccuracy < 1));
+    assert(iMaxBins > 0);
+  }
+
+  int TestStatSketch::GetIndex(double x) const
+  {
+    return (int)ceil(log(x) / log(m_dGamma));
+  }
+
+  void TestStatSketch::Collapse()
+  {
+    while(m_mBins.size() > m_iMaxBins)
+    {
+      auto lowest = m_mBins.begin();
+      std::next(lowest)->second += lowest->second;
+      m_mBins.erase(lowest);
+    }
+  }
+
+  void TestStatSketch::Fill(double x,double w)
+  {
+    if(x <= dMinValue)
+      m_dZeroWeight += w;
+    else
+    {
+      // values below the lowest bin are counted in it (see Collapse)
+      int iIndex = GetIndex(x);
+      if((m_mBins.size() >= m_iMaxBins) && (iIndex < m_mBins.begin()->first))
+	iIndex = m_mBins.begin()->first;
+
+      m_mBins[iIndex] += w;
+      Collapse();
+    }
+
+    m_dSumW += w;
+    m_dSumW2 += w * w;
+    ++m_iEntries;
+  }
+
+  void TestStatSketch::Fill(const SamplingDistribution& dist)
+  {
+    const std::vector<double>& vValues = dist.GetSamplingDistribution();
+    const std::vector<double>& vWeights = dist.GetSampleWeights();
+    for(unsigned int i = 0; i < vValues.size(); ++i)
+      Fill(vValues[i],(i < vWeights.size()) ? vWeights[i] : 1);
+  }
+
+  void TestStatSketch::Add(const TestStatSketch& other)
+  {
+    assert(fabs(m_dGamma - other.m_dGamma) < 1e-12);
+
+    for(auto& bin : other.m_mBins)
+      m_mBins[bin.first] += bin.second;
+    Collapse();
+
+    m_dZeroWeight += other.m_dZeroWeight;
+    m_dSumW += other.m_dSumW;
+    m_dSumW2 += other.m_dSumW2;
+    m_iEntries += other.m_iEntries;
+  }
+
+  double TestStatSketch::GetPValue(double x) const
+  {
+    if(m_dSumW <= 0)
+      return 0;
+
+    if(x <= 0)
+      return 1;
+
+    // all bins from the one containing x (values in the zero bin may be >= x <= 1e-8 as well)
+    double dTail = (x <= dMinValue) ? m_dZeroWeight : 0;
+    for(auto it = (x <= dMinValue) ? m_mBins.begin() : m_mBins.lower_bound(GetIndex(x)); it != m_mBins.end(); ++it)
+      dTail += it->second;
+
+    return dTail / m_dSumW;
+  }
+
+  SamplingDistribution* TestStatSketch::GetSamplingDistribution(const char* sName) const
+  {
+    // upper bin edges, so the tail integral from x over [x,inf] equals GetPValue(x)
+    std::vector<double> vValues;
+    std::vector<double> vWeights;
+    if(m_dZeroWeight != 0)
+    {
+      vValues.push_back(dMinValue);
+      vWeights.push_back(m_dZeroWeight);
+    }
+    for(auto& bin : m_mBins)
+    {
+      vValues.push_back(pow(m_dGamma,bin.first));
+      vWeights.push_back(bin.second);
+    }
+
+    return new SamplingDistribution(sName,sName,vValues,vWeights);
+  }
+
+  double TestStatSketch::GetPValueError(double x) const
+  {
+    if(m_dSumW2 <= 0)
+      return 0;
+
+    // binomial error with the effective number of entries
+    const double p = GetPValue(x);
+    const double dEffEntries = m_dSumW * m_dSumW / m_dSumW2;
+
+    return sqrt(p * (1 - p) / dEffEntries);
+  }
+
+  double TestStatSketch::GetQuantile(double q) const
+  {
+    const double dTarget = q * m_dSumW;
+    double dSum = m_dZeroWeight;
+    if(dSum >= dTarget)
+      return 0;
+
+    // centre of the bin reaching the target with relative distance <= m_dRelAccuracy to both edges
+    for(auto& bin : m_mBins)
+    {
+      dSum += bin.second;
+      if(dSum >= dTarget)
+	return 2 * pow(m_dGamma,bin.first) / (m_dGamma + 1);
+    }
+
+    return m_mBins.empty() ? 0 : 2 * pow(m_dGamma,m_mBins.rbegin()->first) / (m_dGamma + 1);
+  }
+}
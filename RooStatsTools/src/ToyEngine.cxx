@@ -0,0 +1,1080 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "RooAbsData.h"
+#include "RooDataSet.h"
+#include "RooAbsPdf.h"
+#include "RooRealVar.h"
+#include "RooArgSet.h"
+#include "RooGlobalFunc.h"
+#include "RooRandom.h"
+#include "RooLinkedListIter.h"
+using namespace RooFit;
+
+#include "TEfficiency.h"
+#include "TRandom3.h"
+#include "TString.h"
+
+#include "RooStats/ModelConfig.h"
+#include "RooStats/HypoTestResult.h"
+#include "RooStats/SamplingDistribution.h"
+#include "RooStats/ProfileLikelihoodTestStat.h"
+#include "RooStats/ToyMCSampler.h"
+#include "RooStats/FrequentistCalculator.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "ModelClone.h"
+#include "WorkerPool.h"
+#include "ToyEngine.h"
+#include "Instrumentation.h"
+#include "LikelihoodContext.h"
+#include "SamplingDistStore.h"
+#include "Fingerprint.h"
+#include "BinnedData.h"
+#include "ToyGenerator.h"
+#include "SessionState.h"
+#include "CompiledNLL.h"
+#include "BatchNLL.h"
+#include "GradientMinimizer.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // maximum number of toys per block in sketch mode
+    const unsigned int iMaxBlockToys = 100000;
+
+    // profile likelihood ratio of the given flavour recording its evaluations in the performance counters
+    //
+    // If one of the NLL options (SetCompiledNLL, SetBatchNLL, SetAnalyticGradients) is enabled, the fits
+    // are done with a LikelihoodContext (and recorded by it) using the NLL selected by these options. The
+    // first value is cross-checked against RooStats::ProfileLikelihoodTestStat and all further values are
+    // taken from RooStats if they differ. Otherwise the fits are done by RooStats and can therefore not be
+    // recorded individually (see PerfCounters).
+    class CountedTestStat : public ProfileLikelihoodTestStat
+    {
+    public:
+      CountedTestStat(RooAbsPdf& pdf,TESTSTAT eTestStat):
+	ProfileLikelihoodTestStat(pdf),
+	m_pdf(pdf),
+	m_eTestStat(eTestStat),
+	m_iContextCheck(0)
+      {
+	SetOneSided(eTestStat == eONESIDED);
+	SetOneSidedDiscovery(eTestStat == eDISCOVERY);
+      }
+
+      virtual Double_t Evaluate(RooAbsData& data,RooArgSet& nullPOI)
+      {
+	const bool bContext = UseCompiledNLL() || UseBatchNLL() || UseAnalyticGradients();
+	if(!bContext || (m_iContextCheck < 0))
+	  return EvaluateRooStats(data,nullPOI);
+
+	const double dValue = EvaluateContext(data,nullPOI);
+	if(m_iContextCheck == 0)
+	{
+	  const double dReference = EvaluateRooStats(data,nullPOI);
+	  const bool bSame = fabs(dValue - dReference) <= 0.01 * (1 + fabs(dReference));
+	  m_iContextCheck = bSame ? 1 : -1;
+	  if(!bSame)
+	  {
+	    if(iVERBOSITY >= eWARNING)
+	      std::cerr << "test statistic on toys: " << dValue << " with the selected NLL differs from " << dReference
+			<< " of RooStats, using RooStats" << std::endl;
+	    return dReference;
+	  }
+	}
+
+	return dValue;
+      }
+
+    private:
+      // value of RooStats::ProfileLikelihoodTestStat
+      double EvaluateRooStats(RooAbsData& data,RooArgSet& nullPOI)
+      {
+	double dValue = 0;
+	{
+	  ScopedTimer timer(&PerfCounters::dTestStatTime);
+	  dValue = ProfileLikelihoodTestStat::Evaluate(data,nullPOI);
+	}
+
+	// unconditional fit and conditional fit (skipped by the one-sided flavours for a value of 0)
+	PerfCounters counters = PerfCounters();
+	counters.iFits = ((m_eTestStat != eTWOSIDED) && (dValue == 0)) ? 1 : 2;
+	if(!std::isfinite(dValue))
+	  counters.iFailedFits = 1;
+	AddProcessPerfCounters(counters);
+
+	return dValue;
+      }
+
+      // same value (-log of the profile likelihood ratio) from the fits of a LikelihoodContext
+      double EvaluateContext(RooAbsData& data,RooArgSet& nullPOI)
+      {
+	// store parameters of pdf
+	RooArgSet* allParams = m_pdf.getParameters(data);
+	RooArgSet* pSnapshot = (RooArgSet*)allParams->snapshot();
+	RooArgSet* pPOIs = (RooArgSet*)allParams->selectCommon(nullPOI);
+	std::vector<double> vPOIValues;
+	std::vector<bool> vConstant;
+	RooLinkedListIter it = pPOIs->iterator();
+	RooRealVar* poi = 0;
+	while((poi = (RooRealVar*)it.Next()))
+	{
+	  vPOIValues.push_back(((RooRealVar*)nullPOI.find(poi->GetName()))->getVal());
+	  vConstant.push_back(poi->isConstant());
+	}
+
+	double dValue = 0;
+	{
+	  LikelihoodContext context(data,m_pdf,*pPOIs,false);
+	  const double dMuHat = context.GetMuHat();
+	  // one-sided flavours are 0 for best fit values above (below for discovery) the tested value
+	  if(((m_eTestStat == eONESIDED) && (dMuHat >= vPOIValues.front())) ||
+	     ((m_eTestStat == eDISCOVERY) && (dMuHat <= vPOIValues.front())))
+	    dValue = 0;
+	  else
+	    dValue = std::max(context.GetConditionalNLL(vPOIValues) - context.GetUnconditionalNLL(),0.);
+	}
+
+	// restore parameters of pdf
+	allParams->assignValueOnly(*pSnapshot);
+	it = pPOIs->iterator();
+	for(unsigned int i = 0; (poi = (RooRealVar*)it.Next()); ++i)
+	  poi->setConstant(vConstant.at(i));
+	delete pPOIs;
+	delete pSnapshot;
+	delete allParams;
+
+	return dValue;
+      }
+
+      RooAbsPdf& m_pdf;
+      TESTSTAT m_eTestStat;
+      int m_iContextCheck;   // cross-check of the NLL options: 0 = pending, 1 = passed, -1 = failed
+    };
+
+    // ToyMCSampler generating its toys with pooled generators (see ToyGenerator)
+    //
+    // The generator contexts and batches of events for the observables and the global observables are kept
+    // for all toys of a hypothesis. The ToyMCSampler takes ownership of every toy, so the pooled toy is
+    // handed out as a copy. Toys with sampled nuisance parameters (not used by the FrequentistCalculator) or
+    // of another pdf are generated by the ToyMCSampler.
+    class PooledToyMCSampler : public ToyMCSampler
+    {
+    public:
+      PooledToyMCSampler(TestStatistic& ts,bool bBinned):
+	ToyMCSampler(ts,0),
+	m_bBinned(bBinned),
+	m_pGenerator(0),
+	m_pGlobalGenerator(0)
+      {}
+
+      virtual ~PooledToyMCSampler()
+      {
+	delete m_pGlobalGenerator;
+	delete m_pGenerator;
+      }
+
+      using ToyMCSampler::GenerateToyData;
+
+      virtual RooAbsData* GenerateToyData(RooArgSet& paramPoint,double& weight,RooAbsPdf& pdf) const
+      {
+	if((&pdf != fPdf) || !fObservables || fPriorNuisance || fExpectedNuisancePar)
+	  return ToyMCSampler::GenerateToyData(paramPoint,weight,pdf);
+
+	RooArgSet* allVars = fPdf->getVariables();
+	*allVars = paramPoint;
+
+	RooArgSet observables(*fObservables);
+	RooArgSet globalObs;
+	if(fGlobalObservables)
+	{
+	  globalObs.add(*fGlobalObservables);
+	  observables.remove(globalObs,kTRUE,kTRUE);
+	}
+
+	if(!m_pGenerator)
+	{
+	  m_pGenerator = new ToyGenerator(*fPdf,observables,m_bBinned,true,&globalObs);
+	  if(globalObs.getSize() > 0)
+	    m_pGlobalGenerator = new ToyGenerator(*fPdf,globalObs,false,true,&observables);
+	}
+
+	// global observables keep their generated values (as done by the ToyMCSampler)
+	if(m_pGlobalGenerator)
+	  globalObs.assignValueOnly(m_pGlobalGenerator->GenerateEvent());
+	RooArgSet* pSaved = (RooArgSet*)allVars->snapshot();
+
+	RooAbsData* pToy = (RooAbsData*)m_pGenerator->Generate().Clone();
+	weight = 1;
+
+	*allVars = *pSaved;
+	delete pSaved;
+	delete allVars;
+
+	return pToy;
+      }
+
+    private:
+      bool m_bBinned;
+      mutable ToyGenerator* m_pGenerator;
+      mutable ToyGenerator* m_pGlobalGenerator;
+    };
+
+    // values of the floating parameters (except the POI) after profiling the likelihood of the observed
+    // data at poi = dPOI (used for generating toys as done by the FrequentistCalculator)
+    RooArgSet* GetConditionalMLEs(RooAbsData& data,const ModelConfig& mc,double dPOI)
+    {
+      RooAbsPdf* pPDF = mc.GetPdf();
+      RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+
+      // store parameters of pdf
+      RooArgSet* allParams = pPDF->getParameters(data);
+      RooArgSet* pSnapshot = (RooArgSet*)allParams->snapshot();
+      const bool bConstant = pPOI->isConstant();
+      RooArgSet* floatParams = (RooArgSet*)allParams->selectByAttrib("Constant",kFALSE);
+      floatParams->remove(*pPOI,kTRUE,kTRUE);
+
+      // profile nuisance parameters
+      if(floatParams->getSize() > 0)
+      {
+	LikelihoodContext context(data,*pPDF,RooArgSet(*pPOI),false);
+	context.GetConditionalNLL(dPOI);
+      }
+
+      RooArgSet* pMLEs = (RooArgSet*)floatParams->snapshot();
+      delete floatParams;
+
+      // restore parameters of pdf
+      allParams->assignValueOnly(*pSnapshot);
+      pPOI->setConstant(bConstant);
+      delete pSnapshot;
+      delete allParams;
+
+      return pMLEs;
+    }
+
+    // values of the floating parameters (except the POI) for generating toys with poi = dPOI: parameters
+    // found in pFixed are set to the given values, the others are profiled (see GetConditionalMLEs)
+    RooArgSet* GetGenerationMLEs(RooAbsData& data,const ModelConfig& mc,double dPOI,const RooArgSet* pFixed)
+    {
+      if(!pFixed)
+	return GetConditionalMLEs(data,mc,dPOI);
+
+      RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+      RooArgSet* allParams = mc.GetPdf()->getParameters(data);
+      RooArgSet* pSnapshot = (RooArgSet*)allParams->snapshot();
+
+      // fix the given parameters while profiling the others
+      RooArgSet* floatParams = (RooArgSet*)allParams->selectByAttrib("Constant",kFALSE);
+      floatParams->remove(*pPOI,kTRUE,kTRUE);
+      RooArgSet* pCommon = (RooArgSet*)floatParams->selectCommon(*pFixed);
+      pCommon->assignValueOnly(*pFixed);
+      pCommon->setAttribAll("Constant",kTRUE);
+      RooArgSet* pMLEs = GetConditionalMLEs(data,mc,dPOI);
+      pCommon->setAttribAll("Constant",kFALSE);
+      pMLEs->addClone(*pCommon);
+
+      // restore parameters of pdf
+      allParams->assignValueOnly(*pSnapshot);
+      delete pCommon;
+      delete floatParams;
+      delete pSnapshot;
+      delete allParams;
+
+      return pMLEs;
+    }
+
+    // values of all parameters for generating toys with poi = dPOI (see GetGenerationMLEs)
+    RooArgSet* GetGenerationValues(RooAbsData& data,const ModelConfig& mc,double dPOI,const RooArgSet* pFixed = 0)
+    {
+      RooArgSet* pValues = GetGenerationMLEs(data,mc,dPOI,pFixed);
+      RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first()->clone(0);
+      pPOI->setVal(dPOI);
+      pValues->addOwned(*pPOI);
+
+      return pValues;
+    }
+
+    // best fit value of the POI (parameters of the pdf are not changed)
+    double GetMuHat(RooAbsData& data,const ModelConfig& mc)
+    {
+      RooAbsPdf* pPDF = mc.GetPdf();
+      RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+
+      RooArgSet* allParams = pPDF->getParameters(data);
+      RooArgSet* pSnapshot = (RooArgSet*)allParams->snapshot();
+      const bool bConstant = pPOI->isConstant();
+
+      double dMuHat = 0;
+      {
+	LikelihoodContext context(data,*pPDF,RooArgSet(*pPOI),false);
+	dMuHat = context.GetMuHat();
+      }
+
+      allParams->assignValueOnly(*pSnapshot);
+      pPOI->setConstant(bConstant);
+      delete pSnapshot;
+      delete allParams;
+
+      return dMuHat;
+    }
+
+    // key of the sampling distribution of the test statistic evaluated at poi = dTestedPOI on toys
+    // generated with poi = dGenPOI and the given values of the other parameters
+    ULong64_t GetStoreKey(RooAbsData& data,const ModelConfig& mc,TESTSTAT eTestStat,double dTestedPOI,double dGenPOI,const RooArgSet& genParams)
+    {
+      ULong64_t iHash = GetPdfHash(*mc.GetPdf());
+      iHash = HashCombine(iHash,HashString(mc.GetParametersOfInterest()->first()->GetName()));
+      iHash = HashCombine(iHash,eTestStat);
+      iHash = HashCombine(iHash,HashDouble(dTestedPOI));
+      iHash = HashCombine(iHash,HashDouble(dGenPOI));
+      iHash = HashCombine(iHash,GetValuesHash(genParams));
+      // binned and unbinned toys are stored separately
+      iHash = HashCombine(iHash,GetToyBins(*mc.GetObservables(),data));
+
+      return iHash;
+    }
+
+    // seed of the toy with index iToy of the distribution with the given store key (counter-based: it only
+    // depends on the base seed, the key and the index)
+    UInt_t GetToySeed(UInt_t iSeed,ULong64_t iKey,ULong64_t iToy)
+    {
+      // splitmix64 finaliser
+      ULong64_t x = HashCombine(HashCombine(iSeed,iKey),iToy);
+      x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+      x = x ^ (x >> 31);
+
+      // 0 would be replaced by a time dependent seed
+      const UInt_t iToySeed = (UInt_t)(x ^ (x >> 32));
+      return iToySeed ? iToySeed : 1;
+    }
+
+    // seed which does not depend on the state of RooRandom (a new process always starts from the same state)
+    UInt_t GetFreshSeed()
+    {
+      // seeded from a UUID
+      TRandom3 seeder(0);
+      return seeder.Integer(kMaxUInt - 1) + 1;
+    }
+
+    // restores the state of the RooFit random generator at destruction
+    class RandomStateGuard
+    {
+    public:
+      RandomStateGuard():
+	m_state(*(TRandom3*)RooRandom::randomGenerator())
+      {}
+
+      ~RandomStateGuard()
+      {
+	*(TRandom3*)RooRandom::randomGenerator() = m_state;
+      }
+
+    private:
+      TRandom3 m_state;
+    };
+
+    // generate toys with iWorkers parallel workers and merge their results (see RunToyHypoTest)
+    HypoTestResult* GenerateToys(RooAbsData& data,
+				 const ModelConfig& mc,
+				 double dNullPOI,
+				 double dAltPOI,
+				 TESTSTAT eTestStat,
+				 unsigned int iNullToys,
+				 unsigned int iAltToys,
+				 unsigned int iWorkers,
+				 const RooArgSet* pNullMLEs,
+				 const RooArgSet* pAltMLEs)
+    {
+      iWorkers = std::min(GetNWorkers(iWorkers),std::max(std::max(iNullToys,iAltToys),1u));
+
+      auto task = [&](unsigned int iWorker) -> TObject*
+	{
+	  // independent copy of the model (made once per call and worker)
+	  ModelClone& clone = GetWorkerModel(mc,iWorker);
+	  ModelConfig& sbModel = clone.GetModel();
+	  RooRealVar* poi = clone.GetPOI();
+
+	  // set up hypotheses
+	  poi->setVal(dNullPOI);
+	  sbModel.SetSnapshot(*poi);
+	  ModelConfig* bModel = (ModelConfig*)sbModel.Clone("bModel");
+	  poi->setVal(dAltPOI);
+	  bModel->SetSnapshot(*poi);
+
+	  // use profile likelihood as test statistic
+	  CountedTestStat profll(*sbModel.GetPdf(),eTestStat);
+	  // binned toys for large datasets (see SetBinnedFits)
+	  const bool bBinned = sbModel.GetPdf()->canBeExtended() && SetToyBinning(*sbModel.GetObservables(),data);
+	  PooledToyMCSampler toymcs(profll,bBinned);
+
+	  // initialise frequentist calculator
+	  FrequentistCalculator fcalc(data,*bModel,sbModel,&toymcs);
+	  fcalc.SetToys(GetWorkerShare(iNullToys,iWorkers,iWorker),GetWorkerShare(iAltToys,iWorkers,iWorker));
+	  // generate toys with the same parameters as used for the store key
+	  if(pNullMLEs)
+	    fcalc.SetConditionalMLEsNull(pNullMLEs);
+	  if(pAltMLEs)
+	    fcalc.SetConditionalMLEsAlt(pAltMLEs);
+
+	  if (!sbModel.GetPdf()->canBeExtended())
+	    toymcs.SetNEventsPerToy(1);
+	  toymcs.SetGenerateBinned(bBinned);
+	  // set up generator context once instead of for every toy (toys not generated by the pooled generator)
+	  toymcs.SetUseMultiGen(true);
+
+	  HypoTestResult* pResult = 0;
+	  {
+	    GenerationTimer timer;
+	    pResult = fcalc.GetHypoTest();
+	  }
+	  AddToys(pResult);
+	  delete bModel;
+
+	  return pResult;
+	};
+
+      // merge results of all workers (copies made before forking are shared by all blocks of this call)
+      PrepareWorkerModels(mc,iWorkers);
+      HypoTestResult* pResult = 0;
+      std::vector<TObject*> vResults = RunWorkers(iWorkers,task);
+      for(auto pObj : vResults)
+      {
+	HypoTestResult* pPartial = (HypoTestResult*)pObj;
+	if(!pPartial)
+	  continue;
+
+	if(!pResult)
+	  pResult = pPartial;
+	else
+	{
+	  pResult->Append(pPartial);
+	  delete pPartial;
+	}
+      }
+
+      return pResult;
+    }
+
+    // observed value of the test statistic at poi = dNullPOI
+    double EvaluateObservedTestStat(RooAbsData& data,const ModelConfig& mc,double dNullPOI,TESTSTAT eTestStat)
+    {
+      RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+      RooArgSet* pNullPOI = (RooArgSet*)RooArgSet(*pPOI).snapshot();
+      ((RooRealVar*)pNullPOI->first())->setVal(dNullPOI);
+      CountedTestStat profll(*mc.GetPdf(),eTestStat);
+      const double dObs = profll.Evaluate(data,*pNullPOI);
+      delete pNullPOI;
+
+      return dObs;
+    }
+
+    // true if the p-value obtained from iToys toys differs significantly from dTarget (Clopper-Pearson
+    // interval at confidence level dStopConf, see RunSequentialToyHypoTest)
+    bool IsDecided(unsigned int iToys,double p,double dTarget,double dStopConf)
+    {
+      // number of toys with a test statistic at least as extreme as the observed one
+      const int iPassed = (int)(p * iToys + 0.5);
+      const double dLower = TEfficiency::ClopperPearson(iToys,iPassed,dStopConf,false);
+      const double dUpper = TEfficiency::ClopperPearson(iToys,iPassed,dStopConf,true);
+
+      if(iVERBOSITY >= eDEBUG)
+	std::cout << "p-value after " << iToys << " toys: " << p << " [" << dLower << "," << dUpper << "]" << std::endl;
+
+      return (dUpper < dTarget) || (dLower > dTarget);
+    }
+
+    // seeds of a stored distribution (see SamplingDistStore::GetSeeds) extended by the seed of a top-up
+    TString AppendSeed(TString sSeeds,UInt_t iSeed,unsigned int iToys)
+    {
+      if(!sSeeds.IsNull())
+	sSeeds += " ";
+      sSeeds += TString::Format("%u:%u",iSeed,iToys);
+
+      return sSeeds;
+    }
+
+    // stored distribution extended by new toys (ownership of pStored is transferred to the returned object)
+    SamplingDistribution* MergeDistributions(SamplingDistribution* pStored,const SamplingDistribution* pNew)
+    {
+      if(!pStored)
+	return pNew ? (SamplingDistribution*)pNew->Clone() : 0;
+
+      if(pNew)
+	pStored->Add(pNew);
+
+      return pStored;
+    }
+
+    // toy-based test in sketch mode (see SetToySketches): result holding the sketches as binned sampling
+    // distributions, so HypoTestResult::Append merges repeated tests (dTarget >= 0: sequential test, see
+    // RunSequentialToyHypoTest)
+    HypoTestResult* RunSketchedToyHypoTest(RooAbsData& data,
+					   const ModelConfig& mc,
+					   double dNullPOI,
+					   double dAltPOI,
+					   TESTSTAT eTestStat,
+					   unsigned int iNullToys,
+					   unsigned int iAltToys,
+					   unsigned int iWorkers,
+					   unsigned int iBlockToys,
+					   double dTarget,
+					   double dStopConf)
+    {
+      TestStatSketch nullSketch(GetSessionState().options.dSketchAccuracy);
+      TestStatSketch altSketch(GetSessionState().options.dSketchAccuracy);
+      const double dObs = FillToySketches(data,mc,dNullPOI,dAltPOI,eTestStat,iNullToys,iAltToys,iWorkers,iBlockToys,
+					  nullSketch,altSketch,dTarget,dStopConf);
+      if(nullSketch.GetEntries() + altSketch.GetEntries() == 0)
+	return 0;
+
+      HypoTestResult* pResult = new HypoTestResult("ToyHypoTest",
+						   nullSketch.GetPValue(dObs),
+						   (altSketch.GetEntries() > 0) ? altSketch.GetPValue(dObs) : 1);
+      pResult->SetTestStatisticData(dObs);
+      pResult->SetBackgroundAsAlt(true);
+      if(nullSketch.GetEntries() > 0)
+	pResult->SetNullDistribution(nullSketch.GetSamplingDistribution("NullSketch"));
+      if(altSketch.GetEntries() > 0)
+	pResult->SetAltDistribution(altSketch.GetSamplingDistribution("AltSketch"));
+
+      return pResult;
+    }
+
+    // RunSequentialToyHypoTest with an open sampling distribution store
+    //
+    // The stored toys are looked up once and the blocks of new toys are only added to the store after the
+    // last block, so every block costs its own toys only (also in workers which do not own the store).
+    HypoTestResult* RunStoredSequentialToyHypoTest(RooAbsData& data,
+						   const ModelConfig& mc,
+						   double dNullPOI,
+						   double dAltPOI,
+						   TESTSTAT eTestStat,
+						   double dTarget,
+						   unsigned int iMaxToys,
+						   unsigned int iBlockToys,
+						   unsigned int iWorkers,
+						   double dStopConf)
+    {
+      SamplingDistStore& store = SamplingDistStore::Instance();
+      RooArgSet* pMLEs = GetGenerationMLEs(data,mc,dNullPOI,store.GetNuisanceValues());
+      const ULong64_t iKey = GetStoreKey(data,mc,eTestStat,dNullPOI,dNullPOI,*pMLEs);
+
+      // start from stored toys
+      HypoTestResult* pResult = 0;
+      SamplingDistribution* pStored = store.Get(iKey);
+      if(pStored)
+      {
+	pResult = new HypoTestResult("ToyHypoTest");
+	pResult->SetNullDistribution(pStored);
+	pResult->SetTestStatisticData(EvaluateObservedTestStat(data,mc,dNullPOI,eTestStat));
+	pResult->SetBackgroundAsAlt(true);
+      }
+
+      unsigned int iToys = pStored ? pStored->GetSize() : 0;
+      if(iVERBOSITY >= eDEBUG)
+	std::cout << "found " << iToys << " toys in store" << std::endl;
+
+      // one new seed for all blocks of this top-up (the state of the caller's generator is kept)
+      unsigned int iNewToys = 0;
+      const UInt_t iSeed = GetFreshSeed();
+      {
+	RandomStateGuard guard;
+	RooRandom::randomGenerator()->SetSeed(iSeed);
+	while((iToys < iMaxToys) && !(pResult && IsDecided(iToys,pResult->CLsplusb(),dTarget,dStopConf)))
+	{
+	  const unsigned int iBlock = std::min(iBlockToys,iMaxToys - iToys);
+	  HypoTestResult* pBlock = GenerateToys(data,mc,dNullPOI,dAltPOI,eTestStat,iBlock,0,iWorkers,pMLEs,0);
+	  if(!pBlock || !pBlock->GetNullDistribution())
+	  {
+	    delete pBlock;
+	    break;
+	  }
+
+	  iNewToys += pBlock->GetNullDistribution()->GetSize();
+	  if(!pResult)
+	  {
+	    pResult = pBlock;
+	    pResult->SetBackgroundAsAlt(true);
+	  }
+	  else
+	  {
+	    pResult->Append(pBlock);
+	    delete pBlock;
+	  }
+	  iToys = pResult->GetNullDistribution()->GetSize();
+	}
+      }
+
+      if(iNewToys > 0)
+	store.Put(iKey,*pResult->GetNullDistribution(),AppendSeed(store.GetSeeds(iKey),iSeed,iNewToys));
+      delete pMLEs;
+
+      return pResult;
+    }
+  }
+
+  void SetToySketches(double dRelAccuracy)
+  {
+    assert((dRelAccuracy >= 0) && (dRelAccuracy < 1));
+    GetSessionState().options.dSketchAccuracy = dRelAccuracy;
+  }
+
+  double FillToySketches(RooAbsData& data,
+			 const ModelConfig& mc,
+			 double dNullPOI,
+			 double dAltPOI,
+			 TESTSTAT eTestStat,
+			 unsigned int iNullToys,
+			 unsigned int iAltToys,
+			 unsigned int iWorkers,
+			 unsigned int iBlockToys,
+			 TestStatSketch& nullSketch,
+			 TestStatSketch& altSketch,
+			 double dTarget,
+			 double dStopConf)
+  {
+    iBlockToys = (iBlockToys > 0) ? std::min(iBlockToys,iMaxBlockToys) : iMaxBlockToys;
+
+    double dObs = 0;
+    unsigned int iNullDone = 0;
+    unsigned int iAltDone = 0;
+    while((iNullDone < iNullToys) || (iAltDone < iAltToys))
+    {
+      const unsigned int iNullBlock = std::min(iBlockToys,iNullToys - iNullDone);
+      const unsigned int iAltBlock = std::min(iBlockToys,iAltToys - iAltDone);
+      HypoTestResult* pBlock = GenerateToys(data,mc,dNullPOI,dAltPOI,eTestStat,iNullBlock,iAltBlock,iWorkers,0,0);
+      if(!pBlock)
+	break;
+
+      // only the sketches are kept
+      dObs = pBlock->GetTestStatisticData();
+      if(pBlock->GetNullDistribution())
+	nullSketch.Fill(*pBlock->GetNullDistribution());
+      if(pBlock->GetAltDistribution())
+	altSketch.Fill(*pBlock->GetAltDistribution());
+      delete pBlock;
+      iNullDone += iNullBlock;
+      iAltDone += iAltBlock;
+
+      if((dTarget < 0) || (nullSketch.GetEntries() == 0))
+	continue;
+
+      if(IsDecided(nullSketch.GetEntries(),nullSketch.GetPValue(dObs),dTarget,dStopConf))
+	break;
+    }
+
+    return dObs;
+  }
+
+  HypoTestResult* RunToyHypoTest(RooAbsData& data,
+				 const ModelConfig& mc,
+				 double dNullPOI,
+				 double dAltPOI,
+				 TESTSTAT eTestStat,
+				 unsigned int iNullToys,
+				 unsigned int iAltToys,
+				 unsigned int iWorkers)
+  {
+    if(GetSessionState().options.dSketchAccuracy > 0)
+      return RunSketchedToyHypoTest(data,mc,dNullPOI,dAltPOI,eTestStat,iNullToys,iAltToys,iWorkers,0,-1,0);
+
+    // reuse toys from persistent store
+    SamplingDistStore& store = SamplingDistStore::Instance();
+    const bool bUseStore = store.IsOpen();
+    RooArgSet* pNullMLEs = 0;
+    RooArgSet* pAltMLEs = 0;
+    ULong64_t iNullKey = 0;
+    ULong64_t iAltKey = 0;
+    SamplingDistribution* pStoredNull = 0;
+    SamplingDistribution* pStoredAlt = 0;
+    if(bUseStore)
+    {
+      // toys depend on the nuisance parameters used for their generation
+      pNullMLEs = GetGenerationMLEs(data,mc,dNullPOI,store.GetNuisanceValues());
+      iNullKey = GetStoreKey(data,mc,eTestStat,dNullPOI,dNullPOI,*pNullMLEs);
+      pStoredNull = store.Get(iNullKey);
+      if(pStoredNull)
+	iNullToys -= std::min(iNullToys,(unsigned int)pStoredNull->GetSize());
+
+      if(iAltToys > 0)
+      {
+	pAltMLEs = GetGenerationMLEs(data,mc,dAltPOI,store.GetNuisanceValues());
+	iAltKey = GetStoreKey(data,mc,eTestStat,dNullPOI,dAltPOI,*pAltMLEs);
+	pStoredAlt = store.Get(iAltKey);
+	if(pStoredAlt)
+	  iAltToys -= std::min(iAltToys,(unsigned int)pStoredAlt->GetSize());
+      }
+
+      if(iVERBOSITY >= eDEBUG)
+	std::cout << "found " << (pStoredNull ? pStoredNull->GetSize() : 0) << " null and " << (pStoredAlt ? pStoredAlt->GetSize() : 0)
+		  << " alternate toys in store -> generate " << iNullToys << " null and " << iAltToys << " alternate toys" << std::endl;
+    }
+
+    HypoTestResult* pResult = 0;
+    UInt_t iSeed = 0;
+    if(!bUseStore)
+      pResult = GenerateToys(data,mc,dNullPOI,dAltPOI,eTestStat,iNullToys,iAltToys,iWorkers,0,0);
+    else if((iNullToys > 0) || (iAltToys > 0))
+    {
+      // new seed for every top-up (the state of the caller's generator is kept)
+      RandomStateGuard guard;
+      iSeed = GetFreshSeed();
+      RooRandom::randomGenerator()->SetSeed(iSeed);
+      pResult = GenerateToys(data,mc,dNullPOI,dAltPOI,eTestStat,iNullToys,iAltToys,iWorkers,pNullMLEs,pAltMLEs);
+    }
+
+    // combine stored and new toys
+    if(bUseStore)
+    {
+      HypoTestResult* pNew = pResult;
+      pResult = new HypoTestResult(pNew ? pNew->GetName() : "ToyHypoTest");
+
+      // observed value of the test statistic (evaluate on data if no toys were generated)
+      double dObs = 0;
+      if(pNew)
+	dObs = pNew->GetTestStatisticData();
+      else
+	dObs = EvaluateObservedTestStat(data,mc,dNullPOI,eTestStat);
+
+      SamplingDistribution* pNullDist = MergeDistributions(pStoredNull,pNew ? pNew->GetNullDistribution() : 0);
+      SamplingDistribution* pAltDist = MergeDistributions(pStoredAlt,pNew ? pNew->GetAltDistribution() : 0);
+      if(pNullDist && pNew && pNew->GetNullDistribution())
+	store.Put(iNullKey,*pNullDist,AppendSeed(store.GetSeeds(iNullKey),iSeed,pNew->GetNullDistribution()->GetSize()));
+      if(pAltDist && pNew && pNew->GetAltDistribution())
+	store.Put(iAltKey,*pAltDist,AppendSeed(store.GetSeeds(iAltKey),iSeed,pNew->GetAltDistribution()->GetSize()));
+
+      pResult->SetNullDistribution(pNullDist);
+      pResult->SetAltDistribution(pAltDist);
+      pResult->SetTestStatisticData(dObs);
+
+      delete pNew;
+      delete pNullMLEs;
+      delete pAltMLEs;
+    }
+
+    if(pResult)
+      pResult->SetBackgroundAsAlt(true);
+
+    return pResult;
+  }
+
+  HypoTestResult* RunSequentialToyHypoTest(RooAbsData& data,
+					   const ModelConfig& mc,
+					   double dNullPOI,
+					   double dAltPOI,
+					   TESTSTAT eTestStat,
+					   double dTarget,
+					   unsigned int iMaxToys,
+					   unsigned int iBlockToys,
+					   unsigned int iWorkers,
+					   double dStopConf)
+  {
+    if(GetSessionState().options.dSketchAccuracy > 0)
+      return RunSketchedToyHypoTest(data,mc,dNullPOI,dAltPOI,eTestStat,iMaxToys,0,iWorkers,iBlockToys,(iBlockToys > 0) ? dTarget : -1,dStopConf);
+
+    if((iBlockToys == 0) || (iBlockToys >= iMaxToys))
+      return RunToyHypoTest(data,mc,dNullPOI,dAltPOI,eTestStat,iMaxToys,0,iWorkers);
+
+    // the store is read once before and written once after all blocks (see RunStoredSequentialToyHypoTest)
+    if(SamplingDistStore::Instance().IsOpen())
+      return RunStoredSequentialToyHypoTest(data,mc,dNullPOI,dAltPOI,eTestStat,dTarget,iMaxToys,iBlockToys,iWorkers,dStopConf);
+
+    HypoTestResult* pResult = 0;
+    unsigned int iToys = 0;
+    while(iToys < iMaxToys)
+    {
+      const unsigned int iBlock = std::min(iBlockToys,iMaxToys - iToys);
+      HypoTestResult* pBlock = GenerateToys(data,mc,dNullPOI,dAltPOI,eTestStat,iBlock,0,iWorkers,0,0);
+      if(!pBlock)
+	break;
+
+      if(!pResult)
+      {
+	pResult = pBlock;
+	pResult->SetBackgroundAsAlt(true);
+      }
+      else
+      {
+	pResult->Append(pBlock);
+	delete pBlock;
+      }
+
+      if(!pResult->GetNullDistribution())
+	break;
+
+      iToys = pResult->GetNullDistribution()->GetSize();
+      if(IsDecided(iToys,pResult->CLsplusb(),dTarget,dStopConf))
+	break;
+    }
+
+    return pResult;
+  }
+
+  HypoTestResult* RunImportanceSampledHypoTest(RooAbsData& data,
+					       const ModelConfig& mc,
+					       double dNullPOI,
+					       TESTSTAT eTestStat,
+					       unsigned int iToys,
+					       unsigned int iWorkers,
+					       unsigned int iDensities)
+  {
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+
+    // observed value of the test statistic
+    RooArgSet* pNullPOI = (RooArgSet*)RooArgSet(*pPOI).snapshot();
+    ((RooRealVar*)pNullPOI->first())->setVal(dNullPOI);
+    double dObs = 0;
+    {
+      CountedTestStat profll(*mc.GetPdf(),eTestStat);
+      dObs = profll.Evaluate(data,*pNullPOI);
+    }
+
+    // POI values of the densities used for generating toys (first one = null hypothesis)
+    std::vector<double> vPOIValues(1,dNullPOI);
+    if((dObs > 0) && (iDensities > 1))
+    {
+      const double dMuHat = GetMuHat(data,mc);
+      for(unsigned int i = 1; i < iDensities; ++i)
+	vPOIValues.push_back(dNullPOI + i * (dMuHat - dNullPOI) / (iDensities - 1));
+    }
+
+    std::vector<RooArgSet*> vDensities;
+    for(double dPOI : vPOIValues)
+      vDensities.push_back(GetGenerationValues(data,mc,dPOI));
+
+    if(iVERBOSITY >= eDEBUG)
+    {
+      std::cout << "importance sampling with " << pPOI->GetName() << " =";
+      for(double dPOI : vPOIValues)
+	std::cout << " " << dPOI;
+      std::cout << std::endl;
+    }
+
+    iWorkers = std::min(GetNWorkers(iWorkers),std::max(iToys,1u));
+
+    auto task = [&](unsigned int iWorker) -> TObject*
+      {
+	// independent copy of the model (made once per call and worker)
+	ModelClone& clone = GetWorkerModel(mc,iWorker);
+	RooAbsPdf* pPDF = clone.GetModel().GetPdf();
+	const RooArgSet* pObs = clone.GetModel().GetObservables();
+	RooArgSet* allParams = pPDF->getParameters(data);
+	RooArgSet globalObs;
+	if(clone.GetModel().GetGlobalObservables())
+	  globalObs.add(*clone.GetModel().GetGlobalObservables());
+	const bool bExtended = pPDF->canBeExtended();
+	// binned toys for large datasets (see SetBinnedFits)
+	const bool bBinned = bExtended && SetToyBinning(*pObs,data);
+
+	// one generator of observables and of global observables per density (the generator contexts depend on
+	// the parameter values they were set up with) and one NLL per density on its pooled toy
+	std::vector<ToyGenerator*> vGenerators;
+	std::vector<ToyGenerator*> vGlobalGenerators;
+	std::vector<RooAbsReal*> vNLLs(vDensities.size(),0);
+	for(auto pDensity : vDensities)
+	{
+	  allParams->assignValueOnly(*pDensity);
+	  vGenerators.push_back(new ToyGenerator(*pPDF,*pObs,bBinned,true,&globalObs));
+	  if(globalObs.getSize() > 0)
+	    vGlobalGenerators.push_back(new ToyGenerator(*pPDF,globalObs,false,true,pObs));
+	}
+
+	CountedTestStat profll(*pPDF,eTestStat);
+
+	const unsigned int iWorkerToys = GetWorkerShare(iToys,iWorkers,iWorker);
+	std::vector<double> vValues;
+	std::vector<double> vWeights;
+	std::vector<double> vNLL(vDensities.size(),0);
+	{
+	  GenerationTimer timer;
+	  for(unsigned int i = 0; i < iWorkerToys; ++i)
+	  {
+	    // same number of toys from each density
+	    const unsigned int iDensity = i % vDensities.size();
+	    allParams->assignValueOnly(*vDensities.at(iDensity));
+
+	    // global observables are part of the toy as for the ToyMCSampler (the constraint terms of the NLL
+	    // below are hence evaluated at the generated values)
+	    if(globalObs.getSize() > 0)
+	      globalObs.assignValueOnly(vGlobalGenerators.at(iDensity)->GenerateEvent());
+	    RooAbsData& toy = vGenerators.at(iDensity)->Generate();
+
+	    // the NLL of a density is set up once on its pooled toy which is refilled in place for every toy
+	    RooAbsReal*& pNLL = vNLLs.at(iDensity);
+	    if(!pNLL)
+	      pNLL = pPDF->createNLL(toy,Extended(bExtended));
+	    else
+	      pNLL->setData(toy,kFALSE);
+
+	    // weight = f_null(toy) / (sum_k f_k(toy) / K) with the joint density of observables and global observables
+	    for(unsigned int k = 0; k < vDensities.size(); ++k)
+	    {
+	      allParams->assignValueOnly(*vDensities.at(k));
+	      vNLL.at(k) = pNLL->getVal();
+	    }
+
+	    double dSum = 0;
+	    for(double dNLL : vNLL)
+	      dSum += exp(vNLL.front() - dNLL);
+	    vWeights.push_back(vDensities.size() / dSum);
+
+	    vValues.push_back(profll.Evaluate(toy,*pNullPOI));
+	  }
+	}
+	AddToys(iWorkerToys);
+	for(auto pNLL : vNLLs)
+	  delete pNLL;
+	for(auto pGenerator : vGlobalGenerators)
+	  delete pGenerator;
+	for(auto pGenerator : vGenerators)
+	  delete pGenerator;
+	delete allParams;
+
+	return new SamplingDistribution("ImportanceSampling","importance sampled toys",vValues,vWeights,profll.GetVarName());
+      };
+
+    // merge distributions of all workers
+    PrepareWorkerModels(mc,iWorkers);
+    std::vector<TObject*> vResults = RunWorkers(iWorkers,task);
+    SamplingDistribution* pDist = 0;
+    for(auto pObj : vResults)
+    {
+      SamplingDistribution* pPartial = (SamplingDistribution*)pObj;
+      if(!pPartial)
+	continue;
+
+      if(!pDist)
+	pDist = pPartial;
+      else
+      {
+	pDist->Add(pPartial);
+	delete pPartial;
+      }
+    }
+
+    for(auto pDensity : vDensities)
+      delete pDensity;
+    delete pNullPOI;
+
+    if(!pDist)
+      return 0;
+
+    // p-value (and its uncertainty) from weighted null distribution
+    HypoTestResult* pResult = new HypoTestResult("ImportanceSampledHypoTest");
+    pResult->SetTestStatisticData(dObs);
+    pResult->SetNullDistribution(pDist);
+
+    return pResult;
+  }
+
+  SamplingDistribution* RunToyShard(RooAbsData& data,
+				    const ModelConfig& mc,
+				    double dPOI,
+				    TESTSTAT eTestStat,
+				    ULong64_t iFirstToy,
+				    unsigned int iToys,
+				    UInt_t iSeed,
+				    unsigned int iWorkers,
+				    const RooArgSet* pNuisanceValues,
+				    ULong64_t& iKey)
+  {
+    RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+
+    // same generation parameters and key as for toys in the store
+    RooArgSet* pGenValues = GetGenerationValues(data,mc,dPOI,pNuisanceValues);
+    {
+      RooArgSet mles(*pGenValues);
+      mles.remove(*pGenValues->find(pPOI->GetName()));
+      iKey = GetStoreKey(data,mc,eTestStat,dPOI,dPOI,mles);
+    }
+
+    RooArgSet* pNullPOI = (RooArgSet*)RooArgSet(*pPOI).snapshot();
+    ((RooRealVar*)pNullPOI->first())->setVal(dPOI);
+
+    // contiguous ranges of toys per worker
+    iWorkers = std::min(GetNWorkers(iWorkers),std::max(iToys,1u));
+    std::vector<unsigned int> vBegin(1,0);
+    for(unsigned int iWorker = 0; iWorker < iWorkers; ++iWorker)
+      vBegin.push_back(vBegin.back() + GetWorkerShare(iToys,iWorkers,iWorker));
+
+    auto task = [&](unsigned int iWorker) -> TObject*
+      {
+	// independent copy of the model (made once per call and worker)
+	ModelClone& clone = GetWorkerModel(mc,iWorker);
+	RooAbsPdf* pPDF = clone.GetModel().GetPdf();
+	const RooArgSet* pObs = clone.GetModel().GetObservables();
+	RooArgSet* allParams = pPDF->getParameters(data);
+	RooArgSet globalObs;
+	if(clone.GetModel().GetGlobalObservables())
+	  globalObs.add(*clone.GetModel().GetGlobalObservables());
+	// binned toys for large datasets (see SetBinnedFits)
+	const bool bBinned = pPDF->canBeExtended() && SetToyBinning(*pObs,data);
+	ToyGenerator generator(*pPDF,*pObs,bBinned,false,&globalObs);
+	// global observables are generated on their own as well (the toys only depend on their seeds)
+	ToyGenerator globalGenerator(*pPDF,globalObs,false,false,pObs);
+
+	CountedTestStat profll(*pPDF,eTestStat);
+
+	std::vector<double> vValues;
+	{
+	  GenerationTimer timer;
+	  // the toy seeds must not change the random sequence of the caller
+	  RandomStateGuard guard;
+	  for(unsigned int i = vBegin[iWorker]; i < vBegin[iWorker + 1]; ++i)
+	  {
+	    // generation and fits start from the same values for every toy
+	    allParams->assignValueOnly(*pGenValues);
+	    RooRandom::randomGenerator()->SetSeed(GetToySeed(iSeed,iKey,iFirstToy + i));
+	    // global observables are part of the toy as for the ToyMCSampler (same distribution as in the store)
+	    if(globalObs.getSize() > 0)
+	      globalObs.assignValueOnly(globalGenerator.GenerateEvent());
+	    vValues.push_back(profll.Evaluate(generator.Generate(),*pNullPOI));
+	  }
+	}
+	AddToys(vValues.size());
+	delete allParams;
+
+	return new SamplingDistribution("ToyShard","toys of shard",vValues,profll.GetVarName());
+      };
+
+    // distributions of the workers in the order of the toy indices
+    PrepareWorkerModels(mc,iWorkers);
+    std::vector<TObject*> vResults = RunWorkers(iWorkers,task);
+    SamplingDistribution* pDist = 0;
+    bool bFailed = false;
+    for(auto pObj : vResults)
+    {
+      SamplingDistribution* pPartial = (SamplingDistribution*)pObj;
+      if(!pPartial)
+	bFailed = true;
+      else if(!pDist)
+	pDist = pPartial;
+      else
+      {
+	pDist->Add(pPartial);
+	delete pPartial;
+      }
+    }
+
+    delete pNullPOI;
+    delete pGenValues;
+
+    // toys of a failed worker cannot be replaced without changing the toy indices
+    if(bFailed)
+    {
+      delete pDist;
+      return 0;
+    }
+
+    return pDist;
+  }
+}
@@ -0,0 +1,130 @@
+#ifndef CG_TOYENGINE_H
+#define CG_TOYENGINE_H
+
+#include "RtypesCore.h"
+
+class RooAbsData;
+class RooArgSet;
+namespace RooStats
+{
+  class ModelConfig;
+  class HypoTestResult;
+  class SamplingDistribution;
+}
+
+namespace CG_Statistics
+{
+  class TestStatSketch;
+
+  // flavours of the profile likelihood ratio test statistic
+  enum TESTSTAT {eTWOSIDED = 0, eONESIDED = 1, eDISCOVERY = 2};
+
+  // toy-based hypothesis test of poi = dNullPOI against poi = dAltPOI
+  //
+  // The toys are spread over iWorkers parallel workers (see RunWorkers). Each worker generates its share of
+  // the iNullToys and iAltToys toys with its own copy of the model (reused within the outermost call, see
+  // ModelClonePool) and the profile likelihood ratio of the given flavour as test statistic. The partial
+  // results are merged into one HypoTestResult with the alternate hypothesis treated as background (i.e.
+  // CLsplusb = null p-value, CLb = alternate p-value).
+  //
+  // If a sampling distribution store is opened (see SetSamplingDistStore), the toys are generated with the
+  // nuisance parameters fixed to the values given to the store or profiled on the observed data. Stored toys
+  // for the same model, test statistic and parameter values are reused and only the missing number of toys
+  // is generated with a new seed and added to the store (by the owning process, see SamplingDistStore).
+  //
+  // In sketch mode (see SetToySketches) the toys are accumulated with FillToySketches instead and the
+  // returned result holds the sketches as binned sampling distributions (one entry per sketch bin, see
+  // TestStatSketch::GetSamplingDistribution). This also applies to RunSequentialToyHypoTest.
+  //
+  // The caller takes ownership of the returned result (0 if all workers failed).
+  RooStats::HypoTestResult* RunToyHypoTest(RooAbsData& data,
+					   const RooStats::ModelConfig& mc,
+					   double dNullPOI,
+					   double dAltPOI,
+					   TESTSTAT eTestStat,
+					   unsigned int iNullToys,
+					   unsigned int iAltToys,
+					   unsigned int iWorkers);
+
+  // sequential toy-based test of poi = dNullPOI (toys are only generated for the null hypothesis)
+  //
+  // Toys are generated in blocks of iBlockToys until either iMaxToys toys are reached or the Clopper-Pearson
+  // interval of the null p-value (at confidence level dStopConf) lies completely above or below dTarget.
+  // Points far away from dTarget are hence decided with few toys while points close to it get all toys.
+  // With a sampling distribution store, the stored toys are looked up once and count towards iMaxToys, and
+  // the new toys of all blocks are added to the store once at the end.
+  //
+  // The caller takes ownership of the returned result (0 if all workers failed).
+  RooStats::HypoTestResult* RunSequentialToyHypoTest(RooAbsData& data,
+						     const RooStats::ModelConfig& mc,
+						     double dNullPOI,
+						     double dAltPOI,
+						     TESTSTAT eTestStat,
+						     double dTarget,
+						     unsigned int iMaxToys,
+						     unsigned int iBlockToys,
+						     unsigned int iWorkers,
+						     double dStopConf = 0.999);
+
+  // toys of RunToyHypoTest (without sampling distribution store) accumulated in sketches
+  //
+  // The toys are generated in blocks of iBlockToys (0 or more than 100000 = 100000) and each block is
+  // discarded after filling its test statistics into the given sketches, so the memory does not depend on
+  // the number of toys. With dTarget >= 0 the generation stops early as in RunSequentialToyHypoTest.
+  // Returns the observed value of the test statistic.
+  double FillToySketches(RooAbsData& data,
+			 const RooStats::ModelConfig& mc,
+			 double dNullPOI,
+			 double dAltPOI,
+			 TESTSTAT eTestStat,
+			 unsigned int iNullToys,
+			 unsigned int iAltToys,
+			 unsigned int iWorkers,
+			 unsigned int iBlockToys,
+			 TestStatSketch& nullSketch,
+			 TestStatSketch& altSketch,
+			 double dTarget = -1,
+			 double dStopConf = 0.999);
+
+  // importance sampled toy-based test of poi = dNullPOI
+  //
+  // The toys are generated in equal shares from iDensities densities with the POI equally spaced between
+  // dNullPOI and the best fit value (nuisance parameters profiled on the observed data at the respective
+  // POI value). The global observables are generated for every toy from the same density as its observables
+  // (as done by the ToyMCSampler) and each toy is weighted with the ratio of the null density and the mixture
+  // of all densities (joint densities of observables and global observables, i.e. including the constraint
+  // terms) such that the weighted null distribution estimates the distribution under the null hypothesis also
+  // far in its tail. The null p-value and its uncertainty follow from the weighted distribution. If the
+  // observed test statistic is 0, all toys are generated from the null hypothesis (unit weights).
+  //
+  // The caller takes ownership of the returned result (0 if all workers failed).
+  RooStats::HypoTestResult* RunImportanceSampledHypoTest(RooAbsData& data,
+							 const RooStats::ModelConfig& mc,
+							 double dNullPOI,
+							 TESTSTAT eTestStat,
+							 unsigned int iToys,
+							 unsigned int iWorkers,
+							 unsigned int iDensities = 3);
+
+  // toys with indices [iFirstToy ... iFirstToy + iToys) of the distribution of the test statistic at poi = dPOI
+  //
+  // The nuisance parameters are treated as by a sampling distribution store opened with pNuisanceValues and
+  // iKey is set to the store key of this distribution. Every toy (global observables as by the ToyMCSampler
+  // and observables) is generated with its own seed depending only on iSeed, the key and its index, and its
+  // fit starts from the generation values. The state of the random generator is restored afterwards. Hence,
+  // the values are the same no matter how the toys are split over calls and workers. The returned
+  // distribution holds the values in the order of the toy indices (0 if a worker failed, caller takes
+  // ownership).
+  RooStats::SamplingDistribution* RunToyShard(RooAbsData& data,
+					      const RooStats::ModelConfig& mc,
+					      double dPOI,
+					      TESTSTAT eTestStat,
+					      ULong64_t iFirstToy,
+					      unsigned int iToys,
+					      UInt_t iSeed,
+					      unsigned int iWorkers,
+					      const RooArgSet* pNuisanceValues,
+					      ULong64_t& iKey);
+}
+
+#endif // CG_TOYENGINE_H
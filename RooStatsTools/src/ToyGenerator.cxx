@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <cmath>
+
+#include "TRandom.h"
+
+#include "RooAbsData.h"
+#include "RooAbsPdf.h"
+#include "RooDataSet.h"
+#include "RooDataHist.h"
+#include "RooRandom.h"
+#include "RooArgSet.h"
+#include "RooGlobalFunc.h"
+using namespace RooFit;
+
+// custom include(s)
+#include "ToyGenerator.h"
+#include "Fingerprint.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // minimum number of events generated per batch of unbinned toys
+    const int iMinBatchEvents = 100000;
+  }
+
+  ToyGenerator::ToyGenerator(RooAbsPdf& pdf,
+			     const RooArgSet& observables,
+			     bool bBinned,
+			     bool bReuseContext,
+			     const RooArgSet* pGlobalObservables):
+    m_pdf(pdf),
+    m_observables(observables),
+    m_pParams(pdf.getParameters(observables)),
+    m_bReuseContext(bReuseContext),
+    m_pBinnedToy(0),
+    m_pUnbinnedToy(0),
+    m_mExpected(),
+    m_pGenSpec(0),
+    m_iGenSpecHash(0),
+    m_dExpectedEvents(0),
+    m_iBatchEvents(0),
+    m_pBatch(0),
+    m_iBatchPos(0)
+  {
+    if(pGlobalObservables)
+      m_pParams->remove(*pGlobalObservables,kTRUE,kTRUE);
+
+    // pooled toy with the binning of the observables
+    if(bBinned && pdf.canBeExtended())
+      m_pBinnedToy = new RooDataHist("toy","toy",m_observables);
+    else if(m_bReuseContext)
+      PrepareBatches();
+  }
+
+  ToyGenerator::~ToyGenerator()
+  {
+    delete m_pBatch;
+    delete m_pGenSpec;
+    delete m_pUnbinnedToy;
+    delete m_pBinnedToy;
+    delete m_pParams;
+  }
+
+  void ToyGenerator::PrepareBatches()
+  {
+    delete m_pBatch;
+    m_pBatch = 0;
+    m_iBatchPos = 0;
+    delete m_pGenSpec;
+
+    // one batch holds at least one toy with an upward fluctuation of 5 sigma
+    m_dExpectedEvents = m_pdf.canBeExtended() ? m_pdf.expectedEvents(m_observables) : 1;
+    m_iBatchEvents = std::max(iMinBatchEvents,(int)(m_dExpectedEvents + 5 * sqrt(m_dExpectedEvents)) + 10);
+    m_pGenSpec = m_pdf.prepareMultiGen(m_observables,NumEvents(m_iBatchEvents));
+    m_iGenSpecHash = GetValuesHash(*m_pParams);
+  }
+
+  const std::vector<double>& ToyGenerator::GetExpectedContents()
+  {
+    std::vector<double>& vExpected = m_mExpected[GetValuesHash(*m_pParams)];
+    if(!vExpected.empty())
+      return vExpected;
+
+    // pdf value times bin volume (normalised to the expected number of events)
+    RooArgSet* pObs = m_pdf.getObservables(*m_pBinnedToy);
+    double dSum = 0;
+    for(int i = 0; i < m_pBinnedToy->numEntries(); ++i)
+    {
+      *pObs = *m_pBinnedToy->get(i);
+      vExpected.push_back(m_pdf.getVal(pObs) * m_pBinnedToy->binVolume());
+      dSum += vExpected.back();
+    }
+
+    const double dExpectedEvents = m_pdf.expectedEvents(pObs);
+    for(auto& dContent : vExpected)
+      dContent *= (dSum > 0) ? dExpectedEvents / dSum : 0;
+    delete pObs;
+
+    return vExpected;
+  }
+
+  RooAbsData& ToyGenerator::Generate()
+  {
+    TRandom* pRandom = RooRandom::randomGenerator();
+
+    // unbinned toy generated on its own
+    if(!m_pBinnedToy && !m_bReuseContext)
+    {
+      delete m_pUnbinnedToy;
+      m_pUnbinnedToy = m_pdf.canBeExtended() ? m_pdf.generate(m_observables,Extended()) : m_pdf.generate(m_observables,1);
+      return *m_pUnbinnedToy;
+    }
+
+    // unbinned toy from the current batch of events
+    if(!m_pBinnedToy)
+    {
+      // context and batch only hold events for the parameter values they were set up with
+      if(GetValuesHash(*m_pParams) != m_iGenSpecHash)
+	PrepareBatches();
+
+      const int iEvents = m_pdf.canBeExtended() ? pRandom->Poisson(m_dExpectedEvents) : 1;
+      RooDataSet* pSource = 0;
+      int iFirst = 0;
+      // extreme upward fluctuation beyond the size of a batch
+      if(iEvents > m_iBatchEvents)
+	pSource = m_pdf.generate(m_observables,NumEvents(iEvents));
+      else
+      {
+	if(!m_pBatch || (m_iBatchPos + iEvents > m_pBatch->numEntries()))
+	{
+	  delete m_pBatch;
+	  m_pBatch = m_pdf.generate(*m_pGenSpec);
+	  m_iBatchPos = 0;
+	}
+	pSource = m_pBatch;
+	iFirst = m_iBatchPos;
+	m_iBatchPos += iEvents;
+      }
+
+      // refill pooled toy (keeps its allocated memory)
+      if(!m_pUnbinnedToy)
+	m_pUnbinnedToy = new RooDataSet("toy","toy",m_observables);
+      else
+	m_pUnbinnedToy->reset();
+      for(int i = iFirst; i < iFirst + iEvents; ++i)
+	m_pUnbinnedToy->add(*pSource->get(i));
+
+      if(pSource != m_pBatch)
+	delete pSource;
+
+      return *m_pUnbinnedToy;
+    }
+
+    // regenerate bin contents in place
+    const std::vector<double>& vExpected = GetExpectedContents();
+    for(unsigned int i = 0; i < vExpected.size(); ++i)
+    {
+      m_pBinnedToy->get(i);
+      m_pBinnedToy->set(pRandom->Poisson(vExpected[i]));
+    }
+
+    return *m_pBinnedToy;
+  }
+
+  const RooArgSet& ToyGenerator::GenerateEvent()
+  {
+    // event generated on its own
+    if(!m_bReuseContext)
+    {
+      delete m_pUnbinnedToy;
+      m_pUnbinnedToy = m_pdf.generate(m_observables,1);
+      return *m_pUnbinnedToy->get(0);
+    }
+
+    // next event of the current batch
+    if(!m_pGenSpec || (GetValuesHash(*m_pParams) != m_iGenSpecHash))
+      PrepareBatches();
+    if(!m_pBatch || (m_iBatchPos >= m_pBatch->numEntries()))
+    {
+      delete m_pBatch;
+      m_pBatch = m_pdf.generate(*m_pGenSpec);
+      m_iBatchPos = 0;
+    }
+
+    return *m_pBatch->get(m_iBatchPos++);
+  }
+}
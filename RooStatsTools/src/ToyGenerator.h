@@ -0,0 +1,75 @@
+#ifndef CG_TOYGENERATOR_H
+#define CG_TOYGENERATOR_H
+
+#include <map>
+#include <vector>
+
+#include "RtypesCore.h"
+#include "RooArgSet.h"
+#include "RooAbsPdf.h"
+
+class RooAbsData;
+class RooDataSet;
+class RooDataHist;
+
+namespace CG_Statistics
+{
+  // generator for many toy datasets of the same pdf
+  //
+  // Binned toys (extended pdfs only) are regenerated in place in one pooled RooDataHist: the expected bin
+  // contents are computed once per set of parameter values (cached by their hash) and each toy only draws
+  // one Poisson number per bin. Unbinned toys are refilled in one pooled RooDataSet: events are generated in
+  // batches for many toys with a generator context which is set up once (RooAbsPdf::prepareMultiGen) and
+  // each toy takes the next N events of the batch (N drawn from a Poisson distribution for extended pdfs,
+  // N = 1 otherwise). The generator context and the batch are renewed whenever the parameter values of the
+  // pdf changed since they were set up, so one generator should be used per set of parameter values. With
+  // bReuseContext = false, each unbinned toy is generated on its own and only depends on the state of the
+  // random generator when it is generated (e.g. for per-toy seeds). The returned toy is owned by the
+  // generator and overwritten by the next call.
+  class ToyGenerator
+  {
+  public:
+    // bBinned: generate binned toys with the current binning of the observables
+    // pGlobalObservables: parameters which do not change the distribution of the observables (e.g. global
+    // observables generated for every toy) and are hence ignored when checking for new parameter values
+    ToyGenerator(RooAbsPdf& pdf,
+		 const RooArgSet& observables,
+		 bool bBinned,
+		 bool bReuseContext = true,
+		 const RooArgSet* pGlobalObservables = 0);
+    ~ToyGenerator();
+
+    // toy dataset for the current parameter values of the pdf
+    RooAbsData& Generate();
+    // one unbinned event for the current parameter values of the pdf (also for extended pdfs, e.g. global
+    // observables generated for every toy); the event is owned by the generator
+    const RooArgSet& GenerateEvent();
+
+  private:
+    ToyGenerator(const ToyGenerator&);
+    ToyGenerator& operator=(const ToyGenerator&);
+
+    // expected bin contents for the current parameter values
+    const std::vector<double>& GetExpectedContents();
+
+    // set up generator context for batches of events with the current parameter values
+    void PrepareBatches();
+
+    RooAbsPdf& m_pdf;
+    RooArgSet m_observables;
+    RooArgSet* m_pParams;
+    bool m_bReuseContext;
+    RooDataHist* m_pBinnedToy;
+    RooDataSet* m_pUnbinnedToy;
+    std::map<ULong64_t,std::vector<double> > m_mExpected;
+    // batches of unbinned events
+    RooAbsPdf::GenSpec* m_pGenSpec;
+    ULong64_t m_iGenSpecHash;
+    double m_dExpectedEvents;
+    int m_iBatchEvents;
+    RooDataSet* m_pBatch;
+    int m_iBatchPos;
+  };
+}
+
+#endif // CG_TOYGENERATOR_H
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TString.h"
+#include "TObjArray.h"
+#include "TVectorD.h"
+
+#include "RooAbsData.h"
+#include "RooRealVar.h"
+using namespace RooFit;
+
+#include "RooStats/ModelConfig.h"
+#include "RooStats/SamplingDistribution.h"
+using namespace RooStats;
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "ToyEngine.h"
+#include "SamplingDistStore.h"
+#include "Instrumentation.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    const char* sShardPrefix = "shard_";
+
+    // toys of one shard for one distribution
+    struct ShardPart
+    {
+      ULong64_t iFirstToy;
+      ULong64_t iToys;
+      UInt_t iSeed;
+      SamplingDistribution* pDist;
+    };
+
+    bool FirstToyLess(const ShardPart& a,const ShardPart& b)
+    {
+      return a.iFirstToy < b.iFirstToy;
+    }
+  }
+
+  bool GenerateToyShard(const char* sFileName,
+			RooAbsData& data,
+			ModelConfig& mc,
+			TOYTARGET eTarget,
+			const std::vector<double>& vPOIs,
+			ULong64_t iFirstToy,
+			unsigned int iToys,
+			unsigned int iSeed,
+			unsigned int iWorkers,
+			const RooArgSet* pNuisanceValues)
+  {
+    CallScope scope;
+
+    // test statistic used by the target function
+    const TESTSTAT eTestStat = (eTarget == eSIGNIFICANCE) ? eDISCOVERY : eTWOSIDED;
+
+    TFile* pFile = TFile::Open(sFileName,"RECREATE");
+    if(!pFile || pFile->IsZombie())
+    {
+      if(iVERBOSITY >= eERROR)
+	std::cerr << "failed to create shard file '" << sFileName << "'" << std::endl;
+      delete pFile;
+      return false;
+    }
+
+    bool bSuccess = true;
+    for(double dPOI : vPOIs)
+    {
+      if(iVERBOSITY >= eINFO)
+	std::cout << "generate toys " << iFirstToy << " ... " << iFirstToy + iToys - 1 << " for "
+		  << mc.GetParametersOfInterest()->first()->GetName() << " = " << dPOI << std::endl;
+
+      ULong64_t iKey = 0;
+      SamplingDistribution* pDist = RunToyShard(data,mc,dPOI,eTestStat,iFirstToy,iToys,iSeed,iWorkers,pNuisanceValues,iKey);
+      if(!pDist)
+      {
+	bSuccess = false;
+	continue;
+      }
+
+      // range of toy indices and seed
+      TVectorD range(3);
+      range[0] = iFirstToy;
+      range[1] = iToys;
+      range[2] = iSeed;
+
+      TObjArray entry(2);
+      entry.Add(pDist);
+      entry.Add(&range);
+      pFile->WriteTObject(&entry,TString::Format("%s%016llx",sShardPrefix,(unsigned long long)iKey),"WriteDelete");
+      delete pDist;
+    }
+
+    pFile->Close();
+    delete pFile;
+
+    return bSuccess;
+  }
+
+  bool MergeToyShards(const std::vector<std::string>& vShardFiles,const char* sStoreFile)
+  {
+    // parts of all distributions (by store key)
+    std::map<ULong64_t,std::vector<ShardPart> > mParts;
+    bool bSuccess = true;
+    for(auto& sShardFile : vShardFiles)
+    {
+      TFile* pFile = TFile::Open(sShardFile.c_str(),"READ");
+      if(!pFile || pFile->IsZombie())
+      {
+	if(iVERBOSITY >= eERROR)
+	  std::cerr << "failed to open shard file '" << sShardFile << "'" << std::endl;
+	delete pFile;
+	bSuccess = false;
+	continue;
+      }
+
+      TIter next(pFile->GetListOfKeys());
+      TKey* pKey = 0;
+      while((pKey = (TKey*)next()))
+      {
+	TString sName = pKey->GetName();
+	if(!sName.BeginsWith(sShardPrefix))
+	  continue;
+
+	TObjArray* pEntry = 0;
+	pFile->GetObject(sName,pEntry);
+	if(!pEntry)
+	  continue;
+	pEntry->SetOwner(kTRUE);
+
+	SamplingDistribution* pDist = dynamic_cast<SamplingDistribution*>(pEntry->At(0));
+	TVectorD* pRange = dynamic_cast<TVectorD*>(pEntry->At(1));
+	if(pDist && pRange && (pRange->GetNrows() == 3))
+	{
+	  ShardPart part = {(ULong64_t)(*pRange)[0],(ULong64_t)(*pRange)[1],(UInt_t)(*pRange)[2],pDist};
+	  pEntry->RemoveAt(0);
+	  mParts[strtoull(sName.Data() + strlen(sShardPrefix),0,16)].push_back(part);
+	}
+	delete pEntry;
+      }
+
+      pFile->Close();
+      delete pFile;
+    }
+
+    SamplingDistStore store;
+    if(!store.Open(sStoreFile))
+      bSuccess = false;
+
+    // concatenate parts in the order of the toy indices (toys 0 ... N - 1 without gaps)
+    for(auto& entry : mParts)
+    {
+      std::vector<ShardPart>& vParts = entry.second;
+      std::sort(vParts.begin(),vParts.end(),FirstToyLess);
+
+      SamplingDistribution* pMerged = 0;
+      ULong64_t iNextToy = 0;
+      bool bValid = true;
+      for(auto& part : vParts)
+      {
+	if((part.iFirstToy != iNextToy) || (part.iSeed != vParts.front().iSeed))
+	{
+	  bValid = false;
+	  break;
+	}
+
+	if(!pMerged)
+	  pMerged = (SamplingDistribution*)part.pDist->Clone();
+	else
+	  pMerged->Add(part.pDist);
+	iNextToy += part.iToys;
+      }
+
+      if(!bValid)
+      {
+	if(iVERBOSITY >= eERROR)
+	  std::cerr << "shards of distribution " << TString::Format("%016llx",(unsigned long long)entry.first)
+		    << " have gaps, overlaps or different seeds" << std::endl;
+	bSuccess = false;
+      }
+      else if(pMerged && store.IsOpen())
+      {
+	store.Put(entry.first,*pMerged,TString::Format("%u:%llu",vParts.front().iSeed,(unsigned long long)iNextToy));
+	if(iVERBOSITY >= eINFO)
+	  std::cout << "merged " << iNextToy << " toys of distribution " << TString::Format("%016llx",(unsigned long long)entry.first) << std::endl;
+      }
+
+      delete pMerged;
+      for(auto& part : vParts)
+	delete part.pDist;
+    }
+
+    return bSuccess;
+  }
+}
@@ -0,0 +1,231 @@
+// system include(s)
+#include <iostream>
+#include <exception>
+#include <cassert>
+#include <cstdio>
+#include <cstdint>
+#include "unistd.h"
+#include "sys/types.h"
+#include "sys/wait.h"
+
+// ROOT include(s)
+#include "TObject.h"
+#include "TList.h"
+#include "TBufferFile.h"
+
+// RooFit include(s)
+#include "RooRandom.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+#include "WorkerPool.h"
+#include "Instrumentation.h"
+#include "SamplingDistStore.h"
+
+namespace CG_Statistics
+{
+  namespace
+  {
+    // write a block of bytes to a file descriptor
+    bool WriteBytes(int fd,const char* pData,uint64_t iSize)
+    {
+      while(iSize > 0)
+      {
+	ssize_t iWritten = write(fd,pData,iSize);
+	if(iWritten <= 0)
+	  return false;
+	pData += iWritten;
+	iSize -= iWritten;
+      }
+
+      return true;
+    }
+
+    // read a block of bytes from a file descriptor
+    bool ReadBytes(int fd,char* pData,uint64_t iSize)
+    {
+      while(iSize > 0)
+      {
+	ssize_t iRead = read(fd,pData,iSize);
+	if(iRead <= 0)
+	  return false;
+	pData += iRead;
+	iSize -= iRead;
+      }
+
+      return true;
+    }
+
+    // stream object through pipe (prefixed by its size, 0 = no object)
+    bool SendObject(int fd,const TObject* pObj)
+    {
+      TBufferFile buf(TBuffer::kWrite);
+      if(pObj)
+	buf.WriteObject(pObj);
+
+      uint64_t iSize = pObj ? buf.Length() : 0;
+      if(!WriteBytes(fd,(const char*)&iSize,sizeof(iSize)))
+	return false;
+
+      return WriteBytes(fd,buf.Buffer(),iSize);
+    }
+
+    // receive object streamed by SendObject
+    TObject* ReceiveObject(int fd)
+    {
+      uint64_t iSize = 0;
+      if(!ReadBytes(fd,(char*)&iSize,sizeof(iSize)) || (iSize == 0))
+	return 0;
+
+      std::vector<char> vBytes(iSize);
+      if(!ReadBytes(fd,&vBytes[0],iSize))
+	return 0;
+
+      TBufferFile buf(TBuffer::kRead,iSize,&vBytes[0],kFALSE);
+      return buf.ReadObject(TObject::Class());
+    }
+  }
+
+  unsigned int GetNWorkers(unsigned int iWorkers)
+  {
+    if(iWorkers > 0)
+      return iWorkers;
+
+    long iCores = sysconf(_SC_NPROCESSORS_ONLN);
+    return (iCores > 0) ? (unsigned int)iCores : 1;
+  }
+
+  unsigned int GetWorkerShare(unsigned int iTotal,unsigned int iWorkers,unsigned int iWorker)
+  {
+    assert(iWorker < iWorkers);
+    return iTotal / iWorkers + ((iWorker < iTotal % iWorkers) ? 1 : 0);
+  }
+
+  std::vector<TObject*> RunWorkers(unsigned int iWorkers,
+				   const std::function<TObject*(unsigned int)>& task)
+  {
+    iWorkers = GetNWorkers(iWorkers);
+    std::vector<TObject*> vResults(iWorkers,(TObject*)0);
+
+    // nothing to distribute
+    if(iWorkers == 1)
+    {
+      vResults[0] = task(0);
+      return vResults;
+    }
+
+    // draw seeds of workers from global generator to keep results reproducible
+    const UInt_t iBaseSeed = RooRandom::randomGenerator()->Integer(kMaxUInt);
+
+    // avoid duplicated output from buffers inherited by the child processes
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(0);
+
+    std::vector<pid_t> vPIDs(iWorkers,-1);
+    std::vector<int> vPipes(iWorkers,-1);
+    for(unsigned int iWorker = 0; iWorker < iWorkers; ++iWorker)
+    {
+      int fds[2];
+      if(pipe(fds) != 0)
+      {
+	if(iVERBOSITY >= eERROR)
+	  std::cerr << "failed to create pipe for worker " << iWorker << std::endl;
+	continue;
+      }
+
+      pid_t pid = fork();
+      // child process
+      if(pid == 0)
+      {
+	close(fds[0]);
+	for(unsigned int iOther = 0; iOther < iWorker; ++iOther)
+	{
+	  if(vPipes[iOther] >= 0)
+	    close(vPipes[iOther]);
+	}
+
+	// individual seed per worker (0 would be replaced by a time dependent seed)
+	UInt_t iSeed = iBaseSeed + iWorker + 1;
+	RooRandom::randomGenerator()->SetSeed(iSeed ? iSeed : 1);
+
+	// only count the work done by this worker and only send back its own new store entries
+	SetProcessPerfCounters(PerfCounters());
+	delete SamplingDistStore::Instance().TakePending();
+
+	int iStatus = 1;
+	try
+	{
+	  // result followed by performance counters and entries for the sampling distribution store
+	  TObject* pResult = task(iWorker);
+	  const PerfCounters counters = GetProcessPerfCounters();
+	  TList* pPending = SamplingDistStore::Instance().TakePending();
+	  iStatus = (SendObject(fds[1],pResult) && WriteBytes(fds[1],(const char*)&counters,sizeof(counters)) &&
+		     SendObject(fds[1],pPending)) ? 0 : 1;
+	}
+	catch(std::exception& e)
+	{
+	  if(iVERBOSITY >= eERROR)
+	    std::cerr << "worker " << iWorker << " failed: " << e.what() << std::endl;
+	}
+	catch(...)
+	{
+	  if(iVERBOSITY >= eERROR)
+	    std::cerr << "worker " << iWorker << " failed" << std::endl;
+	}
+	close(fds[1]);
+
+	// skip atexit handlers and destructors of the state inherited from the parent
+	std::cout.flush();
+	_exit(iStatus);
+      }
+      // parent process
+      close(fds[1]);
+      if(pid < 0)
+      {
+	if(iVERBOSITY >= eERROR)
+	  std::cerr << "failed to fork worker " << iWorker << std::endl;
+	close(fds[0]);
+	continue;
+      }
+      vPIDs[iWorker] = pid;
+      vPipes[iWorker] = fds[0];
+    }
+
+    // collect results (remaining workers block on writing until it is their turn)
+    for(unsigned int iWorker = 0; iWorker < iWorkers; ++iWorker)
+    {
+      if(vPIDs[iWorker] < 0)
+	continue;
+
+      vResults[iWorker] = ReceiveObject(vPipes[iWorker]);
+      PerfCounters counters;
+      if(ReadBytes(vPipes[iWorker],(char*)&counters,sizeof(counters)))
+      {
+	AddProcessPerfCounters(counters);
+
+	// written by this process if it owns the store, otherwise passed on to its parent
+	TList* pPending = (TList*)ReceiveObject(vPipes[iWorker]);
+	if(pPending)
+	{
+	  pPending->SetOwner(kTRUE);
+	  SamplingDistStore::Instance().AddPending(*pPending);
+	  delete pPending;
+	}
+      }
+      close(vPipes[iWorker]);
+
+      int iStatus = 0;
+      waitpid(vPIDs[iWorker],&iStatus,0);
+      if(!WIFEXITED(iStatus) || (WEXITSTATUS(iStatus) != 0))
+      {
+	if(iVERBOSITY >= eERROR)
+	  std::cerr << "worker " << iWorker << " did not finish successfully" << std::endl;
+	delete vResults[iWorker];
+	vResults[iWorker] = 0;
+      }
+    }
+
+    return vResults;
+  }
+}
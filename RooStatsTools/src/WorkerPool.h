@@ -0,0 +1,31 @@
+#ifndef CG_WORKERPOOL_H
+#define CG_WORKERPOOL_H
+
+#include <vector>
+#include <functional>
+
+class TObject;
+
+namespace CG_Statistics
+{
+  // number of workers to use for a requested worker count (0 = one worker per CPU core)
+  unsigned int GetNWorkers(unsigned int iWorkers);
+
+  // run a task in parallel worker processes and collect the returned objects
+  //
+  // The task is called once per worker with the worker index (0 ... iWorkers - 1). For more than one
+  // worker, each call happens in a forked child process with an individual seed for RooRandom, so
+  // the workers share nothing but the state of the parent at the time of the fork. The object returned
+  // by the task is streamed back to the parent process together with the performance counters of the
+  // worker, which are added to the counters of the parent, and the new entries of the sampling distribution
+  // store, which are written by the parent (see SamplingDistStore). A single worker runs the task in-process.
+  //
+  // The caller takes ownership of the returned objects. Workers which failed yield a null pointer.
+  std::vector<TObject*> RunWorkers(unsigned int iWorkers,
+				   const std::function<TObject*(unsigned int)>& task);
+
+  // share of a total number of items assigned to the given worker
+  unsigned int GetWorkerShare(unsigned int iTotal,unsigned int iWorkers,unsigned int iWorker);
+}
+
+#endif // CG_WORKERPOOL_H
@@ -0,0 +1,423 @@
+// system include(s)
+#include <iostream>
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include "unistd.h"
+#include "sys/types.h"
+#include "sys/wait.h"
+#include "sys/resource.h"
+
+// ROOT include(s)
+#include "TObject.h"
+#include "TString.h"
+
+// RooFit include(s)
+#include "RooWorkspace.h"
+#include "RooArgSet.h"
+#include "RooDataSet.h"
+#include "RooRealVar.h"
+#include "RooAbsPdf.h"
+#include "RooRandom.h"
+#include "RooMsgService.h"
+
+// RooStats include(s)
+#include "RooStats/ModelConfig.h"
+#include "RooStats/LikelihoodInterval.h"
+#include "RooStats/HypoTestResult.h"
+#include "RooStats/HypoTestInverterResult.h"
+#include "RooStats/SamplingDistribution.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+
+using namespace RooFit;
+using namespace RooStats;
+using namespace CG_Statistics;
+
+// benchmark model: workspace, model config with snapshot at POI = 0 and observed dataset
+struct BenchModel
+{
+  std::string sName;
+  RooWorkspace* pWS;
+  ModelConfig* pMC;
+  RooAbsData* pData;
+  double dLow;              // scan range for FC intervals
+  double dHigh;
+  bool bLarge;              // large dataset (only runs comparing NLL implementations)
+};
+
+// single benchmark run: function returns the number of generated toys
+struct BenchRun
+{
+  std::string sFunction;
+  std::string sMode;
+  std::function<unsigned int(BenchModel&)> run;
+  bool bLarge;              // also run for models with large datasets
+};
+
+// number of toys stored in a hypothesis test result
+unsigned int GetNToys(const HypoTestResult* pResult)
+{
+  if(!pResult)
+    return 0;
+
+  unsigned int iToys = 0;
+  if(pResult->GetNullDistribution())
+    iToys += pResult->GetNullDistribution()->GetSize();
+  if(pResult->GetAltDistribution())
+    iToys += pResult->GetAltDistribution()->GetSize();
+
+  return iToys;
+}
+
+// number of toys stored in all points of a hypothesis test inversion
+unsigned int GetNToys(HypoTestInverterResult* pResult)
+{
+  if(!pResult)
+    return 0;
+
+  unsigned int iToys = 0;
+  for(int i = 0; i < pResult->ArraySize(); ++i)
+    iToys += GetNToys(pResult->GetResult(i));
+
+  return iToys;
+}
+
+// Gaussian model from GaussLimitPlot with one observed event at x = 1.5
+BenchModel BuildGaussModel()
+{
+  BenchModel model;
+  model.sName = "gauss";
+  model.pWS = new RooWorkspace("gauss");
+  model.pWS->factory("Gaussian:gaus(x[0,-10,10],mean[0,0,8],width[1])");
+
+  model.pMC = new ModelConfig("gauss",model.pWS);
+  model.pMC->SetPdf("gaus");
+  model.pMC->SetObservables("x");
+  model.pMC->SetParametersOfInterest("mean");
+  model.pWS->var("mean")->setVal(0);
+  model.pMC->SetSnapshot(*model.pMC->GetParametersOfInterest());
+
+  RooArgSet rObservables(*model.pWS->var("x"));
+  model.pData = new RooDataSet("data","data",rObservables);
+  model.pWS->var("x")->setVal(1.5);
+  model.pData->add(rObservables);
+
+  model.dLow = 0;
+  model.dHigh = 5;
+  model.bLarge = false;
+
+  return model;
+}
+
+// exponential background + Gaussian signal from the RooStats tutorial notebook with data generated for s = 10
+// (iScale = 1) or for background and signal scaled by iScale
+BenchModel BuildSumModel(unsigned int iScale = 1)
+{
+  BenchModel model;
+  model.sName = (iScale == 1) ? "expo+gauss" : TString::Format("expo+gauss-x%u",iScale).Data();
+  model.pWS = new RooWorkspace("ws");
+  model.pWS->factory("Exponential:e(x[0,500],tau[-0.01,-5,-0.001])");
+  model.pWS->factory("Gaussian::g(x,mean[250],sigma[15])");
+  model.pWS->factory(TString::Format("SUM::model(b[%u,0,%u]*e,s[%u,0,%u]*g)",1000 * iScale,5000 * iScale,10 * iScale,100 * iScale).Data());
+
+  model.pMC = new ModelConfig("model",model.pWS);
+  model.pMC->SetPdf("model");
+  model.pMC->SetObservables("x");
+  model.pMC->SetNuisanceParameters("tau,b");
+  model.pMC->SetParametersOfInterest("s");
+
+  // generate observed data with fixed seed
+  RooRandom::randomGenerator()->SetSeed(4357);
+  model.pData = model.pWS->pdf("model")->generate(RooArgSet(*model.pWS->var("x")));
+
+  model.pWS->var("s")->setVal(0);
+  model.pMC->SetSnapshot(*model.pMC->GetParametersOfInterest());
+  model.pWS->var("s")->setVal(10 * iScale);
+
+  model.dLow = 0;
+  model.dHigh = 60 * iScale;
+  model.bLarge = (iScale > 1);
+
+  return model;
+}
+
+// list of benchmarked entry points
+std::vector<BenchRun> GetBenchRuns(const unsigned int iToys,const unsigned int iWorkers)
+{
+  std::vector<BenchRun> vRuns;
+
+  vRuns.push_back({"GetLikelihoodInterval","asymptotic",[](BenchModel& m) -> unsigned int
+	{
+	  LikelihoodInterval* pInterval = GetLikelihoodInterval(*m.pData,*m.pMC,0.683);
+	  RooRealVar* pPOI = (RooRealVar*)m.pMC->GetParametersOfInterest()->first();
+	  pInterval->LowerLimit(*pPOI);
+	  pInterval->UpperLimit(*pPOI);
+	  delete pInterval;
+	  return 0;
+	}});
+
+  vRuns.push_back({"GetProfileLikelihoodScan","grid",[=](BenchModel& m) -> unsigned int
+	{
+	  delete GetProfileLikelihoodScan(*m.pData,*m.pMC,11,0.683,3,iWorkers);
+	  return 0;
+	}});
+
+  vRuns.push_back({"GetSignificance","asymptotic",[](BenchModel& m) -> unsigned int
+	{
+	  delete GetSignificance(*m.pData,*m.pMC,-1);
+	  return 0;
+	}});
+
+  vRuns.push_back({"GetSignificance","toys",[=](BenchModel& m) -> unsigned int
+	{
+	  HypoTestResult* pResult = GetSignificance(*m.pData,*m.pMC,iToys);
+	  unsigned int iGenerated = GetNToys(pResult);
+	  delete pResult;
+	  return iGenerated;
+	}});
+
+  vRuns.push_back({"GetSignificance","toys-importance",[=](BenchModel& m) -> unsigned int
+	{
+	  HypoTestResult* pResult = GetSignificance(*m.pData,*m.pMC,iToys,true);
+	  unsigned int iGenerated = GetNToys(pResult);
+	  delete pResult;
+	  return iGenerated;
+	}});
+
+  vRuns.push_back({"GetSignificance","toys-compiled",[=](BenchModel& m) -> unsigned int
+	{
+	  SetCompiledNLL(true);
+	  HypoTestResult* pResult = GetSignificance(*m.pData,*m.pMC,iToys);
+	  unsigned int iGenerated = GetNToys(pResult);
+	  delete pResult;
+	  return iGenerated;
+	}});
+
+  vRuns.push_back({"GetUpperLimit","asymptotic",[=](BenchModel& m) -> unsigned int
+	{
+	  delete GetUpperLimit(*m.pData,*m.pMC,true,0.95);
+	  return 0;
+	},true});
+
+  vRuns.push_back({"GetUpperLimit","asymptotic-batch",[=](BenchModel& m) -> unsigned int
+	{
+	  SetBatchNLL(true);
+	  delete GetUpperLimit(*m.pData,*m.pMC,true,0.95);
+	  return 0;
+	},true});
+
+  vRuns.push_back({"GetUpperLimit","asymptotic-gradient",[=](BenchModel& m) -> unsigned int
+	{
+	  SetAnalyticGradients(true);
+	  delete GetUpperLimit(*m.pData,*m.pMC,true,0.95);
+	  return 0;
+	},true});
+
+  vRuns.push_back({"GetUpperLimit","toys",[=](BenchModel& m) -> unsigned int
+	{
+	  HypoTestInverterResult* pResult = GetUpperLimit(*m.pData,*m.pMC,true,0.95,-1e6,1e6,0.05,10,iToys,iWorkers);
+	  unsigned int iGenerated = GetNToys(pResult);
+	  delete pResult;
+	  return iGenerated;
+	}});
+
+  vRuns.push_back({"GetExpectedLimits","asymptotic",[=](BenchModel& m) -> unsigned int
+	{
+	  GetExpectedLimits(*m.pData,*m.pMC,true,0.95);
+	  return 0;
+	}});
+
+  vRuns.push_back({"GetFCInterval","toys",[=](BenchModel& m) -> unsigned int
+	{
+#ifndef CG_EXPERIMENTAL
+	  HypoTestInverterResult* pResult = GetFCInterval(*m.pData,*m.pMC,0.683,m.dLow,m.dHigh,(m.dHigh - m.dLow)/10,iToys,iWorkers);
+#else
+	  HypoTestInverterResult* pResult = GetFCInterval(*m.pData,*m.pMC,0.683,3,m.dLow,m.dHigh,6,iToys,iWorkers);
+#endif // CG_EXPERIMENTAL
+	  unsigned int iGenerated = GetNToys(pResult);
+	  delete pResult;
+	  return iGenerated;
+	}});
+
+  vRuns.push_back({"GetFCInterval","toys-sequential",[=](BenchModel& m) -> unsigned int
+	{
+	  // toys in blocks of 10% of the maximum number of toys per point
+#ifndef CG_EXPERIMENTAL
+	  HypoTestInverterResult* pResult = GetFCInterval(*m.pData,*m.pMC,0.683,m.dLow,m.dHigh,(m.dHigh - m.dLow)/10,iToys,iWorkers,iToys/10);
+#else
+	  HypoTestInverterResult* pResult = GetFCInterval(*m.pData,*m.pMC,0.683,3,m.dLow,m.dHigh,6,iToys,iWorkers,iToys/10);
+#endif // CG_EXPERIMENTAL
+	  unsigned int iGenerated = GetNToys(pResult);
+	  delete pResult;
+	  return iGenerated;
+	}});
+
+  vRuns.push_back({"GetFCInterval","asymptotic",[=](BenchModel& m) -> unsigned int
+	{
+#ifndef CG_EXPERIMENTAL
+	  delete GetFCInterval(*m.pData,*m.pMC,0.683,m.dLow,m.dHigh,(m.dHigh - m.dLow)/10,iToys,iWorkers,0,eASYMPTOTIC);
+#else
+	  delete GetFCInterval(*m.pData,*m.pMC,0.683,3,m.dLow,m.dHigh,6,iToys,iWorkers,0,eASYMPTOTIC);
+#endif // CG_EXPERIMENTAL
+	  return 0;
+	}});
+
+  vRuns.push_back({"GetSamplingDist","toys",[=](BenchModel& m) -> unsigned int
+	{
+	  SamplingDistribution* pDist = GetSamplingDist(*m.pData,*m.pMC,iToys);
+	  unsigned int iGenerated = pDist ? pDist->GetSize() : 0;
+	  delete pDist;
+	  return iGenerated;
+	}});
+
+  vRuns.push_back({"GetSamplingDistSketch","toys",[=](BenchModel& m) -> unsigned int
+	{
+	  TestStatSketch* pSketch = GetSamplingDistSketch(*m.pData,*m.pMC,iToys,0.01,iWorkers);
+	  unsigned int iGenerated = pSketch ? pSketch->GetEntries() : 0;
+	  delete pSketch;
+	  return iGenerated;
+	}});
+
+  return vRuns;
+}
+
+// run benchmark in a child process (isolates peak memory and state changes) and print one result line
+bool RunBenchmark(BenchModel& model,BenchRun& run,const unsigned int iSeed)
+{
+  std::cout.flush();
+  fflush(0);
+
+  pid_t pid = fork();
+  if(pid < 0)
+    return false;
+
+  // child process
+  if(pid == 0)
+  {
+    RooRandom::randomGenerator()->SetSeed(iSeed);
+
+    auto start = std::chrono::steady_clock::now();
+    unsigned int iToys = run.run(model);
+    double dWall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // peak resident set size of this process and its worker processes (in kB)
+    struct rusage usage;
+    getrusage(RUSAGE_SELF,&usage);
+    long iPeakRSS = usage.ru_maxrss;
+    getrusage(RUSAGE_CHILDREN,&usage);
+    iPeakRSS = std::max(iPeakRSS,usage.ru_maxrss);
+
+    // fits counted by the library (including worker processes)
+    const long iFits = GetLastCallPerfCounters().iFits;
+    printf("%s\t%s\t%s\t%.3f\t%ld\t%.2f\t%u\t%.2f\t%ld\n",
+	   model.sName.c_str(),run.sFunction.c_str(),run.sMode.c_str(),dWall,
+	   iFits,iFits / dWall,
+	   iToys,iToys / dWall,iPeakRSS);
+    fflush(0);
+    _exit(0);
+  }
+
+  // parent process
+  int iStatus = 0;
+  waitpid(pid,&iStatus,0);
+
+  return WIFEXITED(iStatus) && (WEXITSTATUS(iStatus) == 0);
+}
+
+int main(int argc, char** argv)
+{
+  RooMsgService::instance().setGlobalKillBelow(ERROR);
+
+  // options to run benchmark
+  unsigned int iToys    = 1000;
+  unsigned int iWorkers = 1;
+  unsigned int iSeed    = 4357;
+  std::string sFilter   = "";
+  VERBOSITY verb        = eSILENT;
+
+  // parse options
+  int i;
+  while((i = getopt(argc,argv,"t:j:s:f:v:h")) != -1)
+  {
+    switch(i)
+    {
+    case 't':
+      iToys = atoi(optarg);
+      break;
+    case 'j':
+      iWorkers = atoi(optarg);
+      break;
+    case 's':
+      iSeed = atoi(optarg);
+      break;
+    case 'f':
+      sFilter = optarg;
+      break;
+    case 'v':
+      verb = (VERBOSITY)atoi(optarg);
+      break;
+    case 'h':
+    case '?':
+      std::cout << "usage: ./Benchmark -t <TOYS> -j <WORKERS> -s <SEED> -f <FILTER> -v <VERBOSITY>" << std::endl;
+      std::cout << std::endl;
+      std::cout << "options:" << std::endl;
+      std::cout << "-t TOYS   : number of toys for toy based calculations (default: 1000)" << std::endl;
+      std::cout << "-j WORKERS: number of parallel workers for toys (0 = one per CPU core) (default: 1)" << std::endl;
+      std::cout << "-s SEED   : random seed used for every run (default: 4357)" << std::endl;
+      std::cout << "-f FILTER : only run benchmarks whose function name contains FILTER (default: all)" << std::endl;
+      std::cout << "-v VERB   : verbosity level (0 ... silent to 4 .. debug mode) (default: 0)" << std::endl;
+      std::cout << "-h        : print this help message" << std::endl;
+      std::cout << std::endl;
+      std::cout << "output: one tab separated line per run with" << std::endl;
+      std::cout << "model function mode wall_s fits fits_per_s toys toys_per_s peak_rss_kb" << std::endl;
+      std::cout << "(fits done internally by RooStats, e.g. for likelihood intervals, are not counted)" << std::endl;
+      return 0;
+    default:
+      std::cerr << "got unknown option '" << i << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  iVERBOSITY = verb;
+
+  std::vector<BenchModel> vModels;
+  vModels.push_back(BuildGaussModel());
+  vModels.push_back(BuildSumModel());
+  // ~100000 events for comparing the NLL implementations
+  vModels.push_back(BuildSumModel(100));
+  std::vector<BenchRun> vRuns = GetBenchRuns(iToys,iWorkers);
+
+  printf("# model\tfunction\tmode\twall_s\tfits\tfits_per_s\ttoys\ttoys_per_s\tpeak_rss_kb\n");
+  int iFailed = 0;
+  for(auto& model : vModels)
+  {
+    for(auto& run : vRuns)
+    {
+      if(!sFilter.empty() && (run.sFunction.find(sFilter) == std::string::npos))
+	continue;
+      if(model.bLarge && !run.bLarge)
+	continue;
+
+      if(!RunBenchmark(model,run,iSeed))
+      {
+	std::cerr << "benchmark " << run.sFunction << " (" << run.sMode << ") failed for model " << model.sName << std::endl;
+	++iFailed;
+      }
+    }
+  }
+
+  // clean up
+  for(auto& model : vModels)
+  {
+    delete model.pData;
+    delete model.pMC;
+    delete model.pWS;
+  }
+
+  return (iFailed > 0) ? 1 : 0;
+}
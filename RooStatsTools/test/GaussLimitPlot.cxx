@@ -1,5 +1,6 @@
 // system include(s)
 #include <iostream>
+#include <vector>
 #include "unistd.h"
 
 // ROOT include(s)
@@ -25,7 +26,7 @@ using namespace RooFit;
 using namespace RooStats;
 using namespace CG_Statistics;
 
-void RunGaussLimits(const double xMin,const double xMax,const unsigned int iPoints,const double conf)
+void RunGaussLimits(const double xMin,const double xMax,const unsigned int iPoints,const double conf,const unsigned int iWorkers)
 {
   // check input
   assert(conf > 0);
@@ -63,59 +64,80 @@ void RunGaussLimits(const double xMin,const double xMax,const unsigned int iPoin
   RooArgSet rObservables(*w.var("x"));
   RooDataSet* pData = 0;
   RooRealVar* pPOI = (RooRealVar*)(mcGaus.GetParametersOfInterest()->first());
-  LikelihoodInterval* pInterval = 0;
-  HypoTestInverterResult* pCLs = 0;
-  HypoTestInverterResult* pCLsb = 0;
-  HypoTestInverterResult* pFCResult = 0;
+  std::vector<RooAbsData*> vData;
+  std::vector<double> vObs;
+  std::vector<double> vFCLow, vFCHigh, vLimitHigh;
+
+  // create dummy datasets
   for(unsigned int i = 0; i <= iPoints; ++i)
   {
-    std::cout << "\rstart " << i+1 << " of " << iPoints+1 << " points";
-    std::cout.flush();
-    
-    // create dummy dataset
     xObs = xMin + i * (xMax - xMin)/iPoints;
-    pData = new RooDataSet("data","data",rObservables);
+    pData = new RooDataSet(Form("data_%d",i),"data",rObservables);
     w.var("x")->setVal(xObs);
     pData->add(rObservables);
+    vData.push_back(pData);
+    vObs.push_back(xObs);
+    // scan ranges around the observed value
+    vFCLow.push_back(xObs - 3);
+    vFCHigh.push_back(xObs + 4);
+    vLimitHigh.push_back(xObs + 4);
+  }
 
-    // get likelihood interval without bound
-    pInterval = GetLikelihoodInterval(*pData,mcGaus,conf);
-    grLogL_up->SetPoint(i,xObs,pInterval->UpperLimit(*pPOI));
-    grLogL_down->SetPoint(i,xObs,pInterval->LowerLimit(*pPOI));
-    delete pInterval;
+  // get likelihood intervals without bound
+  std::cout << "calculate likelihood intervals for " << iPoints+1 << " points" << std::endl;
+  std::vector<LikelihoodInterval*> vIntervals = GetLikelihoodIntervals(vData,mcGaus,conf);
+  for(unsigned int i = 0; i <= iPoints; ++i)
+  {
+    grLogL_up->SetPoint(i,vObs[i],vIntervals[i]->UpperLimit(*pPOI));
+    grLogL_down->SetPoint(i,vObs[i],vIntervals[i]->LowerLimit(*pPOI));
+    delete vIntervals[i];
+  }
     
-    // get likelihood interval with bound
-    pPOI->setMin(0);
-    pInterval = GetLikelihoodInterval(*pData,mcGaus,conf);
-    grLogL_bound_up->SetPoint(i,xObs,pInterval->UpperLimit(*pPOI));
-    grLogL_bound_down->SetPoint(i,xObs,pInterval->LowerLimit(*pPOI));
-    pPOI->setMin(-5);
-    delete pInterval;
+  // get likelihood intervals with bound
+  std::cout << "calculate likelihood intervals with bound for " << iPoints+1 << " points" << std::endl;
+  pPOI->setMin(0);
+  vIntervals = GetLikelihoodIntervals(vData,mcGaus,conf);
+  for(unsigned int i = 0; i <= iPoints; ++i)
+  {
+    grLogL_bound_up->SetPoint(i,vObs[i],vIntervals[i]->UpperLimit(*pPOI));
+    grLogL_bound_down->SetPoint(i,vObs[i],vIntervals[i]->LowerLimit(*pPOI));
+    delete vIntervals[i];
+  }
+  pPOI->setMin(-5);
     
-    //get Feldman-Cousin interval
-    pPOI->setMin(0);
+  //get Feldman-Cousin intervals
+  std::cout << "calculate Feldman-Cousins intervals for " << iPoints+1 << " points" << std::endl;
+  pPOI->setMin(0);
 #ifndef CG_EXPERIMENTAL    
-    pFCResult = GetFCInterval(*pData,mcGaus,conf,xObs - 3,xObs + 4,0.1,10000);
+  std::vector<HypoTestInverterResult*> vFCResults = GetFCIntervals(vData,mcGaus,conf,vFCLow,vFCHigh,0.1,10000,iWorkers);
 #else
-    pFCResult = GetFCInterval(*pData,mcGaus,conf,3,-100,100,5,50000);
+  std::vector<HypoTestInverterResult*> vFCResults = GetFCIntervals(vData,mcGaus,conf,8,-100,100,5,50000,iWorkers);
 #endif // CG_EXPERIMENTAL    
-    grFC_up->SetPoint(i,xObs,pFCResult->UpperLimit());
-    grFC_down->SetPoint(i,xObs,TMath::AreEqualRel(pFCResult->LowerLimit(),pFCResult->UpperLimit(),1e-4) ? 0 : pFCResult->LowerLimit());
-    pPOI->setMin(-5);
-    delete pFCResult;
+  for(unsigned int i = 0; i <= iPoints; ++i)
+  {
+    assert(vFCResults[i]);
+    grFC_up->SetPoint(i,vObs[i],vFCResults[i]->UpperLimit());
+    grFC_down->SetPoint(i,vObs[i],TMath::AreEqualRel(vFCResults[i]->LowerLimit(),vFCResults[i]->UpperLimit(),1e-4) ? 0 : vFCResults[i]->LowerLimit());
+    delete vFCResults[i];
+  }
+  pPOI->setMin(-5);
 
-    // get CL(s+b) and CLs upper limit
-    pCLsb = GetUpperLimit(*pData,mcGaus,false,conf,xObs, xObs + 4);
-    pCLs = GetUpperLimit(*pData,mcGaus,true,conf,xObs, xObs + 4);
-    grCLsb->SetPoint(i,xObs,pCLsb->UpperLimit());
-    grCLs->SetPoint(i,xObs,pCLs->UpperLimit());
-    delete pCLsb;
-    delete pCLs;
-    
-    // clean up
-    delete pData;
+  // get CL(s+b) and CLs upper limits
+  std::cout << "calculate upper limits for " << iPoints+1 << " points" << std::endl;
+  std::vector<HypoTestInverterResult*> vCLsb = GetUpperLimits(vData,mcGaus,false,conf,vObs,vLimitHigh,0.01,20,-1,iWorkers);
+  std::vector<HypoTestInverterResult*> vCLs = GetUpperLimits(vData,mcGaus,true,conf,vObs,vLimitHigh,0.01,20,-1,iWorkers);
+  for(unsigned int i = 0; i <= iPoints; ++i)
+  {
+    assert(vCLsb[i] && vCLs[i]);
+    grCLsb->SetPoint(i,vObs[i],vCLsb[i]->UpperLimit());
+    grCLs->SetPoint(i,vObs[i],vCLs[i]->UpperLimit());
+    delete vCLsb[i];
+    delete vCLs[i];
   }
-  std::cout << std::endl;
+    
+  // clean up
+  for(auto pDataSet : vData)
+    delete pDataSet;
 
   // beautfiy graphs
   grLogL_up->SetLineWidth(2);
@@ -253,10 +275,11 @@ int main(int argc, char** argv)
   unsigned int iPoints = 61;
   double conf          = 0.95;
   VERBOSITY verb       = eSILENT;
+  unsigned int iWorkers = 1;
 
   // parse options
   int i;
-  while((i = getopt(argc,argv,"l:u:p:c:v:h")) != -1)
+  while((i = getopt(argc,argv,"l:u:p:c:v:j:h")) != -1)
   {
     switch(i)
     {
@@ -275,9 +298,12 @@ int main(int argc, char** argv)
     case 'v':
       verb = (VERBOSITY)atoi(optarg);
       break;
+    case 'j':
+      iWorkers = atoi(optarg);
+      break;
     case 'h':
     case '?':
-      std::cout << "usage: ./GaussLimitPlot -l <LOWER> -u <UPPER> -i <POINTS> -c <CONFIDENCE> -v <VERBOSITY>" << std::endl;
+      std::cout << "usage: ./GaussLimitPlot -l <LOWER> -u <UPPER> -i <POINTS> -c <CONFIDENCE> -v <VERBOSITY> -j <WORKERS>" << std::endl;
       std::cout << std::endl;
       std::cout << "options:" << std::endl;
       std::cout << "-l LOWER  : lower bound of observed values (default: -3)" << std::endl;
@@ -285,6 +311,7 @@ int main(int argc, char** argv)
       std::cout << "-p POINTS : number of points to scan (default: 61)" << std::endl;
       std::cout << "-c CONF   : confidence level 0 < CONF < 1 (default: 0.95)" << std::endl;
       std::cout << "-v VERB   : verbosity level (0 ... silent to 4 .. debug mode) (default: 0)" << std::endl;
+      std::cout << "-j WORKERS: number of parallel worker processes (0 = one per CPU core) (default: 1)" << std::endl;
       std::cout << "-h        : print this help message" << std::endl;
       return 0;
     default:
@@ -300,10 +327,11 @@ int main(int argc, char** argv)
   std::cout << "| range = [" << xMin << " ... " << xMax << "]" << std::endl;
   std::cout << "| points = " << iPoints << std::endl;
   std::cout << "| confidenve level = " << conf * 100 << "%" << std::endl;
+  std::cout << "| workers = " << iWorkers << std::endl;
   std::cout << "=============================" << std::endl;
   std::cout << std::endl;
   
-  RunGaussLimits(xMin,xMax,iPoints,conf);
+  RunGaussLimits(xMin,xMax,iPoints,conf,iWorkers);
 
   return 0;
 }
@@ -0,0 +1,253 @@
+// system include(s)
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <map>
+#include <chrono>
+#include "unistd.h"
+
+// ROOT include(s)
+#include "TFile.h"
+
+// RooFit include(s)
+#include "RooWorkspace.h"
+#include "RooArgSet.h"
+#include "RooAbsData.h"
+#include "RooRealVar.h"
+#include "RooMsgService.h"
+
+// RooStats include(s)
+#include "RooStats/ModelConfig.h"
+#include "RooStats/LikelihoodInterval.h"
+#include "RooStats/HypoTestResult.h"
+#include "RooStats/HypoTestInverterResult.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+
+using namespace RooFit;
+using namespace RooStats;
+using namespace CG_Statistics;
+
+// options of one job given as KEY=VALUE
+typedef std::map<std::string,std::string> JobOptions;
+
+double GetOption(const JobOptions& options,const std::string& sKey,double dDefault)
+{
+  auto it = options.find(sKey);
+  return (it == options.end()) ? dDefault : atof(it->second.c_str());
+}
+
+// run one job and return its tab separated results (empty if the job failed)
+std::string RunJob(const std::string& sFunction,RooAbsData& data,ModelConfig& mc,const JobOptions& options)
+{
+  RooRealVar* pPOI = (RooRealVar*)mc.GetParametersOfInterest()->first();
+  const int iToys = (int)GetOption(options,"toys",-1);
+  const unsigned int iWorkers = (unsigned int)GetOption(options,"workers",1);
+  const double dLow = GetOption(options,"low",-1e6);
+  const double dHigh = GetOption(options,"high",1e6);
+
+  char sResult[256] = "";
+  if(sFunction == "upperlimit")
+  {
+    HypoTestInverterResult* pResult = GetUpperLimit(data,mc,GetOption(options,"cls",1) != 0,GetOption(options,"conf",0.95),
+						    dLow,dHigh,GetOption(options,"precision",0.01),
+						    (unsigned int)GetOption(options,"iterations",20),iToys,iWorkers);
+    if(!pResult)
+      return "";
+    // limit and number of generated toys
+    snprintf(sResult,sizeof(sResult),"%g\t%llu",pResult->UpperLimit(),(unsigned long long)GetLastCallPerfCounters().iToys);
+    delete pResult;
+  }
+  else if(sFunction == "expectedlimits")
+  {
+    ExpectedLimits limits = GetExpectedLimits(data,mc,GetOption(options,"cls",1) != 0,GetOption(options,"conf",0.95),dLow,dHigh);
+    snprintf(sResult,sizeof(sResult),"%g\t%g\t%g\t%g\t%g\t%g",limits.dObserved,
+	     limits.dMinus2,limits.dMinus1,limits.dMedian,limits.dPlus1,limits.dPlus2);
+  }
+  else if(sFunction == "significance")
+  {
+    HypoTestResult* pResult = GetSignificance(data,mc,iToys);
+    if(!pResult)
+      return "";
+    snprintf(sResult,sizeof(sResult),"%g\t%g",pResult->Significance(),pResult->NullPValue());
+    delete pResult;
+  }
+  else if(sFunction == "fc")
+  {
+    const double dConf = GetOption(options,"conf",0.683);
+    const unsigned int iFCToys = (iToys > 0) ? iToys : 10000;
+    const FCMODE eMode = (FCMODE)(int)GetOption(options,"mode",eTOYS);
+#ifndef CG_EXPERIMENTAL
+    HypoTestInverterResult* pResult = GetFCInterval(data,mc,dConf,dLow,dHigh,GetOption(options,"step",0.05),iFCToys,iWorkers,
+						    (unsigned int)GetOption(options,"blocktoys",0),eMode);
+#else
+    HypoTestInverterResult* pResult = GetFCInterval(data,mc,dConf,(unsigned int)GetOption(options,"iterations",8),dLow,dHigh,
+						    (unsigned int)GetOption(options,"points",11),iFCToys,iWorkers,
+						    (unsigned int)GetOption(options,"blocktoys",0),eMode);
+#endif // CG_EXPERIMENTAL
+    if(!pResult)
+      return "";
+    snprintf(sResult,sizeof(sResult),"%g\t%g",pResult->LowerLimit(),pResult->UpperLimit());
+    delete pResult;
+  }
+  else if(sFunction == "likelihood")
+  {
+    LikelihoodInterval* pResult = GetLikelihoodInterval(data,mc,GetOption(options,"conf",0.683));
+    if(!pResult)
+      return "";
+    snprintf(sResult,sizeof(sResult),"%g\t%g",pResult->LowerLimit(*pPOI),pResult->UpperLimit(*pPOI));
+    delete pResult;
+  }
+  else
+  {
+    std::cerr << "unknown function '" << sFunction << "'" << std::endl;
+    return "";
+  }
+
+  return sResult;
+}
+
+int main(int argc, char** argv)
+{
+  RooMsgService::instance().setGlobalKillBelow(ERROR);
+
+  // options
+  std::string sWSFile   = "";
+  std::string sWSName   = "w";
+  std::string sMCName   = "ModelConfig";
+  std::string sJobFile  = "";
+  std::string sOutput   = "";
+  VERBOSITY verb        = eSILENT;
+
+  // parse options
+  int i;
+  while((i = getopt(argc,argv,"w:W:m:i:o:v:h")) != -1)
+  {
+    switch(i)
+    {
+    case 'w':
+      sWSFile = optarg;
+      break;
+    case 'W':
+      sWSName = optarg;
+      break;
+    case 'm':
+      sMCName = optarg;
+      break;
+    case 'i':
+      sJobFile = optarg;
+      break;
+    case 'o':
+      sOutput = optarg;
+      break;
+    case 'v':
+      verb = (VERBOSITY)atoi(optarg);
+      break;
+    case 'h':
+    case '?':
+      std::cout << "usage: ./JobRunner -w <FILE> -W <WS> -m <MC> -i <JOBS> -o <OUTPUT> -v <VERBOSITY>" << std::endl;
+      std::cout << std::endl;
+      std::cout << "options:" << std::endl;
+      std::cout << "-w FILE   : ROOT file with workspace (loaded once for all jobs)" << std::endl;
+      std::cout << "-W WS     : name of workspace (default: w)" << std::endl;
+      std::cout << "-m MC     : name of model config in workspace (default: ModelConfig)" << std::endl;
+      std::cout << "-i JOBS   : file with one job per line (default: stdin)" << std::endl;
+      std::cout << "-o OUTPUT : file for results (default: stdout)" << std::endl;
+      std::cout << "-v VERB   : verbosity level (0 ... silent to 4 .. debug mode) (default: 0)" << std::endl;
+      std::cout << "-h        : print this help message" << std::endl;
+      std::cout << std::endl;
+      std::cout << "job: FUNCTION DATASET [KEY=VALUE ...] with FUNCTION and its keys" << std::endl;
+      std::cout << "  upperlimit     : cls conf low high precision iterations toys workers" << std::endl;
+      std::cout << "  expectedlimits : cls conf low high" << std::endl;
+      std::cout << "  significance   : toys" << std::endl;
+#ifndef CG_EXPERIMENTAL
+      std::cout << "  fc             : conf low high step toys workers blocktoys mode" << std::endl;
+#else
+      std::cout << "  fc             : conf iterations low high points toys workers blocktoys mode" << std::endl;
+#endif // CG_EXPERIMENTAL
+      std::cout << "  likelihood     : conf" << std::endl;
+      std::cout << "DATASET is the name of a dataset in the workspace. Lines starting with # are skipped." << std::endl;
+      std::cout << std::endl;
+      std::cout << "output: one tab separated line per job with" << std::endl;
+      std::cout << "job function dataset status wall_s results..." << std::endl;
+      return 0;
+    default:
+      std::cerr << "got unknown option '" << i << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  iVERBOSITY = verb;
+
+  // load model once
+  TFile* pFile = TFile::Open(sWSFile.c_str(),"READ");
+  RooWorkspace* pWS = 0;
+  if(pFile)
+    pFile->GetObject(sWSName.c_str(),pWS);
+  ModelConfig* pMC = pWS ? (ModelConfig*)pWS->obj(sMCName.c_str()) : 0;
+  if(!pMC)
+  {
+    std::cerr << "failed to load model config '" << sMCName << "' from workspace '" << sWSName << "' in '" << sWSFile << "'" << std::endl;
+    return 1;
+  }
+
+  // every job starts from the parameter values of the workspace
+  RooArgSet allVars = pWS->allVars();
+  RooArgSet* pInitial = (RooArgSet*)allVars.snapshot();
+
+  std::ifstream jobFile;
+  if(!sJobFile.empty())
+    jobFile.open(sJobFile.c_str());
+  std::istream& jobs = sJobFile.empty() ? std::cin : jobFile;
+  std::ofstream outFile;
+  if(!sOutput.empty())
+    outFile.open(sOutput.c_str());
+  std::ostream& out = sOutput.empty() ? std::cout : outFile;
+
+  out << "# job\tfunction\tdataset\tstatus\twall_s\tresults" << std::endl;
+  std::string sLine;
+  unsigned int iJob = 0;
+  int iFailed = 0;
+  while(std::getline(jobs,sLine))
+  {
+    std::istringstream line(sLine);
+    std::string sFunction, sDataName;
+    if(!(line >> sFunction) || (sFunction[0] == '#') || !(line >> sDataName))
+      continue;
+
+    JobOptions options;
+    std::string sOption;
+    while(line >> sOption)
+    {
+      const size_t iPos = sOption.find('=');
+      if(iPos != std::string::npos)
+	options[sOption.substr(0,iPos)] = sOption.substr(iPos + 1);
+    }
+
+    allVars.assignValueOnly(*pInitial);
+    const auto start = std::chrono::steady_clock::now();
+    RooAbsData* pData = pWS->data(sDataName.c_str());
+    const std::string sResult = pData ? RunJob(sFunction,*pData,*pMC,options) : "";
+    const double dWall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if(!pData)
+      std::cerr << "dataset '" << sDataName << "' not found" << std::endl;
+    if(sResult.empty())
+      ++iFailed;
+
+    out << iJob++ << "\t" << sFunction << "\t" << sDataName << "\t" << (sResult.empty() ? "failed" : "ok") << "\t" << dWall
+	<< "\t" << sResult << std::endl;
+  }
+
+  // clean up
+  delete pInitial;
+  delete pWS;
+  pFile->Close();
+  delete pFile;
+
+  return (iFailed > 0) ? 1 : 0;
+}
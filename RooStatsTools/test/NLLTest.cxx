@@ -0,0 +1,200 @@
+// system include(s)
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "unistd.h"
+
+// RooFit include(s)
+#include "RooWorkspace.h"
+#include "RooArgSet.h"
+#include "RooArgList.h"
+#include "RooDataSet.h"
+#include "RooRealVar.h"
+#include "RooAbsPdf.h"
+#include "RooPolynomial.h"
+#include "RooRandom.h"
+#include "RooMsgService.h"
+
+// RooStats include(s)
+#include "RooStats/ModelConfig.h"
+#include "RooStats/HypoTestInverterResult.h"
+#include "RooStats/SamplingDistribution.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+
+using namespace RooFit;
+using namespace RooStats;
+using namespace CG_Statistics;
+
+// test model: workspace, model config and observed dataset
+struct TestModel
+{
+  std::string sName;
+  RooWorkspace* pWS;
+  ModelConfig* pMC;
+  RooAbsData* pData;
+};
+
+// NLL implementation selected by the options of the package
+struct NLLOption
+{
+  std::string sName;
+  bool bCompiled;
+  bool bBatch;
+  bool bGradients;
+};
+
+// Gaussian signal on a background of one (bFlatOnly) or two components, both containing a uniform
+// RooPolynomial (empty coefficient list)
+TestModel BuildModel(bool bFlatOnly)
+{
+  TestModel model;
+  model.sName = bFlatOnly ? "gauss+flat" : "gauss+expo+flat";
+  model.pWS = new RooWorkspace("ws");
+  model.pWS->factory("Gaussian::g(x[0,10],mean[5],sigma[0.5])");
+  RooPolynomial flat("flat","flat",*model.pWS->var("x"),RooArgList());
+  model.pWS->import(flat);
+  if(bFlatOnly)
+    model.pWS->factory("SUM::model(s[20,0,200]*g,b[500,0,2000]*flat)");
+  else
+  {
+    model.pWS->factory("Exponential::e(x,tau[-0.2,-2,-0.01])");
+    model.pWS->factory("SUM::bkg(f[0.5,0,1]*e,flat)");
+    model.pWS->factory("SUM::model(s[20,0,200]*g,b[500,0,2000]*bkg)");
+  }
+
+  model.pMC = new ModelConfig("model",model.pWS);
+  model.pMC->SetPdf("model");
+  model.pMC->SetObservables("x");
+  model.pMC->SetNuisanceParameters(bFlatOnly ? "b" : "b,tau,f");
+  model.pMC->SetParametersOfInterest("s");
+
+  // generate observed data with fixed seed
+  RooRandom::randomGenerator()->SetSeed(4357);
+  model.pData = model.pWS->pdf("model")->generate(RooArgSet(*model.pWS->var("x")),Extended());
+
+  return model;
+}
+
+// enable the given NLL implementation
+void SetNLLOption(const NLLOption& option)
+{
+  SetCompiledNLL(option.bCompiled);
+  SetBatchNLL(option.bBatch);
+  SetAnalyticGradients(option.bGradients);
+}
+
+// asymptotic CL(s) upper limit with the given NLL implementation (-1 if the calculation failed)
+double GetLimit(TestModel& model,const NLLOption& option)
+{
+  SetNLLOption(option);
+  HypoTestInverterResult* pResult = GetUpperLimit(*model.pData,*model.pMC);
+  const double dLimit = pResult ? pResult->UpperLimit() : -1;
+  delete pResult;
+  SetNLLOption(NLLOption{"RooFit",false,false,false});
+
+  return dLimit;
+}
+
+// test statistic of iToys toys with the given NLL implementation (same toys for every call)
+std::vector<double> GetToyValues(TestModel& model,const NLLOption& option,unsigned int iToys)
+{
+  SetNLLOption(option);
+  RooRandom::randomGenerator()->SetSeed(1234);
+  SamplingDistribution* pDist = GetSamplingDist(*model.pData,*model.pMC,iToys);
+  std::vector<double> vValues;
+  if(pDist)
+    vValues = pDist->GetSamplingDistribution();
+  delete pDist;
+  SetNLLOption(NLLOption{"RooFit",false,false,false});
+
+  return vValues;
+}
+
+// true if at least 99% of the toys agree with the reference within 1%
+bool CompareToys(const std::vector<double>& vValues,const std::vector<double>& vReference)
+{
+  if(vReference.empty() || (vValues.size() != vReference.size()))
+    return false;
+
+  unsigned int iSame = 0;
+  for(unsigned int i = 0; i < vValues.size(); ++i)
+  {
+    if(fabs(vValues[i] - vReference[i]) <= 1e-2 * (1 + fabs(vReference[i])))
+      ++iSame;
+  }
+
+  return iSame >= 0.99 * vReference.size();
+}
+
+int main(int argc, char** argv)
+{
+  RooMsgService::instance().setGlobalKillBelow(ERROR);
+
+  // options
+  unsigned int iToys = 200;
+  VERBOSITY verb     = eSILENT;
+
+  // parse options
+  int i;
+  while((i = getopt(argc,argv,"t:v:h")) != -1)
+  {
+    switch(i)
+    {
+    case 't':
+      iToys = atoi(optarg);
+      break;
+    case 'v':
+      verb = (VERBOSITY)atoi(optarg);
+      break;
+    case 'h':
+    case '?':
+      std::cout << "usage: ./NLLTest -t <TOYS> -v <VERBOSITY>" << std::endl;
+      std::cout << std::endl;
+      std::cout << "options:" << std::endl;
+      std::cout << "-t TOYS   : number of toys per sampling distribution (default: 200)" << std::endl;
+      std::cout << "-v VERB   : verbosity level (0 ... silent to 4 .. debug mode) (default: 0)" << std::endl;
+      std::cout << "-h        : print this help message" << std::endl;
+      return 0;
+    default:
+      std::cerr << "got unknown option '" << i << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  iVERBOSITY = verb;
+
+  std::vector<TestModel> vModels = {BuildModel(true),BuildModel(false)};
+  // first option (RooFit NLL) gives the reference
+  std::vector<NLLOption> vOptions = {{"RooFit",false,false,false},
+				     {"compiled",true,false,false},
+				     {"batch",false,true,false},
+				     {"gradients",false,false,true}};
+
+  bool bPassed = true;
+  for(auto& model : vModels)
+  {
+    const double dReference = GetLimit(model,vOptions.front());
+    const std::vector<double> vReference = GetToyValues(model,vOptions.front(),iToys);
+    for(auto& option : vOptions)
+    {
+      const double dLimit = GetLimit(model,option);
+      const bool bSame = (dReference > 0) && (fabs(dLimit - dReference) <= 1e-3 * dReference);
+      std::cout << model.sName << "\t" << option.sName << "\t" << dLimit << "\t" << (bSame ? "passed" : "FAILED") << std::endl;
+
+      // test statistic on toys
+      const bool bSameToys = CompareToys(GetToyValues(model,option,iToys),vReference);
+      std::cout << model.sName << "\t" << option.sName << "\ttoys\t" << (bSameToys ? "passed" : "FAILED") << std::endl;
+      bPassed = bPassed && bSame && bSameToys;
+    }
+
+    delete model.pData;
+    delete model.pMC;
+    delete model.pWS;
+  }
+
+  return bPassed ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// system include(s)
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "unistd.h"
+
+// ROOT include(s)
+#include "TString.h"
+
+// RooFit include(s)
+#include "RooWorkspace.h"
+#include "RooArgSet.h"
+#include "RooDataSet.h"
+#include "RooRealVar.h"
+#include "RooMsgService.h"
+
+// RooStats include(s)
+#include "RooStats/ModelConfig.h"
+#include "RooStats/HypoTestInverterResult.h"
+#include "RooStats/SamplingDistribution.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+
+using namespace RooFit;
+using namespace RooStats;
+using namespace CG_Statistics;
+
+// observed values of the Gaussian model (one dataset and one session per value)
+const std::vector<double> vObs = {0.5,1.5};
+
+// asymptotic CLs upper limit (-1 if the calculation failed)
+double GetLimit(RooAbsData& data,ModelConfig& mc)
+{
+  HypoTestInverterResult* pResult = GetUpperLimit(data,mc);
+  const double dLimit = pResult ? pResult->UpperLimit() : -1;
+  delete pResult;
+
+  return dLimit;
+}
+
+// one call in the scope of the session (false if a result differs from the reference)
+bool RunSession(Session& session,const unsigned int iIndex,const double dReference,const unsigned int iToys)
+{
+  Session::Scope scope(session);
+  RooAbsData* pData = session.GetData(TString::Format("obsData_%u",iIndex));
+  if(!pData)
+    return false;
+
+  bool bPassed = true;
+  const double dLimit = GetLimit(*pData,session.GetModel());
+  if(!(fabs(dLimit - dReference) <= 1e-4 * (1 + fabs(dReference))))
+  {
+    std::cerr << "session " << iIndex << ": upper limit " << dLimit << " differs from " << dReference << std::endl;
+    bPassed = false;
+  }
+
+  // two forked workers
+  SamplingDistribution* pDist = GetSamplingDist(*pData,session.GetModel(),iToys,2);
+  if(!pDist || (pDist->GetSize() != (int)iToys))
+  {
+    std::cerr << "session " << iIndex << ": got " << (pDist ? pDist->GetSize() : 0) << " instead of " << iToys << " toys" << std::endl;
+    bPassed = false;
+  }
+  delete pDist;
+
+  return bPassed;
+}
+
+int main(int argc, char** argv)
+{
+  RooMsgService::instance().setGlobalKillBelow(ERROR);
+
+  // options
+  unsigned int iCalls = 5;
+  unsigned int iToys  = 200;
+  VERBOSITY verb      = eSILENT;
+
+  // parse options
+  int i;
+  while((i = getopt(argc,argv,"n:t:v:h")) != -1)
+  {
+    switch(i)
+    {
+    case 'n':
+      iCalls = atoi(optarg);
+      break;
+    case 't':
+      iToys = atoi(optarg);
+      break;
+    case 'v':
+      verb = (VERBOSITY)atoi(optarg);
+      break;
+    case 'h':
+    case '?':
+      std::cout << "usage: ./SessionTest -n <CALLS> -t <TOYS> -v <VERBOSITY>" << std::endl;
+      std::cout << std::endl;
+      std::cout << "options:" << std::endl;
+      std::cout << "-n CALLS  : number of calls per session (default: 5)" << std::endl;
+      std::cout << "-t TOYS   : number of toys per call (default: 200)" << std::endl;
+      std::cout << "-v VERB   : verbosity level (0 ... silent to 4 .. debug mode) (default: 0)" << std::endl;
+      std::cout << "-h        : print this help message" << std::endl;
+      return 0;
+    default:
+      std::cerr << "got unknown option '" << i << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  iVERBOSITY = verb;
+
+  // Gaussian model of GaussLimitPlot with one dataset per observed value
+  RooWorkspace w("gauss");
+  w.factory("Gaussian:gaus(x[0,-10,10],mean[0,-8,8],width[1])");
+
+  ModelConfig mcGaus("gauss",&w);
+  mcGaus.SetPdf("gaus");
+  mcGaus.SetObservables("x");
+  mcGaus.SetParametersOfInterest("mean");
+  w.import(mcGaus);
+  ModelConfig* pMC = (ModelConfig*)w.obj("gauss");
+
+  RooArgSet rObservables(*w.var("x"));
+  for(unsigned int iIndex = 0; iIndex < vObs.size(); ++iIndex)
+  {
+    RooDataSet data(TString::Format("obsData_%u",iIndex),"data",rObservables);
+    w.var("x")->setVal(vObs[iIndex]);
+    data.add(rObservables);
+    w.import(data);
+  }
+
+  // sessions copy the model before the sequential reference changes its POI range
+  std::vector<Session*> vSessions;
+  for(unsigned int iIndex = 0; iIndex < vObs.size(); ++iIndex)
+    vSessions.push_back(new Session(*pMC));
+
+  std::vector<double> vReference;
+  for(unsigned int iIndex = 0; iIndex < vObs.size(); ++iIndex)
+    vReference.push_back(GetLimit(*w.data(TString::Format("obsData_%u",iIndex)),*pMC));
+
+  // options only apply to the session in whose scope they are set
+  {
+    Session::Scope scope(*vSessions.back());
+    SetBatchNLL(true);
+  }
+
+  // alternate between the sessions
+  std::vector<int> vPassed(vObs.size(),1);
+  for(unsigned int iCall = 0; iCall < iCalls; ++iCall)
+  {
+    for(unsigned int iIndex = 0; iIndex < vObs.size(); ++iIndex)
+      vPassed[iIndex] = vPassed[iIndex] && RunSession(*vSessions[iIndex],iIndex,vReference[iIndex],iToys);
+  }
+
+  bool bPassed = true;
+  for(unsigned int iIndex = 0; iIndex < vObs.size(); ++iIndex)
+  {
+    // counters of each session only contain its own toys
+    {
+      Session::Scope scope(*vSessions[iIndex]);
+      if(GetPerfCounters().iToys != (ULong64_t)iCalls * iToys)
+      {
+	std::cerr << "session " << iIndex << ": counted " << GetPerfCounters().iToys << " instead of " << iCalls * iToys << " toys" << std::endl;
+	vPassed[iIndex] = 0;
+      }
+    }
+
+    std::cout << "session " << iIndex << " (x = " << vObs[iIndex] << "): upper limit " << vReference[iIndex] << " "
+	      << (vPassed[iIndex] ? "passed" : "FAILED") << std::endl;
+    bPassed = bPassed && vPassed[iIndex];
+    delete vSessions[iIndex];
+  }
+
+  return bPassed ? 0 : 1;
+}
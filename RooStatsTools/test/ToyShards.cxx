@@ -0,0 +1,322 @@
+// system include(s)
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "unistd.h"
+
+// ROOT include(s)
+#include "TFile.h"
+#include "TKey.h"
+#include "TList.h"
+#include "TString.h"
+
+// RooFit include(s)
+#include "RooWorkspace.h"
+#include "RooArgSet.h"
+#include "RooDataSet.h"
+#include "RooRealVar.h"
+#include "RooRandom.h"
+#include "RooMsgService.h"
+
+// RooStats include(s)
+#include "RooStats/ModelConfig.h"
+#include "RooStats/SamplingDistribution.h"
+
+// custom include(s)
+#include "RooStatsTools.h"
+
+using namespace RooFit;
+using namespace RooStats;
+using namespace CG_Statistics;
+
+// tested POI values from "LOW:HIGH:N" (same points as a fixed FC scan of [LOW,HIGH] with N points) or "VALUE"
+std::vector<double> ParsePoints(const std::string& sPoints)
+{
+  std::vector<double> vPoints;
+  double dLow = 0, dHigh = 0;
+  unsigned int iPoints = 0;
+  if(sscanf(sPoints.c_str(),"%lf:%lf:%u",&dLow,&dHigh,&iPoints) == 3)
+  {
+    if(iPoints == 1)
+      vPoints.push_back(0.5 * (dLow + dHigh));
+    else
+    {
+      for(unsigned int i = 0; i < iPoints; ++i)
+	vPoints.push_back(dLow + i * (dHigh - dLow) / (iPoints - 1));
+    }
+  }
+  else if(!sPoints.empty())
+    vPoints.push_back(atof(sPoints.c_str()));
+
+  return vPoints;
+}
+
+// compare the distributions of two sampling distribution stores value by value
+bool CompareStores(const char* sFirst,const char* sSecond)
+{
+  TFile* pFirst = TFile::Open(sFirst,"READ");
+  TFile* pSecond = TFile::Open(sSecond,"READ");
+  if(!pFirst || !pSecond)
+  {
+    std::cerr << "failed to open stores" << std::endl;
+    return false;
+  }
+
+  unsigned int iCompared = 0;
+  bool bEqual = true;
+  TIter next(pFirst->GetListOfKeys());
+  TKey* pKey = 0;
+  while((pKey = (TKey*)next()))
+  {
+    SamplingDistribution* pDist1 = 0;
+    SamplingDistribution* pDist2 = 0;
+    pFirst->GetObject(pKey->GetName(),pDist1);
+    pSecond->GetObject(pKey->GetName(),pDist2);
+    if(!pDist1)
+      continue;
+
+    const bool bSame = pDist2 && (pDist1->GetSamplingDistribution() == pDist2->GetSamplingDistribution());
+    std::cout << pKey->GetName() << ": " << pDist1->GetSize() << " toys " << (bSame ? "identical" : "DIFFERENT") << std::endl;
+    bEqual = bEqual && bSame;
+    ++iCompared;
+
+    delete pDist1;
+    delete pDist2;
+  }
+
+  pFirst->Close();
+  pSecond->Close();
+  delete pFirst;
+  delete pSecond;
+
+  return bEqual && (iCompared > 0);
+}
+
+int main(int argc, char** argv)
+{
+  RooMsgService::instance().setGlobalKillBelow(ERROR);
+
+  // options
+  std::string sWSFile     = "";
+  std::string sWSName     = "w";
+  std::string sMCName     = "ModelConfig";
+  std::string sDataName   = "obsData";
+  std::string sTarget     = "fc";
+  std::string sPoints     = "";
+  std::string sOutput     = "shard.root";
+  double dGaussObs        = 0;
+  bool bGauss             = false;
+  double dSignal          = 0;
+  bool bConstrained       = false;
+  bool bMerge             = false;
+  bool bCompare           = false;
+  ULong64_t iFirstToy     = 0;
+  unsigned int iToys      = 1000;
+  unsigned int iSeed      = 1;
+  unsigned int iWorkers   = 1;
+  VERBOSITY verb          = eWARNING;
+
+  // parse options
+  int i;
+  while((i = getopt(argc,argv,"w:W:m:d:g:c:T:p:f:n:s:j:o:MCv:h")) != -1)
+  {
+    switch(i)
+    {
+    case 'w':
+      sWSFile = optarg;
+      break;
+    case 'W':
+      sWSName = optarg;
+      break;
+    case 'm':
+      sMCName = optarg;
+      break;
+    case 'd':
+      sDataName = optarg;
+      break;
+    case 'g':
+      bGauss = true;
+      dGaussObs = atof(optarg);
+      break;
+    case 'c':
+      bConstrained = true;
+      dSignal = atof(optarg);
+      break;
+    case 'T':
+      sTarget = optarg;
+      break;
+    case 'p':
+      sPoints = optarg;
+      break;
+    case 'f':
+      iFirstToy = strtoull(optarg,0,10);
+      break;
+    case 'n':
+      iToys = atoi(optarg);
+      break;
+    case 's':
+      iSeed = atoi(optarg);
+      break;
+    case 'j':
+      iWorkers = atoi(optarg);
+      break;
+    case 'o':
+      sOutput = optarg;
+      break;
+    case 'M':
+      bMerge = true;
+      break;
+    case 'C':
+      bCompare = true;
+      break;
+    case 'v':
+      verb = (VERBOSITY)atoi(optarg);
+      break;
+    case 'h':
+    case '?':
+      std::cout << "usage: ./ToyShards [-w <FILE> -W <WS> -m <MC> -d <DATA> | -g <X> | -c <S>] -T <TARGET> -p <POINTS> -f <FIRST> -n <TOYS> -s <SEED> -j <WORKERS> -o <OUTPUT>" << std::endl;
+      std::cout << "       ./ToyShards -M -o <STORE> <SHARD> [<SHARD> ...]" << std::endl;
+      std::cout << "       ./ToyShards -C <STORE> <STORE>" << std::endl;
+      std::cout << std::endl;
+      std::cout << "options:" << std::endl;
+      std::cout << "-w FILE   : ROOT file with workspace" << std::endl;
+      std::cout << "-W WS     : name of workspace (default: w)" << std::endl;
+      std::cout << "-m MC     : name of model config in workspace (default: ModelConfig)" << std::endl;
+      std::cout << "-d DATA   : name of dataset in workspace (default: obsData)" << std::endl;
+      std::cout << "-g X      : use Gaussian model of GaussLimitPlot with observation X instead of a workspace" << std::endl;
+      std::cout << "-c S      : use extended signal + background model with Gaussian constraint on the background (global" << std::endl;
+      std::cout << "            observable) and a generated dataset with S signal events instead of a workspace" << std::endl;
+      std::cout << "-T TARGET : fc (toys for GetFCInterval) or sig (toys for GetSignificance) (default: fc)" << std::endl;
+      std::cout << "-p POINTS : tested POI values as LOW:HIGH:N (points of fixed FC scan) or VALUE (fc only)" << std::endl;
+      std::cout << "-f FIRST  : index of first toy of this shard (default: 0)" << std::endl;
+      std::cout << "-n TOYS   : number of toys of this shard per point (default: 1000)" << std::endl;
+      std::cout << "-s SEED   : base seed (same for all shards) (default: 1)" << std::endl;
+      std::cout << "-j WORKERS: number of parallel workers (0 = one per CPU core) (default: 1)" << std::endl;
+      std::cout << "-o OUTPUT : shard file or merged sampling distribution store (default: shard.root)" << std::endl;
+      std::cout << "-M        : merge the given shard files into the store given by -o" << std::endl;
+      std::cout << "-C        : compare the toys of two stores (exit code 0 if identical)" << std::endl;
+      std::cout << "-v VERB   : verbosity level (0 ... silent to 4 .. debug mode) (default: 2)" << std::endl;
+      std::cout << "-h        : print this help message" << std::endl;
+      return 0;
+    default:
+      std::cerr << "got unknown option '" << i << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  iVERBOSITY = verb;
+
+  // merge shards
+  if(bMerge)
+  {
+    std::vector<std::string> vShardFiles(argv + optind,argv + argc);
+    return MergeToyShards(vShardFiles,sOutput.c_str()) ? 0 : 1;
+  }
+
+  // compare stores
+  if(bCompare)
+  {
+    if(argc - optind != 2)
+    {
+      std::cerr << "need two stores for comparison" << std::endl;
+      return 1;
+    }
+    return CompareStores(argv[optind],argv[optind + 1]) ? 0 : 1;
+  }
+
+  // load model
+  RooWorkspace* pWS = 0;
+  TFile* pFile = 0;
+  if(bGauss)
+  {
+    pWS = new RooWorkspace("gauss");
+    pWS->factory("Gaussian:gaus(x[0,-10,10],mean[0,-8,8],width[1])");
+
+    ModelConfig mcGaus(sMCName.c_str(),pWS);
+    mcGaus.SetPdf("gaus");
+    mcGaus.SetObservables("x");
+    mcGaus.SetParametersOfInterest("mean");
+    pWS->import(mcGaus);
+
+    RooArgSet rObservables(*pWS->var("x"));
+    RooDataSet data(sDataName.c_str(),"data",rObservables);
+    pWS->var("x")->setVal(dGaussObs);
+    data.add(rObservables);
+    pWS->import(data);
+  }
+  else if(bConstrained)
+  {
+    // Gaussian signal on flat background, background yield constrained by an auxiliary measurement
+    pWS = new RooWorkspace("constrained");
+    pWS->factory("Gaussian:sigShape(x[-5,5],mean[0],width[1])");
+    pWS->factory("Uniform:bkgShape(x)");
+    pWS->factory("prod:nbkg(b0[20],beta[1,0,3])");
+    pWS->factory("SUM:model(nsig[0,0,50]*sigShape,nbkg*bkgShape)");
+    pWS->factory("Gaussian:constraint(beta0[1,0,3],beta,betaErr[0.1])");
+    pWS->factory("PROD:pdf(model,constraint)");
+    pWS->var("beta0")->setConstant();
+
+    ModelConfig mcConstrained(sMCName.c_str(),pWS);
+    mcConstrained.SetPdf("pdf");
+    mcConstrained.SetObservables("x");
+    mcConstrained.SetParametersOfInterest("nsig");
+    mcConstrained.SetNuisanceParameters("beta");
+    mcConstrained.SetGlobalObservables("beta0");
+    pWS->import(mcConstrained);
+
+    // same dataset in every shard
+    RooRandom::randomGenerator()->SetSeed(4357);
+    pWS->var("nsig")->setVal(dSignal);
+    RooDataSet* pGenerated = pWS->pdf("pdf")->generate(RooArgSet(*pWS->var("x")),Extended());
+    pGenerated->SetName(sDataName.c_str());
+    pWS->import(*pGenerated);
+    delete pGenerated;
+  }
+  else
+  {
+    pFile = TFile::Open(sWSFile.c_str(),"READ");
+    if(pFile)
+      pFile->GetObject(sWSName.c_str(),pWS);
+  }
+
+  ModelConfig* pMC = pWS ? (ModelConfig*)pWS->obj(sMCName.c_str()) : 0;
+  RooAbsData* pData = pWS ? pWS->data(sDataName.c_str()) : 0;
+  if(!pMC || !pData)
+  {
+    std::cerr << "failed to load model config '" << sMCName << "' and dataset '" << sDataName << "'" << std::endl;
+    return 1;
+  }
+
+  // tested points
+  TOYTARGET eTarget = eFCINTERVAL;
+  std::vector<double> vPoints;
+  if(sTarget == "sig")
+  {
+    // null hypothesis is given by the snapshot of the model (as in GetSignificance)
+    eTarget = eSIGNIFICANCE;
+    RooRealVar* pPOI = (RooRealVar*)pMC->GetParametersOfInterest()->first();
+    vPoints.push_back(pMC->GetSnapshot() ? pMC->GetSnapshot()->getRealValue(pPOI->GetName(),pPOI->getVal()) : pPOI->getVal());
+  }
+  else
+    vPoints = ParsePoints(sPoints);
+
+  if(vPoints.empty())
+  {
+    std::cerr << "no points to test" << std::endl;
+    return 1;
+  }
+
+  const bool bSuccess = GenerateToyShard(sOutput.c_str(),*pData,*pMC,eTarget,vPoints,iFirstToy,iToys,iSeed,iWorkers);
+
+  // clean up
+  delete pWS;
+  if(pFile)
+  {
+    pFile->Close();
+    delete pFile;
+  }
+
+  return bSuccess ? 0 : 1;
+}